@@ -10,186 +10,1275 @@
  * - Simulate circuit behavior with different input combinations
  * - Generate visual circuit diagrams using Graphviz
  * - Export circuit descriptions as DOT files
+ * 
+ * 
+ * This file is the command-line front end: the interactive session and
+ * the batch, truthtable, cycles, timing, random, faultsim, equiv, convert,
+ * dot and bench commands. The engines are in the circuitsim library
+ * (circuitsim.cpp, internals in circuitsim_detail.h).
  */
 
 #include <iostream>     // For input/output operations
-#include <fstream>      // For file operations (DOT file generation)
 #include <vector>       // For dynamic arrays (storing gates)
-#include <unordered_map>// For hash maps (not used but included for compatibility)
 #include <string>       // For string operations
 #include <sstream>      // For string stream operations (parsing input)
-#include <map>          // For ordered maps (storing net values)
 #include <set>          // For sets (storing primary inputs/outputs)
-#include <cstdlib>      // For system() function calls
-#include <algorithm>    // For transform function (case conversion)
-#include <cctype>       // For toupper function
+#include <cstdlib>      // For system() function calls (Graphviz on Windows)
+#include <algorithm>    // For max/sort (option parsing, reports)
+#include <cstdint>      // For fixed-width integer types (packed words, seeds)
+#include <cstdio>       // For buffered file I/O (batch mode)
+#include <thread>       // For hardware_concurrency and the background DOT render
+#include <memory>       // For unique_ptr (optional engines)
+#include <string_view>  // For zero-copy net names
+#include <chrono>       // For run timing
+
+#ifdef _WIN32
+#include <io.h>         // For _setmode (binary results on stdout)
+#include <fcntl.h>
+#endif
+
+#include "circuitsim_detail.h"
 
 using namespace std;
+using namespace circuitsim::detail;
 
 /**
- * @struct Gate
- * @brief Represents a digital logic gate with its type, output, and inputs
+ * @brief Prints the complete truth table of the circuit
+ * @param c Levelized circuit
+ * @param s Simulation state used for packed evaluation
+ * 
+ * Enumerates all 2^n input combinations (the first primary input is the
+ * most significant bit) and evaluates one block of 64 to 512 patterns
+ * per simulatePacked() call.
  */
-struct Gate {
-    string type;            ///< Gate type (AND, OR, NOT, etc.)
-    string out;             ///< Output net name
-    vector<string> inputs;  ///< Input net names
+void printTruthTable(const CompiledCircuit &c, SimState &s) {
+    const int nInputs = static_cast<int>(c.primaryInputIds.size());
+    if (nInputs > MAX_TRUTH_TABLE_INPUTS) {
+        cout << "❌ Error: Truth table limited to " << MAX_TRUTH_TABLE_INPUTS
+             << " inputs (circuit has " << nInputs << ").\n";
+        return;
+    }
+    
+    cout << "\n" << string(40, '-') << "\n";
+    cout << "TRUTH TABLE\n";
+    cout << string(40, '-') << "\n";
+    for (int id : c.primaryInputIds) cout << c.netName(id) << " ";
+    cout << "|";
+    for (size_t o = 0; o < c.primaryOutputIds.size(); o++) cout << " " << c.outputName(o);
+    cout << "\n";
+    
+    // Undefined outputs print as '-'
+    const size_t k = s.packedWordsPerNet;
+    const uint64_t nPatterns = 1ULL << nInputs;
+    for (uint64_t base = 0; base < nPatterns; base += 64 * k) {
+        for (int i = 0; i < nInputs; i++) {
+            for (size_t w = 0; w < k; w++) {
+                s.netWords[c.primaryInputIds[i] * k + w] =
+                    exhaustivePatternWord(base + 64 * w, nInputs - 1 - i);
+            }
+        }
+        simulatePacked(c, s);
+        
+        const uint64_t blockSize = min<uint64_t>(64 * k, nPatterns - base);
+        for (uint64_t p = 0; p < blockSize; p++) {
+            const size_t w = p / 64;
+            const int bit = static_cast<int>(p % 64);
+            for (int i = 0; i < nInputs; i++) {
+                cout << ((s.netWords[c.primaryInputIds[i] * k + w] >> bit) & 1) << " ";
+            }
+            cout << "|";
+            for (int id : c.primaryOutputIds) {
+                if (id < 0) cout << " -";
+                else cout << " " << ((s.netWords[id * k + w] >> bit) & 1);
+            }
+            cout << "\n";
+        }
+    }
+}
+
+/// Gates above which interactive mode writes the DOT file but renders no PNG
+const size_t DOT_RENDER_GATE_LIMIT = 2000;
+
+/**
+ * @class DotRenderer
+ * @brief Runs Graphviz on a DOT file in a background thread
+ * 
+ * Rendering a large graph can take minutes, so the caller keeps working
+ * and only waits (if at all) when it needs the result.
+ */
+class DotRenderer {
+public:
+    ~DotRenderer() {
+        if (worker.joinable()) worker.join();
+    }
+    
+    /// Starts 'dot -Tpng dotPath -o pngPath'; Graphviz's own messages are discarded
+    void start(const string &dotPath, const string &pngPath) {
+#ifdef _WIN32
+        const string command = "dot -Tpng \"" + dotPath + "\" -o \"" + pngPath + "\" >NUL 2>&1";
+        worker = thread([this, command]() { rendered = system(command.c_str()) == 0; });
+#else
+        // No shell: the paths come from circuit names and arguments
+        const vector<string> args = {"dot", "-Tpng", dotPath, "-o", pngPath};
+        worker = thread([this, args]() { rendered = runCommand(args, "/dev/null"); });
+#endif
+    }
+    
+    bool started() const { return worker.joinable(); }
+    
+    /// Waits for the render to finish; true if the PNG was written
+    bool wait() {
+        if (worker.joinable()) worker.join();
+        return rendered;
+    }
+    
+private:
+    thread worker;
+    bool rendered = false;
 };
 
-// Global variables for circuit representation
-map<string, int> values;        ///< Stores current values of all nets (0 or 1)
-vector<Gate> gates;             ///< List of all gates in the circuit
-set<string> primaryInputs;      ///< Set of primary input net names
-set<string> primaryOutputs;     ///< Set of primary output net names
+/**
+ * @brief Loads a netlist for a command, reporting problems on stderr
+ * @param path Text, Verilog (.v), BLIF (.blif) or binary netlist file path
+ * @param c Receives the compiled circuit
+ * @param circuitName Receives the circuit name
+ * @param optimize Optimize while compiling (binary netlists are used as written)
+ * @return true if the circuit is ready to simulate
+ */
+bool prepareCircuit(const string &path, CompiledCircuit &c, string &circuitName, bool optimize) {
+    if (optimize && detectNetlistFormat(path) == NetlistFormat::BINARY) {
+        cerr << "⚠ --optimize does not apply to binary netlists; pass it to 'convert' instead.\n";
+    }
+    string error, report;
+    if (!loadCircuit(path, c, circuitName, optimize, error, &report)) {
+        cerr << "❌ Error: " << error << "\n";
+        return false;
+    }
+    if (!report.empty()) cerr << report << "\n";
+    return true;
+}
+
+/**
+ * @brief Rejects sequential circuits in the commands that simulate logic only
+ * @param c Compiled circuit
+ * @return true if the circuit has no flip-flops; otherwise reports an error on stderr
+ */
+bool requireCombinational(const CompiledCircuit &c) {
+    if (c.flopCount() == 0) return true;
+    cerr << "❌ Error: Circuit has " << c.flopCount() << " flip-flop(s); simulate it with 'circuit cycles'.\n";
+    return false;
+}
 
 /**
- * @brief Evaluates a logic gate based on its type and input values
- * @param g The gate to evaluate
- * @return The output value (0 or 1) of the gate
+ * @brief Prints command-line usage
  */
-int evalGate(const Gate &g) {
-    // Two-input gates
-    if (g.type == "AND") 
-        return values[g.inputs[0]] & values[g.inputs[1]];
-    if (g.type == "OR")  
-        return values[g.inputs[0]] | values[g.inputs[1]];
-    if (g.type == "NAND") 
-        return !(values[g.inputs[0]] & values[g.inputs[1]]);
-    if (g.type == "NOR")  
-        return !(values[g.inputs[0]] | values[g.inputs[1]]);
-    if (g.type == "XOR") 
-        return values[g.inputs[0]] ^ values[g.inputs[1]];
-    if (g.type == "XNOR") 
-        return !(values[g.inputs[0]] ^ values[g.inputs[1]]);
-    
-    // Single-input gate
-    if (g.type == "NOT") 
-        return !values[g.inputs[0]];
-    
-    // Error handling for unknown gate types
-    cerr << "Error: Unknown gate type: " << g.type << "\n";
-    return 0;
+void printUsage() {
+    cout << "Usage:\n";
+    cout << "  circuit                             Interactive mode\n";
+    cout << "  circuit batch NETLIST VECTORS [options]\n";
+    cout << "                                      Simulate every vector in VECTORS ('-' for stdin)\n";
+    cout << "  circuit truthtable NETLIST OUTPUT [--optimize]\n";
+    cout << "                                      Stream the full truth table to OUTPUT ('-' for stdout)\n";
+    cout << "  circuit convert NETLIST OUTPUT [--optimize]\n";
+    cout << "                                      Compile NETLIST to a binary netlist (loaded with mmap)\n";
+    cout << "  circuit cycles NETLIST STIMULUS [options]\n";
+    cout << "                                      Clock a circuit with flip-flops (DFF) through\n";
+    cout << "                                      STIMULUS, one input vector per cycle\n";
+    cout << "  circuit faultsim NETLIST VECTORS [--threads=N] [-o FILE]\n";
+    cout << "                                      Grade VECTORS against every stuck-at fault\n";
+    cout << "  circuit timing NETLIST VECTORS [--delays=FILE] [--summary] [-o FILE]\n";
+    cout << "                                      Simulate with gate delays; report settle times\n";
+    cout << "                                      and glitches per output\n";
+    cout << "  circuit random NETLIST [random options]\n";
+    cout << "                                      Simulate weighted-random vectors; report the signal\n";
+    cout << "                                      probability and toggles of every output\n";
+    cout << "  circuit equiv NETLIST1 NETLIST2 [--vectors=N] [--seed=N] [--conflicts=N]\n";
+    cout << "                                      Check two circuits for equivalence, pairing inputs\n";
+    cout << "                                      and outputs by name; prints the first mismatch\n";
+    cout << "  circuit dot NETLIST OUTPUT [--cone=OUT,...] [--levels=A[:B]] [--png]\n";
+    cout << "                                      Write a Graphviz DOT file of the circuit, or of the\n";
+    cout << "                                      fanin of some outputs / a range of logic levels\n";
+    cout << "  circuit bench [bench options]       Benchmark the engines on generated circuits (CSV)\n";
+    cout << "\nNETLIST may be a text netlist, structural Verilog (.v), BLIF (.blif),\n";
+    cout << "or a binary netlist written by 'convert'.\n";
+    cout << "\nBatch options:\n";
+    cout << "  --engine=NAME                       Simulation engine: packed (default), event,\n";
+    cout << "                                      scalar, level or jit (compiled to native code)\n";
+    cout << "  --kernel=auto|scalar|avx2|avx512    Packed kernel width (default: auto)\n";
+    cout << "  --threads=N                         Worker threads (default: all cores)\n";
+    cout << "  -o FILE                             Write results to FILE instead of stdout\n";
+    cout << "  --optimize                          Fold constants, drop dead logic, merge gate chains\n";
+    cout << "                                      and shared gates first (outputs are unchanged)\n";
+    cout << "  --format=full|outputs|hex|binary|summary\n";
+    cout << "                                      Per vector: inputs and outputs (default), output\n";
+    cout << "                                      bits, hex digits or packed bytes; or only the count\n";
+    cout << "                                      of ones per output at the end\n";
+    cout << "  --watch=NET,...                     Report these nets instead of the primary outputs\n";
+    cout << "  --input-format=text|binary          VECTORS holds text lines (default) or binary rows\n";
+    cout << "                                      as written by --format=binary\n";
+    cout << "  --cone-tables=N                     Scalar engine: find reported nets depending on at\n";
+    cout << "                                      most N inputs by table lookup (default: 16, 0: off)\n";
+    cout << "  --vcd=FILE                          Dump a change-only VCD waveform, one step per vector\n";
+    cout << "  --vcd-nets=NET|SCOPE,...            Nets (or dotted scopes) to dump (default: all)\n";
+    cout << "  --vcd-window=A[:B]                  Dump time steps A to B only\n";
+    cout << "\nCycles options:\n";
+    cout << "  --cycles=N                          Cycles per stream (default: the longest stream);\n";
+    cout << "                                      streams keep their last inputs once they run out\n";
+    cout << "  --kernel, --threads, -o, --optimize As for batch; a STREAM line in STIMULUS starts\n";
+    cout << "                                      another stream, simulated in its own bit lane\n";
+    cout << "  --vcd, --vcd-nets, --vcd-window     As for batch, one step per clock cycle\n";
+    cout << "  --vcd-stream=N                      Stream to dump, the first being 0 (default: 0)\n";
+    cout << "\nRandom options:\n";
+    cout << "  --vectors=N                         Number of vectors (default: 1048576)\n";
+    cout << "  --seed=N                            Generator seed; the same seed gives the same vectors\n";
+    cout << "  --weights=NET=P,...                 Probability of a 1 for some inputs\n";
+    cout << "  --default-weight=P                  Probability of a 1 for the others (default: 0.5)\n";
+    cout << "  --watch=NET,...                     Report these nets instead of the primary outputs\n";
+    cout << "  --engine=packed|jit, --kernel, --threads, -o\n";
+    cout << "                                      As for batch\n";
+    cout << "\nBench options:\n";
+    cout << "  --scale=N                           Circuit size multiplier (default: 1)\n";
+    cout << "  --vectors=N                         Random vectors per run (default: 4096)\n";
+    cout << "  --engines=LIST                      Comma-separated: scalar,event,packed,threaded,\n";
+    cout << "                                      level,jit (default: all but jit)\n";
+    cout << "  --threads=N, -o FILE                As for batch\n";
 }
 
 /**
- * @brief Simulates the entire circuit by evaluating all gates
- * 
- * This function propagates values through all gates in the circuit.
- * Gates are evaluated in the order they were defined, which assumes
- * proper topological ordering by the user.
+ * @brief Parses a --kernel option value
+ * @param name auto, scalar, avx2 or avx512
+ * @param kernel Receives the kernel ("auto" picks the widest supported one)
+ * @return false if the name is unknown
+ */
+bool parseKernelName(const string &name, PackedKernel &kernel) {
+    if (name == "auto") {
+        kernel = detectPackedKernel();
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(PACKED_KERNELS) / sizeof(PACKED_KERNELS[0]); i++) {
+        if (name == PACKED_KERNELS[i].name) {
+            kernel = static_cast<PackedKernel>(i);
+            return true;
+        }
+    }
+    cerr << "❌ Error: Unknown kernel '" << name << "'.\n";
+    return false;
+}
+
+/**
+ * @brief Parses a --threads option value
+ * @param value Thread count; 0 or "auto" uses every hardware thread
+ * @param threads Receives the thread count (at least 1)
+ * @return false if the value is not a number
  */
-void simulate() {
-    for (auto &g : gates) {
-        values[g.out] = evalGate(g);
+bool parseThreadCount(const string &value, size_t &threads) {
+    if (value == "auto" || value == "0") {
+        threads = max(1u, thread::hardware_concurrency());
+        return true;
     }
+    char *end = nullptr;
+    long n = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || n < 1) {
+        cerr << "❌ Error: Invalid thread count '" << value << "'.\n";
+        return false;
+    }
+    threads = static_cast<size_t>(n);
+    return true;
 }
 
 /**
- * @brief Generates a Graphviz DOT file for circuit visualization
- * @param circuitName Name of the circuit (used for file naming)
- * 
- * Creates a .dot file that can be used with Graphviz to generate
- * visual circuit diagrams. Also attempts to automatically generate
- * a PNG image if Graphviz is installed.
+ * @brief Parses an inclusive range "A:B", or "A" for a range of one
+ * @param range Range text
+ * @param first Receives A
+ * @param last Receives B
+ * @return false if either bound is not a number or B < A
+ */
+bool parseRange(const string &range, long &first, long &last) {
+    size_t colon = range.find(':');
+    return parseDecimal(range.substr(0, colon), first) &&
+           parseDecimal(colon == string::npos ? range : range.substr(colon + 1), last) &&
+           last >= first;
+}
+
+/**
+ * @brief Parses one --vcd* option
+ * @param arg Argument: --vcd=FILE, --vcd-nets=LIST, --vcd-window=A[:B] or --vcd-stream=N
+ * @param options Updated with the option
+ * @return false (with a message) if the value is invalid
+ */
+bool parseVcdOption(const string &arg, VcdOptions &options) {
+    const size_t eq = arg.find('=');
+    const string name = arg.substr(0, eq);
+    const string value = (eq == string::npos) ? string() : arg.substr(eq + 1);
+    long first = 0, last = 0;
+    if (name == "--vcd" && !value.empty()) {
+        options.path = value;
+    } else if (name == "--vcd-nets") {
+        stringstream list(value);
+        string net;
+        while (getline(list, net, ',')) {
+            if (!net.empty()) options.nets.push_back(net);
+        }
+    } else if (name == "--vcd-window") {
+        if (!parseRange(value, first, last)) {
+            cerr << "❌ Error: Invalid VCD time window '" << value << "'.\n";
+            return false;
+        }
+        options.firstTime = static_cast<uint64_t>(first);
+        options.lastTime = static_cast<uint64_t>(last);
+    } else if (name == "--vcd-stream") {
+        if (!parseDecimal(value, first)) {
+            cerr << "❌ Error: Invalid VCD stream '" << value << "'.\n";
+            return false;
+        }
+        options.stream = static_cast<size_t>(first);
+    } else {
+        cerr << "❌ Error: Unknown option '" << arg << "'.\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Removes a flag from an argument list
+ * @param args Arguments; the flag is erased if present
+ * @param flag Flag text, e.g. "--optimize"
+ * @return true if the flag was present
  */
-void writeDot(const string &circuitName) {
-    string filename = circuitName + ".dot";
-    ofstream dot(filename);
+bool takeFlag(vector<string> &args, const string &flag) {
+    auto it = find(args.begin(), args.end(), flag);
+    if (it == args.end()) return false;
+    args.erase(it);
+    return true;
+}
+
+/**
+ * @brief Implements 'circuit batch NETLIST VECTORS [options]'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runBatchCommand(const vector<string> &args) {
+    vector<string> positional;
+    BatchEngine engine = BatchEngine::PACKED;
+    PackedKernel kernel = detectPackedKernel();
+    size_t threads = max(1u, thread::hardware_concurrency());
+    string outputPath;
+    bool optimize = false;
+    ResultMode mode = ResultMode::FULL;
+    vector<string> watch;
+    VcdOptions vcd;
+    bool binaryInput = false;
+    size_t coneSupport = CONE_TABLE_MAX_SUPPORT;
     
-    // Check if file creation was successful
-    if (!dot.is_open()) {
-        cout << "Error: Could not create DOT file '" << filename << "'.\n";
-        return;
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.rfind("--vcd", 0) == 0 && arg.rfind("--vcd-stream", 0) != 0) {
+            if (!parseVcdOption(arg, vcd)) return 1;
+        } else if (arg.rfind("--cone-tables=", 0) == 0) {
+            long n;
+            if (!parseDecimal(string_view(arg).substr(14), n) || n > static_cast<long>(CONE_TABLE_MAX_SUPPORT)) {
+                cerr << "❌ Error: --cone-tables takes a support size from 0 to "
+                     << CONE_TABLE_MAX_SUPPORT << ".\n";
+                return 1;
+            }
+            coneSupport = static_cast<size_t>(n);
+        } else if (arg.rfind("--input-format=", 0) == 0) {
+            string name = arg.substr(15);
+            if (name != "text" && name != "binary") {
+                cerr << "❌ Error: Unknown vector format '" << name << "'.\n";
+                return 1;
+            }
+            binaryInput = (name == "binary");
+        } else if (arg.rfind("--format=", 0) == 0) {
+            string name = arg.substr(9);
+            if (name == "full") mode = ResultMode::FULL;
+            else if (name == "outputs") mode = ResultMode::OUTPUTS;
+            else if (name == "hex") mode = ResultMode::HEX;
+            else if (name == "binary") mode = ResultMode::BINARY;
+            else if (name == "summary") mode = ResultMode::SUMMARY;
+            else {
+                cerr << "❌ Error: Unknown result format '" << name << "'.\n";
+                return 1;
+            }
+        } else if (arg.rfind("--watch=", 0) == 0) {
+            stringstream list(arg.substr(8));
+            string name;
+            while (getline(list, name, ',')) {
+                if (!name.empty()) watch.push_back(name);
+            }
+        } else if (arg.rfind("--engine=", 0) == 0) {
+            string name = arg.substr(9);
+            if (name == "packed") engine = BatchEngine::PACKED;
+            else if (name == "event") engine = BatchEngine::EVENT;
+            else if (name == "scalar") engine = BatchEngine::SCALAR;
+            else if (name == "level") engine = BatchEngine::LEVEL;
+            else if (name == "jit") engine = BatchEngine::JIT;
+            else {
+                cerr << "❌ Error: Unknown engine '" << name << "'.\n";
+                return 1;
+            }
+        } else if (arg.rfind("--kernel=", 0) == 0) {
+            if (!parseKernelName(arg.substr(9), kernel)) return 1;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!parseThreadCount(arg.substr(10), threads)) return 1;
+        } else if (arg == "--optimize") {
+            optimize = true;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            outputPath = args[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
     }
     
-    // Write DOT file header
-    dot << "digraph " << circuitName << " {\n";
-    dot << "    // Graph properties\n";
-    dot << "    rankdir=LR;  // Left to right layout\n";
-    dot << "    node [shape=box, style=filled, color=lightblue];\n";
-    dot << "    \n";
+    // The packed engine sweeps text netlists module by module; the others flatten
+    // them, as does a VCD dump, which needs every instance net by its dotted name
+    CompiledCircuit circuit;
+    CompiledDesign design;
+    string circuitName;
+    const bool keepHierarchy = engine == BatchEngine::PACKED && !optimize && vcd.path.empty() &&
+                               detectNetlistFormat(positional[0]) == NetlistFormat::TEXT;
+    if (keepHierarchy) {
+        string error;
+        if (!importDesign(positional[0], design, circuitName, error)) {
+            cerr << "❌ Error: " << error << "\n";
+            return 1;
+        }
+        circuit = design.top().body;
+    } else if (!prepareCircuit(positional[0], circuit, circuitName, optimize)) {
+        return 1;
+    }
+    if (!requireCombinational(circuit)) return 1;
     
-    // Add primary inputs as special nodes
-    dot << "    // Primary inputs\n";
-    for (const auto& input : primaryInputs) {
-        dot << "    " << input << " [color=lightgreen, label=\"" << input << "\\nIN\"];\n";
+    // Watched nets replace the primary outputs in every format
+    ResultFormat format = outputResultFormat(circuit, mode);
+    if (!watch.empty()) {
+        format.nets.clear();
+        format.names = watch;
+        for (const auto &name : watch) {
+            int id = circuit.findNet(name);
+            if (id < 0) {
+                cerr << "❌ Error: No net named '" << name << "' to watch.\n";
+                return 1;
+            }
+            format.nets.push_back(id);
+        }
     }
-    dot << "    \n";
     
-    // Add primary outputs as special nodes
-    dot << "    // Primary outputs\n";
-    for (const auto& output : primaryOutputs) {
-        dot << "    " << output << " [color=lightcoral, label=\"" << output << "\\nOUT\"];\n";
+    // Vectors reach the dump in order only when one thread simulates them
+    unique_ptr<VcdWriter> vcdWriter;
+    if (!vcd.path.empty()) {
+        vcdWriter = openVcdWriter(circuit, circuitName, vcd);
+        if (!vcdWriter) return 1;
+        threads = 1;
     }
-    dot << "    \n";
     
-    // Add gates and connections
-    dot << "    // Gates and connections\n";
-    for (size_t i = 0; i < gates.size(); i++) {
-        const auto &g = gates[i];
-        string gateNode = "gate_" + to_string(i) + "_" + g.type;
-        
-        // Create gate node
-        dot << "    " << gateNode << " [label=\"" << g.type << "\", color=lightyellow];\n";
-        
-        // Connect inputs to gate
-        for (const auto &input : g.inputs) {
-            dot << "    " << input << " -> " << gateNode << ";\n";
+    FILE *outFile = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << outputPath << "'.\n";
+        return 1;
+    }
+#ifdef _WIN32
+    if (outFile == stdout && mode == ResultMode::BINARY) _setmode(_fileno(stdout), _O_BINARY);
+    if (binaryInput && positional[1] == "-") _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    
+    bool ok;
+    {
+        OutputBuffer out(outFile);
+        SampleHook hook;
+        if (vcdWriter) hook = [&vcdWriter](const SimState &s, int lane) { vcdWriter->sample(s, lane); };
+        ok = runBatch(circuit, positional[1], out, engine, kernel, threads, format,
+                      design.hierarchical() ? &design : nullptr, hook, binaryInput, coneSupport);
+    }
+    if (vcdWriter) vcdWriter->finish();
+    if (outFile != stdout) fclose(outFile);
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief Implements 'circuit truthtable NETLIST OUTPUT'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runTruthTableCommand(vector<string> args) {
+    bool optimize = takeFlag(args, "--optimize");
+    if (args.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(args[0], circuit, circuitName, optimize)) return 1;
+    if (!requireCombinational(circuit)) return 1;
+    
+    const size_t nInputs = circuit.primaryInputIds.size();
+    if (nInputs > MAX_STREAMED_TRUTH_TABLE_INPUTS) {
+        cerr << "❌ Error: Truth table limited to " << MAX_STREAMED_TRUTH_TABLE_INPUTS
+             << " inputs (circuit has " << nInputs << ").\n";
+        return 1;
+    }
+    
+    FILE *outFile = (args[1] == "-") ? stdout : fopen(args[1].c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << args[1] << "'.\n";
+        return 1;
+    }
+    
+    SimState state;
+    initSimState(circuit, state, PackedKernel::SCALAR);
+    uint64_t rows;
+    {
+        OutputBuffer out(outFile);
+        rows = writeTruthTable(circuit, state, out);
+    }
+    if (outFile != stdout) fclose(outFile);
+    
+    const EventStats &total = state.totalEventStats;
+    cerr << "✓ " << rows << " rows written; " << total.evaluated << " gate evaluations, "
+         << total.skipped << " skipped\n";
+#ifdef CIRCUIT_PROFILE
+    printSimProfile(circuit, state.profile);
+#endif
+    return 0;
+}
+
+/**
+ * @brief Implements 'circuit faultsim NETLIST VECTORS [--threads=N] [-o FILE]'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runFaultSimCommand(const vector<string> &args) {
+    vector<string> positional;
+    size_t threads = max(1u, thread::hardware_concurrency());
+    string outputPath;
+    
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.rfind("--threads=", 0) == 0) {
+            if (!parseThreadCount(arg.substr(10), threads)) return 1;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            outputPath = args[++i];
+        } else {
+            positional.push_back(arg);
         }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    
+    // Faults are enumerated on the netlist as written, so it is not optimized
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(positional[0], circuit, circuitName, false)) return 1;
+    if (!requireCombinational(circuit)) return 1;
+    
+    const size_t nInputs = circuit.primaryInputIds.size();
+    vector<char> vectors;
+    if (!loadVectorFile(positional[1], nInputs, vectors)) return 1;
+    const size_t nVectors = nInputs ? vectors.size() / nInputs : 0;
+    
+    FILE *outFile = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << outputPath << "'.\n";
+        return 1;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    vector<StuckAtFault> faults = enumerateStuckAtFaults(circuit);
+    gradeStuckAtFaults(circuit, faults, vectors, nVectors, threads);
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    {
+        OutputBuffer out(outFile);
+        writeFaultReport(circuit, faults, nVectors, out);
+    }
+    if (outFile != stdout) fclose(outFile);
+    
+    size_t detected = 0;
+    for (const auto &f : faults) detected += (f.detectedBy >= 0);
+    cerr << "✓ " << detected << " of " << faults.size() << " faults detected by "
+         << nVectors << " vectors in " << elapsed.count() << " ms\n";
+    return 0;
+}
+
+/**
+ * @brief Implements 'circuit timing NETLIST VECTORS [options]'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runTimingCommand(const vector<string> &args) {
+    vector<string> positional;
+    string delayPath, outputPath;
+    bool summaryOnly = false;
+    
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.rfind("--delays=", 0) == 0) {
+            delayPath = arg.substr(9);
+        } else if (arg == "--summary") {
+            summaryOnly = true;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            outputPath = args[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    
+    // Delays belong to the gates as written, so the netlist is not optimized
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(positional[0], circuit, circuitName, false)) return 1;
+    if (!requireCombinational(circuit)) return 1;
+    vector<uint32_t> delays;
+    if (!loadGateDelays(circuit, delayPath, delays)) return 1;
+    
+    FILE *vectorFile = (positional[1] == "-") ? stdin : fopen(positional[1].c_str(), "rb");
+    if (!vectorFile) {
+        cerr << "❌ Error: Could not open vector file '" << positional[1] << "'.\n";
+        return 1;
+    }
+    FILE *outFile = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << outputPath << "'.\n";
+        if (vectorFile != stdin) fclose(vectorFile);
+        return 1;
+    }
+    
+    // Vectors depend on the state the previous one left, so they run in order
+    const size_t nInputs = circuit.primaryInputIds.size();
+    const size_t nOutputs = circuit.primaryOutputIds.size();
+    TimedSimulator sim(circuit, delays);
+    uint64_t nVectors = 0, glitchyVectors = 0, maxSettle = 0;
+    bool ok;
+    {
+        OutputBuffer out(outFile);
+        VectorReader reader(vectorFile, positional[1], nInputs, SCALAR_TASK_VECTORS * PIPELINE_CHUNK_TASKS, false);
+        string text;
+        char tail[64];
+        while (true) {
+            const VectorChunk &chunk = reader.next();
+            for (size_t v = 0; v < chunk.count; v++) {
+                const char *bits = chunk.bits.data() + v * nInputs;
+                uint64_t glitches;
+                const uint64_t settle = sim.apply(bits, glitches);
+                maxSettle = max(maxSettle, settle);
+                glitchyVectors += (glitches > 0);
+                if (summaryOnly) continue;
+                for (size_t i = 0; i < nInputs; i++) text.push_back(static_cast<char>('0' + bits[i]));
+                text.push_back(' ');
+                for (int id : circuit.primaryOutputIds) {
+                    text.push_back(id < 0 ? '-' : static_cast<char>('0' + sim.value(id)));
+                }
+                snprintf(tail, sizeof(tail), " t=%llu glitches=%llu\n", static_cast<unsigned long long>(settle),
+                         static_cast<unsigned long long>(glitches));
+                text += tail;
+            }
+            nVectors += chunk.count;
+            const bool last = chunk.last;
+            reader.release();
+            out.appendLines(text);
+            text.clear();
+            if (last) break;
+        }
+        ok = !reader.failed();
         
-        // Connect gate to output
-        dot << "    " << gateNode << " -> " << g.out << ";\n";
+        char line[160];
+        snprintf(line, sizeof(line), "# Vectors: %llu, events: %llu, critical path: %llu, latest settle: %llu\n",
+                 static_cast<unsigned long long>(nVectors), static_cast<unsigned long long>(sim.events()),
+                 static_cast<unsigned long long>(criticalPathDelay(circuit, delays)),
+                 static_cast<unsigned long long>(maxSettle));
+        text += line;
+        snprintf(line, sizeof(line), "# Vectors with glitches: %llu\n", static_cast<unsigned long long>(glitchyVectors));
+        text += line;
+        text += "# Output settle transitions glitches glitchy_vectors\n";
+        for (size_t o = 0; o < nOutputs; o++) {
+            const int id = circuit.primaryOutputIds[o];
+            text += string(circuit.outputName(o));
+            if (id < 0) {
+                text += " undefined\n";
+                continue;
+            }
+            const OutputTiming &t = sim.outputTiming(id);
+            snprintf(line, sizeof(line), " %llu %llu %llu %llu\n", static_cast<unsigned long long>(t.settle),
+                     static_cast<unsigned long long>(t.transitions), static_cast<unsigned long long>(t.glitches),
+                     static_cast<unsigned long long>(t.glitchyVectors));
+            text += line;
+        }
+        out.appendLines(text);
+    }
+    if (vectorFile != stdin) fclose(vectorFile);
+    if (outFile != stdout) fclose(outFile);
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief Implements 'circuit cycles NETLIST STIMULUS [options]'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runCyclesCommand(const vector<string> &args) {
+    vector<string> positional;
+    bool autoKernel = true;
+    PackedKernel kernel = PackedKernel::SCALAR;
+    size_t threads = max(1u, thread::hardware_concurrency());
+    uint64_t cycles = 0;
+    string outputPath;
+    bool optimize = false;
+    VcdOptions vcd;
+    
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.rfind("--vcd", 0) == 0) {
+            if (!parseVcdOption(arg, vcd)) return 1;
+        } else if (arg.rfind("--cycles=", 0) == 0) {
+            char *end = nullptr;
+            cycles = strtoull(arg.c_str() + 9, &end, 10);
+            if (arg.size() == 9 || *end != '\0' || cycles == 0) {
+                cerr << "❌ Error: Invalid cycle count '" << arg.substr(9) << "'.\n";
+                return 1;
+            }
+        } else if (arg.rfind("--kernel=", 0) == 0) {
+            autoKernel = (arg.substr(9) == "auto");
+            if (!parseKernelName(arg.substr(9), kernel)) return 1;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!parseThreadCount(arg.substr(10), threads)) return 1;
+        } else if (arg == "--optimize") {
+            optimize = true;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            outputPath = args[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
     }
     
-    dot << "}\n";
-    dot.close();
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(positional[0], circuit, circuitName, optimize)) return 1;
+    
+    const size_t nInputs = circuit.primaryInputIds.size();
+    vector<char> vectors;
+    vector<size_t> streamStarts;
+    if (!loadVectorFile(positional[1], nInputs, vectors, &streamStarts)) return 1;
+    const size_t nVectors = nInputs ? vectors.size() / nInputs : 0;
+    if (nVectors == 0) {
+        cerr << "❌ Error: " << positional[1] << ": no input vectors.\n";
+        return 1;
+    }
     
-    cout << "✓ DOT file saved as '" << filename << "'\n";
+    // By default every stream runs for as long as the longest one
+    if (cycles == 0) {
+        for (size_t j = 0; j < streamStarts.size(); j++) {
+            size_t end = (j + 1 < streamStarts.size()) ? streamStarts[j + 1] : nVectors;
+            cycles = max<uint64_t>(cycles, end - streamStarts[j]);
+        }
+    }
+    if (autoKernel) kernel = streamKernel(streamStarts.size());
     
-    // Attempt to generate PNG with Graphviz
-    string cmd = "dot -Tpng \"" + filename + "\" -o \"" + circuitName + ".png\"";
-    cout << "Attempting to generate circuit diagram...\n";
+    unique_ptr<VcdWriter> vcdWriter;
+    SampleHook hook;
+    if (!vcd.path.empty()) {
+        if (vcd.stream >= streamStarts.size()) {
+            cerr << "❌ Error: No stimulus stream " << vcd.stream << " to dump ("
+                 << streamStarts.size() << " stream(s)).\n";
+            return 1;
+        }
+        vcdWriter = openVcdWriter(circuit, circuitName, vcd);
+        if (!vcdWriter) return 1;
+        hook = [&vcdWriter](const SimState &s, int lane) { vcdWriter->sample(s, lane); };
+    }
     
-    int result = system(cmd.c_str());
-    if (result == 0) {
-        cout << "✓ Circuit diagram saved as '" << circuitName << ".png'\n";
+    FILE *outFile = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << outputPath << "'.\n";
+        return 1;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    {
+        OutputBuffer out(outFile);
+        simulateStreams(circuit, vectors, streamStarts, nVectors, cycles, kernel, threads, out,
+                        hook, vcd.stream);
+    }
+    if (vcdWriter) vcdWriter->finish();
+    if (outFile != stdout) fclose(outFile);
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    
+    cerr << "✓ " << streamStarts.size() << " stream(s) x " << cycles << " cycles, "
+         << circuit.flopCount() << " flip-flop(s), in " << elapsed.count() << " ms\n";
+    return 0;
+}
+
+/**
+ * @brief Implements 'circuit convert NETLIST OUTPUT'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runConvertCommand(vector<string> args) {
+    bool optimize = takeFlag(args, "--optimize");
+    if (args.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(args[0], circuit, circuitName, optimize)) return 1;
+    if (!writeBinaryCircuit(circuit, args[1])) return 1;
+    
+    cerr << "✓ Wrote " << args[1] << ": " << circuit.gateCount() << " gates, "
+         << circuit.nets << " nets, " << circuit.levelCount() << " levels\n";
+    return 0;
+}
+
+/**
+ * @brief Implements 'circuit dot NETLIST OUTPUT [--cone=LIST] [--levels=A[:B]] [--png]'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runDotCommand(vector<string> args) {
+    DotOptions options;
+    bool png = takeFlag(args, "--png");
+    vector<string> positional;
+    for (const auto &arg : args) {
+        if (arg.rfind("--cone=", 0) == 0) {
+            stringstream list(arg.substr(7));
+            string name;
+            while (getline(list, name, ',')) {
+                if (!name.empty()) options.cone.push_back(name);
+            }
+        } else if (arg.rfind("--levels=", 0) == 0) {
+            const string range = arg.substr(9);
+            long first = 0, last = 0;
+            if (!parseRange(range, first, last)) {
+                cerr << "❌ Error: Invalid level range '" << range << "'.\n";
+                return 1;
+            }
+            options.firstLevel = static_cast<uint32_t>(first);
+            options.lastLevel = static_cast<uint32_t>(min<long>(last, UINT32_MAX));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(positional[0], circuit, circuitName, false)) return 1;
+    size_t drawn = 0;
+    if (!writeDot(circuit, positional[1], options, drawn)) return 1;
+    cerr << "✓ Wrote " << positional[1] << ": " << drawn << " of " << circuit.gateCount() << " gates\n";
+    
+    if (png) {
+        const string &dotPath = positional[1];
+        size_t dot = dotPath.find_last_of('.');
+        string pngPath = (dot == string::npos ? dotPath : dotPath.substr(0, dot)) + ".png";
+        DotRenderer renderer;
+        renderer.start(dotPath, pngPath);
+        if (!renderer.wait()) {
+            cerr << "❌ Error: Graphviz 'dot' failed or is not installed.\n";
+            return 1;
+        }
+        cerr << "✓ Rendered " << pngPath << "\n";
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses an input weight (probability of a 1)
+ * @param value Text of the weight
+ * @param weight Receives the weight
+ * @return false, reporting an error on stderr, unless value is a number from 0 to 1
+ */
+bool parseWeight(const string &value, double &weight) {
+    char *end = nullptr;
+    weight = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !(weight >= 0.0 && weight <= 1.0)) {
+        cerr << "❌ Error: Invalid weight '" << value << "' (expected a probability from 0 to 1).\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Implements 'circuit random NETLIST [options]'
+ * @param args Arguments after the command name
+ * @return Exit status
+ */
+int runRandomCommand(const vector<string> &args) {
+    vector<string> positional;
+    uint64_t vectors = 1 << 20, seed = 1;
+    double defaultWeight = 0.5;
+    vector<pair<string, double>> weightList;
+    vector<string> watch;
+    bool jit = false;
+    PackedKernel kernel = detectPackedKernel();
+    size_t threads = max(1u, thread::hardware_concurrency());
+    string outputPath;
+    
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.rfind("--vectors=", 0) == 0 || arg.rfind("--seed=", 0) == 0) {
+            const size_t eq = arg.find('=');
+            const string value = arg.substr(eq + 1);
+            char *end = nullptr;
+            (arg[2] == 'v' ? vectors : seed) = strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                cerr << "❌ Error: Invalid " << arg.substr(0, eq) << " value '" << value << "'.\n";
+                return 1;
+            }
+        } else if (arg.rfind("--default-weight=", 0) == 0) {
+            if (!parseWeight(arg.substr(17), defaultWeight)) return 1;
+        } else if (arg.rfind("--weights=", 0) == 0) {
+            stringstream list(arg.substr(10));
+            string entry;
+            while (getline(list, entry, ',')) {
+                const size_t eq = entry.rfind('=');
+                double weight;
+                if (eq == string::npos || eq == 0) {
+                    cerr << "❌ Error: Expected NET=WEIGHT in --weights, got '" << entry << "'.\n";
+                    return 1;
+                }
+                if (!parseWeight(entry.substr(eq + 1), weight)) return 1;
+                weightList.push_back({entry.substr(0, eq), weight});
+            }
+        } else if (arg.rfind("--watch=", 0) == 0) {
+            stringstream list(arg.substr(8));
+            string name;
+            while (getline(list, name, ',')) {
+                if (!name.empty()) watch.push_back(name);
+            }
+        } else if (arg.rfind("--engine=", 0) == 0) {
+            const string name = arg.substr(9);
+            if (name != "packed" && name != "jit") {
+                cerr << "❌ Error: Unknown engine '" << name << "' (random stimulus runs packed or jit).\n";
+                return 1;
+            }
+            jit = (name == "jit");
+        } else if (arg.rfind("--kernel=", 0) == 0) {
+            if (!parseKernelName(arg.substr(9), kernel)) return 1;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!parseThreadCount(arg.substr(10), threads)) return 1;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            outputPath = args[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 1) {
+        printUsage();
+        return 1;
+    }
+    
+    CompiledCircuit circuit;
+    string circuitName;
+    if (!prepareCircuit(positional[0], circuit, circuitName, false)) return 1;
+    if (!requireCombinational(circuit)) return 1;
+    
+    // Weights by input position; later entries for the same input win
+    const size_t nInputs = circuit.primaryInputIds.size();
+    vector<double> weights(nInputs, defaultWeight);
+    for (const auto &entry : weightList) {
+        const int id = circuit.findNet(entry.first);
+        auto it = find(circuit.primaryInputIds.begin(), circuit.primaryInputIds.end(), id);
+        if (id < 0 || it == circuit.primaryInputIds.end()) {
+            cerr << "❌ Error: No primary input named '" << entry.first << "' to weight.\n";
+            return 1;
+        }
+        weights[it - circuit.primaryInputIds.begin()] = entry.second;
+    }
+    RandomStimulus stimulus(seed, weights);
+    
+    // Watched nets replace the primary outputs
+    vector<int32_t> nets;
+    vector<string> names;
+    if (watch.empty()) {
+        for (size_t o = 0; o < circuit.primaryOutputIds.size(); o++) {
+            nets.push_back(circuit.primaryOutputIds[o]);
+            names.push_back(string(circuit.outputName(o)));
+        }
     } else {
-        cout << "⚠ Graphviz 'dot' command not found.\n";
-        cout << "  Install Graphviz (https://graphviz.org/) to generate circuit diagrams.\n";
-        cout << "  You can still use the .dot file for manual visualization.\n";
+        for (const auto &name : watch) {
+            const int id = circuit.findNet(name);
+            if (id < 0) {
+                cerr << "❌ Error: No net named '" << name << "' to watch.\n";
+                return 1;
+            }
+            nets.push_back(id);
+            names.push_back(name);
+        }
+    }
+    vector<int32_t> defined;
+    for (int id : nets) {
+        if (id >= 0) defined.push_back(id);
     }
+    
+    unique_ptr<NativeSweep> native;
+    if (jit) {
+        native.reset(new NativeSweep());
+        string error;
+        if (!packedKernelSupported(kernel)) kernel = PackedKernel::SCALAR;
+        bool storeAllNets = false;
+        for (int id : defined) {
+            if (find(circuit.primaryOutputIds.begin(), circuit.primaryOutputIds.end(), id) ==
+                circuit.primaryOutputIds.end()) storeAllNets = true;
+        }
+        if (!native->load(circuit, kernel, error, storeAllNets)) {
+            cerr << "⚠ JIT unavailable (" << error << "); using the packed engine.\n";
+            native.reset();
+        } else if (native->compileTime().count() > 0) {
+            cerr << "✓ JIT: compiled " << circuit.gateCount() << " gates in " << native->compileTime().count() << " ms\n";
+        }
+    }
+    
+    FILE *outFile = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << outputPath << "'.\n";
+        return 1;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    vector<NetActivity> activity;
+    simulateRandomStimulus(circuit, stimulus, vectors, defined, kernel, threads, native.get(), activity);
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    
+    char line[160];
+    snprintf(line, sizeof(line), "# Vectors: %llu, seed: %llu\n", static_cast<unsigned long long>(vectors),
+             static_cast<unsigned long long>(seed));
+    string text = line;
+    string weighted;
+    for (size_t i = 0; i < nInputs; i++) {
+        if (stimulus.weight(i) == 0.5) continue;
+        snprintf(line, sizeof(line), "%s%s=%g", weighted.empty() ? "" : " ",
+                 string(circuit.netName(circuit.primaryInputIds[i])).c_str(), stimulus.weight(i));
+        weighted += line;
+    }
+    if (!weighted.empty()) text += "# Weights: " + weighted + "\n";
+    text += "# Net probability toggles toggle_rate\n";
+    for (size_t j = 0, d = 0; j < nets.size(); j++) {
+        if (nets[j] < 0) {
+            text += names[j] + " undefined\n";
+            continue;
+        }
+        const NetActivity &a = activity[d++];
+        snprintf(line, sizeof(line), " %.6f %llu %.6f\n", vectors ? static_cast<double>(a.ones) / vectors : 0.0,
+                 static_cast<unsigned long long>(a.toggles),
+                 vectors > 1 ? static_cast<double>(a.toggles) / (vectors - 1) : 0.0);
+        text += names[j] + line;
+    }
+    {
+        OutputBuffer out(outFile);
+        out.appendLines(text);
+    }
+    if (outFile != stdout) fclose(outFile);
+    
+    const double seconds = max<double>(static_cast<double>(elapsed.count()), 1.0) / 1000.0;
+    snprintf(line, sizeof(line), "✓ %llu random vectors in %lld ms (%.1f M vectors/s)\n",
+             static_cast<unsigned long long>(vectors), static_cast<long long>(elapsed.count()),
+             vectors / seconds / 1e6);
+    cerr << line;
+    return 0;
 }
 
 /**
- * @brief Converts a string to uppercase for case-insensitive comparisons
- * @param str Input string
- * @return Uppercase version of the input string
+ * @brief Implements 'circuit equiv NETLIST1 NETLIST2 [options]'
+ * @param args Arguments after the command name
+ * @return 0 if equivalent, 2 if not, 3 if undecided, 1 on errors
  */
-string toUpper(string str) {
-    transform(str.begin(), str.end(), str.begin(), ::toupper);
-    return str;
+int runEquivCommand(const vector<string> &args) {
+    vector<string> positional;
+    EquivOptions options;
+    for (const auto &arg : args) {
+        const size_t eq = arg.find('=');
+        const string name = arg.substr(0, eq);
+        uint64_t *target = (name == "--vectors") ? &options.randomVectors
+                         : (name == "--seed") ? &options.seed
+                         : (name == "--conflicts") ? &options.conflictLimit : nullptr;
+        if (!target) {
+            positional.push_back(arg);
+            continue;
+        }
+        char *end = nullptr;
+        const string value = (eq == string::npos) ? string() : arg.substr(eq + 1);
+        *target = strtoull(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0') {
+            cerr << "❌ Error: Invalid " << name << " value '" << value << "'.\n";
+            return 1;
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    
+    // Both netlists are compared as written
+    CompiledCircuit circuits[2];
+    for (int side = 0; side < 2; side++) {
+        string circuitName;
+        if (!prepareCircuit(positional[side], circuits[side], circuitName, false)) return 1;
+        if (!requireCombinational(circuits[side])) return 1;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    EquivResult result;
+    if (!checkEquivalence(circuits[0], circuits[1], options, result)) return 1;
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    
+    cout << "# Inputs: " << result.inputs.size() << ", outputs compared: " << result.outputs.size() << "\n";
+    cout << "# Simulated " << result.simulated << " vector(s)" << (result.exhaustive ? " (exhaustive)" : "") << "\n";
+    if (!result.exhaustive && result.verdict != EquivVerdict::DIFFERENT) {
+        cout << "# Proof: " << result.structural << " output(s) structurally identical, " << result.proven
+             << " proven by SAT, " << result.undecided.size() << " undecided\n";
+    }
+    
+    int status = 0;
+    if (result.verdict == EquivVerdict::DIFFERENT) {
+        // The mismatch is replayed on both circuits to list every differing output
+        SimState states[2];
+        for (int side = 0; side < 2; side++) {
+            const CompiledCircuit &c = circuits[side];
+            initSimState(c, states[side], PackedKernel::SCALAR);
+            for (int id : c.primaryInputIds) {
+                size_t i = lower_bound(result.inputs.begin(), result.inputs.end(), c.netName(id)) - result.inputs.begin();
+                states[side].netValues[id] = result.counterexample[i];
+            }
+            simulate(c, states[side]);
+        }
+        string vector;
+        for (char bit : result.counterexample) vector.push_back(static_cast<char>('0' + bit));
+        cout << "Not equivalent: " << (result.foundBySat ? "SAT counterexample" : "first mismatching vector")
+             << " " << vector << "\n";
+        cout << "  Inputs:";
+        for (size_t i = 0; i < result.inputs.size(); i++) {
+            cout << " " << result.inputs[i] << "=" << static_cast<int>(result.counterexample[i]);
+        }
+        cout << "\n";
+        for (size_t o = 0; o < result.outputs.size(); o++) {
+            const string &name = result.outputs[o];
+            int values[2];
+            for (int side = 0; side < 2; side++) {
+                const CompiledCircuit &c = circuits[side];
+                for (size_t k = 0; k < c.primaryOutputIds.size(); k++) {
+                    if (c.outputName(k) == name) values[side] = states[side].netValues[c.primaryOutputIds[k]];
+                }
+            }
+            if (values[0] != values[1]) cout << "  " << name << ": " << values[0] << " vs " << values[1] << "\n";
+        }
+        status = 2;
+    } else if (result.verdict == EquivVerdict::UNDECIDED) {
+        cout << "Undecided: no proof within " << options.conflictLimit << " conflicts for";
+        for (const auto &name : result.undecided) cout << " " << name;
+        cout << "\n";
+        status = 3;
+    } else {
+        cout << "Equivalent\n";
+    }
+    cerr << "✓ Checked in " << elapsed.count() << " ms\n";
+    return status;
 }
 
 /**
- * @brief Validates if a gate type is supported
- * @param type Gate type to validate
- * @return true if the gate type is supported, false otherwise
+ * @brief Runs the bench command
+ * @param args Options: --scale=N, --vectors=N, --engines=LIST, --threads=N, -o FILE
+ * @return Exit status
  */
-bool isValidGateType(const string& type) {
-    return type == "AND" || type == "OR" || type == "NAND" || type == "NOR" || 
-           type == "XOR" || type == "XNOR" || type == "NOT";
+int runBenchCommand(const vector<string> &args) {
+    size_t scale = 1;
+    size_t vectors = 4096;
+    size_t threads = max(1u, thread::hardware_concurrency());
+    vector<string> engines = {"scalar", "event", "packed", "threaded", "level"};
+    string outputPath;
+    
+    auto parseCount = [](const string &value, size_t &n) {
+        char *end = nullptr;
+        long v = strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || v < 1) {
+            cerr << "❌ Error: Invalid count '" << value << "'.\n";
+            return false;
+        }
+        n = static_cast<size_t>(v);
+        return true;
+    };
+    
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.rfind("--scale=", 0) == 0) {
+            if (!parseCount(arg.substr(8), scale)) return 1;
+        } else if (arg.rfind("--vectors=", 0) == 0) {
+            if (!parseCount(arg.substr(10), vectors)) return 1;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!parseThreadCount(arg.substr(10), threads)) return 1;
+        } else if (arg.rfind("--engines=", 0) == 0) {
+            engines.clear();
+            stringstream list(arg.substr(10));
+            string name;
+            while (getline(list, name, ',')) {
+                if (find(begin(BENCH_ENGINES), end(BENCH_ENGINES), name) == end(BENCH_ENGINES)) {
+                    cerr << "❌ Error: Unknown engine '" << name << "'.\n";
+                    return 1;
+                }
+                engines.push_back(name);
+            }
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            outputPath = args[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    
+    FILE *outFile = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+    if (!outFile) {
+        cerr << "❌ Error: Could not create output file '" << outputPath << "'.\n";
+        return 1;
+    }
+    bool ok = runBenchmarks(outFile, scale, vectors, engines, threads);
+    if (outFile != stdout) fclose(outFile);
+    return ok ? 0 : 1;
 }
 
 /**
- * @brief Gets the required number of inputs for a specific gate type
- * @param type Gate type
- * @return Number of required inputs, or -1 if invalid gate type
+ * @brief Runs the non-interactive command given on the command line
+ * @param args Command-line arguments after the program name
+ * @return Exit status
  */
-int getRequiredInputs(const string& type) {
-    if (type == "NOT") return 1;
-    if (type == "AND" || type == "OR" || type == "NAND" || 
-        type == "NOR" || type == "XOR" || type == "XNOR") return 2;
-    return -1;  // Invalid gate type
+int runCommandLine(const vector<string> &args) {
+    const string &command = args[0];
+    const vector<string> rest(args.begin() + 1, args.end());
+    
+    if (command == "help" || command == "--help" || command == "-h") {
+        printUsage();
+        return 0;
+    }
+    if (command == "batch") return runBatchCommand(rest);
+    if (command == "truthtable") return runTruthTableCommand(rest);
+    if (command == "convert") return runConvertCommand(rest);
+    if (command == "faultsim") return runFaultSimCommand(rest);
+    if (command == "cycles") return runCyclesCommand(rest);
+    if (command == "timing") return runTimingCommand(rest);
+    if (command == "random") return runRandomCommand(rest);
+    if (command == "equiv") return runEquivCommand(rest);
+    if (command == "dot") return runDotCommand(rest);
+    if (command == "bench") return runBenchCommand(rest);
+    
+    cerr << "❌ Error: Unknown command '" << command << "'.\n";
+    printUsage();
+    return 1;
 }
 
 /**
@@ -201,22 +1290,37 @@ void printHeader() {
     cout << "         Author: Piyush\n";
     cout << "=========================================\n";
     cout << "\nSupported Gates:\n";
-    cout << "  • AND  - Logical AND (2 inputs)\n";
-    cout << "  • OR   - Logical OR (2 inputs)\n";
+    cout << "  • AND  - Logical AND (2+ inputs)\n";
+    cout << "  • OR   - Logical OR (2+ inputs)\n";
     cout << "  • NOT  - Logical NOT (1 input)\n";
-    cout << "  • NAND - NOT AND (2 inputs)\n";
-    cout << "  • NOR  - NOT OR (2 inputs)\n";
-    cout << "  • XOR  - Exclusive OR (2 inputs)\n";
-    cout << "  • XNOR - NOT XOR (2 inputs)\n\n";
+    cout << "  • NAND - NOT AND (2+ inputs)\n";
+    cout << "  • NOR  - NOT OR (2+ inputs)\n";
+    cout << "  • XOR  - Exclusive OR (2+ inputs)\n";
+    cout << "  • XNOR - NOT XOR (2+ inputs)\n";
+    cout << "  • BUF  - Buffer (1 input)\n";
+    cout << "  • CONST0/CONST1 - Constant 0/1 (no inputs)\n\n";
 }
 
 /**
  * @brief Main program function
+ * @param argc Argument count
+ * @param argv Arguments; with none, the simulator runs interactively
  * @return Exit status (0 for success)
  */
-int main() {
+int main(int argc, char *argv[]) {
+    // All output goes through cout or our own buffered FILE writes, never both on one stream
+    ios::sync_with_stdio(false);
+    if (argc > 1) {
+        return runCommandLine(vector<string>(argv + 1, argv + argc));
+    }
+    
     printHeader();
     
+    // The circuit as entered, compiled once the gate list is complete
+    vector<Gate> gates;
+    set<string> primaryInputs;
+    set<string> primaryOutputs;
+    
     // Circuit name input
     string circuitName;
     cout << "Enter circuit name: ";
@@ -267,7 +1371,7 @@ int main() {
     cout << "\n" << string(50, '=') << "\n";
     cout << "GATE DEFINITION PHASE\n";
     cout << string(50, '=') << "\n";
-    cout << "Enter gates one by one. Format: TYPE OUTPUT INPUT1 [INPUT2]\n";
+    cout << "Enter gates one by one. Format: TYPE OUTPUT INPUT1 [INPUT2 ...]\n";
     cout << "Examples:\n";
     cout << "  AND Z A B    (Z = A AND B)\n";
     cout << "  NOT Y X      (Y = NOT X)\n";
@@ -280,48 +1384,19 @@ int main() {
     while (true) {
         string line;
         cout << "Gate " << (gateCount + 1) << ": ";
-        getline(cin, line);
+        if (!getline(cin, line)) break;  // End of input ends the gate list
         
         // Skip empty lines
         if (line.empty()) continue;
         
-        // Parse input line
-        stringstream ss(line);
-        string type;
-        ss >> type;
-        type = toUpper(type);
-        
         // Check for end condition
-        if (type == "END") break;
-        
-        // Validate gate type
-        if (!isValidGateType(type)) {
-            cout << "❌ Error: Unknown gate type '" << type << "'.\n";
-            cout << "   Supported types: AND, OR, NOT, NAND, NOR, XOR, XNOR\n";
-            continue;
-        }
+        if (isEndMarker(line)) break;
         
-        // Parse gate definition
+        // Parse and validate gate definition
         Gate g;
-        g.type = type;
-        ss >> g.out;
-        
-        if (g.out.empty()) {
-            cout << "❌ Error: Output name required.\n";
-            continue;
-        }
-        
-        // Parse inputs
-        string input;
-        while (ss >> input) {
-            g.inputs.push_back(input);
-        }
-        
-        // Validate input count
-        int requiredInputs = getRequiredInputs(type);
-        if (static_cast<int>(g.inputs.size()) != requiredInputs) {
-            cout << "❌ Error: " << type << " gate requires exactly " 
-                 << requiredInputs << " input(s), got " << g.inputs.size() << ".\n";
+        string error;
+        if (!parseGateLine(line, g, error)) {
+            cout << "❌ Error: " << error << "\n";
             continue;
         }
         
@@ -329,7 +1404,7 @@ int main() {
         gates.push_back(g);
         gateCount++;
         
-        cout << "✅ Added gate: " << g.type << " " << g.out;
+        cout << "✅ Added gate: " << gateOpName(g.op) << " " << g.out;
         for (const auto& inp : g.inputs) {
             cout << " " << inp;
         }
@@ -358,57 +1433,128 @@ int main() {
     }
     cout << "\n\n";
     
-    // Generate circuit diagram
-    cout << "Generating circuit visualization...\n";
-    writeDot(circuitName);
-
+    // Resolve net names to dense IDs and sort gates into dependency order
+    CompiledCircuit circuit;
+    string error;
+    if (!compileCircuit(circuit, gates, primaryInputs, primaryOutputs, circuitName, false, error)) {
+        cerr << "❌ Error: " << error << "\n";
+        return 1;
+    }
+    if (!requireCombinational(circuit)) return 1;
+    cout << "Logic Levels: " << circuit.levelCount() << "\n";
+    
+    // Pick the widest bit-parallel kernel this CPU supports
+    SimState state;
+    initSimState(circuit, state, detectPackedKernel());
+    cout << "Packed Kernel: " << PACKED_KERNELS[static_cast<int>(state.packedKernel)].name
+         << " (" << state.packedLanes() << " patterns/pass)\n\n";
+    
+    // Circuit diagram on request ('DOT'): the PNG is rendered in the background
+    DotRenderer renderer;
+    
     // Simulation phase
     cout << "\n" << string(50, '=') << "\n";
     cout << "CIRCUIT SIMULATION\n";
     cout << string(50, '=') << "\n";
     
+    // Nets listed after each vector: all of them, or the outputs plus a watch list
+    bool showAllNets = true;
+    vector<int> watched;
+    string report;  // Reused for every vector, written in one piece
+    
     while (true) {
         cout << "\nEnter values for primary inputs (space-separated):\n";
         cout << "Format: ";
         for (const auto& inp : primaryInputs) {
             cout << inp << " ";
         }
-        cout << "\nInput (or 'EXIT' to quit): ";
+        cout << "\nInput ('TABLE' for the full truth table, 'DOT' for a circuit diagram,\n"
+                "'SHOW ALL|OUTPUTS|net...' to pick the nets listed, 'EXIT' to quit): ";
         
         string inputLine;
-        getline(cin, inputLine);
+        if (!getline(cin, inputLine)) break;  // End of input acts as EXIT
         
         // Check for exit condition
         if (toUpper(inputLine) == "EXIT") break;
         
-        // Parse input values
-        stringstream inputStream(inputLine);
-        values.clear();
+        // Exhaustive truth table via bit-parallel simulation
+        if (toUpper(inputLine) == "TABLE") {
+            printTruthTable(circuit, state);
+            continue;
+        }
         
-        bool validInput = true;
-        auto it = primaryInputs.begin();
-        string valueStr;
+        // Circuit diagram: the DOT file now, the PNG in the background
+        if (toUpper(inputLine) == "DOT") {
+            size_t drawn = 0;
+            if (!writeDot(circuit, circuitName + ".dot", DotOptions(), drawn)) continue;
+            cout << "✓ DOT file saved as '" << circuitName << ".dot'\n";
+            if (circuit.gateCount() <= DOT_RENDER_GATE_LIMIT) {
+                renderer.wait();  // A diagram still being drawn is replaced
+                renderer.start(circuitName + ".dot", circuitName + ".png");
+                cout << "Rendering the circuit diagram in the background...\n";
+            } else {
+                cout << "⚠ " << circuit.gateCount() << " gates: no PNG rendered; draw part of the circuit with\n"
+                     << "  'circuit dot NETLIST OUTPUT --cone=...' or run Graphviz on the .dot file.\n";
+            }
+            continue;
+        }
         
-        // Read input values
-        while (it != primaryInputs.end() && inputStream >> valueStr) {
-            try {
-                int val = stoi(valueStr);
-                if (val != 0 && val != 1) {
-                    cout << "❌ Error: Input values must be 0 or 1.\n";
-                    validInput = false;
+        // Choose what the results list
+        stringstream words(inputLine);
+        string word;
+        words >> word;
+        if (toUpper(word) == "SHOW") {
+            vector<int> nets;
+            bool known = true;
+            while (words >> word) {
+                if (toUpper(word) == "ALL" || toUpper(word) == "OUTPUTS") {
+                    showAllNets = (toUpper(word) == "ALL");
+                    nets.clear();
+                    continue;
+                }
+                int id = circuit.findNet(word);
+                if (id < 0) {
+                    cout << "❌ Error: No net named '" << word << "'.\n";
+                    known = false;
                     break;
                 }
-                values[*it] = val;
-                ++it;
-            } catch (const exception& e) {
-                cout << "❌ Error: Invalid input value '" << valueStr << "'.\n";
+                nets.push_back(id);
+            }
+            if (known) {
+                watched = nets;
+                if (!watched.empty()) showAllNets = false;
+                cout << (showAllNets ? "✓ Showing all nets.\n" : "✓ Showing the outputs and watched nets.\n");
+            }
+            continue;
+        }
+        
+        // Parse input values: whitespace-separated tokens, scanned in place
+        vector<int> inputVector;
+        bool validInput = true;
+        string_view rest(inputLine);
+        while (inputVector.size() < primaryInputs.size()) {
+            size_t start = rest.find_first_not_of(" \t\r");
+            if (start == string_view::npos) break;
+            size_t stop = rest.find_first_of(" \t\r", start);
+            string_view token = rest.substr(start, stop == string_view::npos ? string_view::npos : stop - start);
+            rest.remove_prefix(stop == string_view::npos ? rest.size() : stop);
+            
+            long val = 0;
+            if (!parseDecimal(token, val)) {
+                cout << "❌ Error: Invalid input value '" << token << "'.\n";
                 validInput = false;
                 break;
             }
+            if (val != 0 && val != 1) {
+                cout << "❌ Error: Input values must be 0 or 1.\n";
+                validInput = false;
+                break;
+            }
+            inputVector.push_back(static_cast<int>(val));
         }
         
         // Validate input completeness
-        if (validInput && it != primaryInputs.end()) {
+        if (validInput && inputVector.size() != primaryInputs.size()) {
             cout << "❌ Error: Not enough input values provided.\n";
             validInput = false;
         }
@@ -418,31 +1564,56 @@ int main() {
             continue;
         }
 
-        // Simulate circuit
-        simulate();
+        // Simulate circuit, re-evaluating only the cone of changed inputs
+        for (size_t i = 0; i < inputVector.size(); i++) {
+            setInputValue(circuit, state, circuit.primaryInputIds[i], inputVector[i]);
+        }
+        EventStats stats = simulateEventDriven(circuit, state);
 
         // Display results
-        cout << "\n" << string(40, '-') << "\n";
-        cout << "SIMULATION RESULTS\n";
-        cout << string(40, '-') << "\n";
-        
-        cout << "Inputs:\n";
-        for (const auto& inp : primaryInputs) {
-            cout << "  " << inp << " = " << values[inp] << "\n";
+        auto addValue = [&report](string_view name, int value) {
+            report.append("  ").append(name.data(), name.size()).append(" = ");
+            if (value < 0) report.append("undefined");
+            else report.push_back(static_cast<char>('0' + value));
+            report.push_back('\n');
+        };
+        report.assign("\n").append(40, '-').append("\nSIMULATION RESULTS\n").append(40, '-').append("\n");
+        if (showAllNets) {
+            report.append("Inputs:\n");
+            for (int id : circuit.primaryInputIds) addValue(circuit.netName(id), state.netValues[id]);
+            report.append("\n");
         }
-        
-        cout << "\nOutputs:\n";
-        for (const auto& out : primaryOutputs) {
-            if (values.find(out) != values.end()) {
-                cout << "  " << out << " = " << values[out] << "\n";
-            } else {
-                cout << "  " << out << " = undefined\n";
-            }
+        report.append("Outputs:\n");
+        for (size_t o = 0; o < circuit.primaryOutputIds.size(); o++) {
+            int id = circuit.primaryOutputIds[o];
+            addValue(circuit.outputName(o), id >= 0 ? state.netValues[id] : -1);
         }
-        
-        cout << "\nAll Nets:\n";
-        for (const auto& p : values) {
-            cout << "  " << p.first << " = " << p.second << "\n";
+        if (showAllNets) {
+            report.append("\nAll Nets:\n");
+            for (int id : circuit.netsByName) addValue(circuit.netName(id), state.netValues[id]);
+        } else if (!watched.empty()) {
+            report.append("\nWatched Nets:\n");
+            for (int id : watched) addValue(circuit.netName(id), state.netValues[id]);
+        }
+        report.append("\nGate evaluations: ").append(to_string(stats.evaluated)).append(" of ")
+              .append(to_string(circuit.gateCount())).append(" (").append(to_string(stats.skipped))
+              .append(" skipped)\n");
+        cout << report;
+    }
+    
+    const EventStats &total = state.totalEventStats;
+    if (total.evaluated + total.skipped > 0) {
+        cout << "\nEvent-driven engine: " << total.evaluated << " gate evaluations, "
+             << total.skipped << " skipped\n";
+    }
+
+    if (renderer.started()) {
+        if (renderer.wait()) {
+            cout << "\n✓ Circuit diagram saved as '" << circuitName << ".png'\n";
+        } else {
+            cout << "\n⚠ Graphviz 'dot' command not found.\n";
+            cout << "  Install Graphviz (https://graphviz.org/) to generate circuit diagrams.\n";
+            cout << "  You can still use the .dot file for manual visualization.\n";
         }
     }
 
@@ -0,0 +1,6203 @@
+/**
+ * @file circuitsim.cpp
+ * @brief Digital Circuit Simulator library - netlist compilation and simulation engines
+ * @author Piyush
+ * @date October 2026
+ * @version 1.0
+ *
+ * Everything but the command-line front end: netlist import and
+ * optimization, levelized compilation, the scalar, event-driven, packed,
+ * threaded and JIT engines, fault, timing and equivalence analysis, and
+ * the public API of circuitsim.h. Built as libcircuitsim, which the
+ * 'circuit' program (circuit.cpp) links against.
+ */
+
+#include <iostream>     // For input/output operations
+#include <vector>       // For dynamic arrays (storing gates)
+#include <unordered_map>// For hash maps (net name to net ID lookup)
+#include <string>       // For string operations
+#include <sstream>      // For string stream operations (parsing input)
+#include <fstream>      // For reading gate delay annotations
+#include <set>          // For sets (storing primary inputs/outputs)
+#include <cstdlib>      // For system() function calls
+#include <algorithm>    // For transform function (case conversion)
+#include <cctype>       // For toupper function
+#include <cstdint>      // For fixed-width integer types (gate opcodes, packed words)
+#include <new>          // For aligned operator new (packed net storage)
+#include <cstdio>       // For buffered file I/O (batch mode)
+#include <cstring>      // For memchr/memmove (batch line reader)
+#include <functional>   // For std::function (thread pool tasks)
+#include <thread>       // For worker threads (pattern-parallel batch mode)
+#include <mutex>        // For thread pool synchronization
+#include <condition_variable> // For thread pool wake-ups
+#include <atomic>       // For lock-free task distribution
+#include <memory>       // For unique_ptr/shared_ptr (optional engines, circuit storage)
+#include <string_view>  // For zero-copy net names
+#include <type_traits>  // For remove_reference_t (binary section visitor)
+#include <chrono>       // For JIT compile timing
+#include <charconv>     // For to_chars (DOT export)
+
+// Platform APIs: memory mapping, JIT library loading, resource usage
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>      // For peak working set (benchmarks)
+#include <io.h>         // For _setmode (binary results on stdout)
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dlfcn.h>      // For loading JIT-compiled sweeps
+#include <sys/resource.h> // For peak RSS (benchmarks)
+#include <sys/wait.h>
+#include <spawn.h>      // For running the JIT compiler without a shell
+#include <cerrno>
+
+extern char **environ;
+#endif
+
+#include "circuitsim.h"
+#include "circuitsim_detail.h"
+
+using namespace std;
+
+namespace circuitsim {
+namespace detail {
+
+// GCC/Clang vector extensions give the 256/512-bit lanes the same bitwise
+// operators as uint64_t, so OpKernel works on them unchanged
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define CIRCUIT_X86_WIDE_KERNELS 1
+
+typedef uint64_t Word256 __attribute__((vector_size(32)));
+
+typedef uint64_t Word512 __attribute__((vector_size(64)));
+
+#endif
+
+/// Largest input count of an N-input gate (GateRecord::inputCount is 16 bits)
+const int MAX_GATE_INPUTS = 65535;
+
+/// Table of all supported gate types, indexed by GateOp
+const GateOpInfo GATE_OPS[] = {
+    {"AND",  GateOp::AND,  2, true},
+    {"OR",   GateOp::OR,   2, true},
+    {"NAND", GateOp::NAND, 2, true},
+    {"NOR",  GateOp::NOR,  2, true},
+    {"XOR",  GateOp::XOR,  2, true},
+    {"XNOR", GateOp::XNOR, 2, true},
+    {"NOT",  GateOp::NOT,  1, false},
+    {"BUF",  GateOp::BUF,  1, false},
+    {"CONST0", GateOp::CONST0, 0, false},
+    {"CONST1", GateOp::CONST1, 0, false},
+    {"DFF",    GateOp::DFF,    1, false},
+    {"INST",   GateOp::INST,   0, true},
+};
+
+/**
+ * @brief Looks up the opcode for an (uppercase) gate type name
+ * @param type Gate type name
+ * @return Matching opcode, or GateOp::INVALID if the type is unknown
+ */
+GateOp parseGateOp(const string &type) {
+    for (const auto &info : GATE_OPS) {
+        if (type == info.name) return info.op;
+    }
+    return GateOp::INVALID;
+}
+
+const char *gateOpName(GateOp op) {
+    size_t index = static_cast<size_t>(op);
+    if (index >= sizeof(GATE_OPS) / sizeof(GATE_OPS[0])) return "INVALID";
+    return GATE_OPS[index].name;
+}
+
+/**
+ * @brief Returns the non-inverting form of an opcode (NAND -> AND, NOT -> BUF, ...)
+ * @param op Gate opcode
+ * @return AND, OR, XOR or BUF for the gate families, else op itself
+ */
+GateOp baseGateOp(GateOp op) {
+    switch (op) {
+        case GateOp::NAND: return GateOp::AND;
+        case GateOp::NOR:  return GateOp::OR;
+        case GateOp::XNOR: return GateOp::XOR;
+        case GateOp::NOT:  return GateOp::BUF;
+        default:           return op;
+    }
+}
+
+/// True for gates that invert the result of their family (NAND, NOR, XNOR, NOT)
+bool isInvertingGateOp(GateOp op) {
+    return op != baseGateOp(op);
+}
+
+/**
+ * @brief Returns the opcode computing the complement of op
+ * @param op Gate opcode
+ * @return AND <-> NAND, OR <-> NOR, XOR <-> XNOR, BUF <-> NOT, CONST0 <-> CONST1
+ */
+GateOp invertGateOp(GateOp op) {
+    switch (op) {
+        case GateOp::AND:    return GateOp::NAND;
+        case GateOp::NAND:   return GateOp::AND;
+        case GateOp::OR:     return GateOp::NOR;
+        case GateOp::NOR:    return GateOp::OR;
+        case GateOp::XOR:    return GateOp::XNOR;
+        case GateOp::XNOR:   return GateOp::XOR;
+        case GateOp::BUF:    return GateOp::NOT;
+        case GateOp::NOT:    return GateOp::BUF;
+        case GateOp::CONST0: return GateOp::CONST1;
+        case GateOp::CONST1: return GateOp::CONST0;
+        default:             return op;
+    }
+}
+
+/**
+ * @struct OpKernel
+ * @brief Per-opcode evaluation kernel
+ * 
+ * Each specialization applies one gate operation to the values of its
+ * input nets. The kernels are templated on the value word type so the
+ * same operation can be inlined into any evaluation loop. Results are
+ * bitwise, so callers holding 0/1 values mask the result with 1. The
+ * AND/OR/XOR families take n >= 2 inputs; other gates ignore n.
+ *
+ * The result is written through a reference rather than returned, so the
+ * 256/512-bit lane types never cross a function boundary by value: only
+ * the AVX sweeps, which inline the kernels, see those values in registers.
+ */
+template <GateOp Op> struct OpKernel;
+
+template <> struct OpKernel<GateOp::AND> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int n) {
+        r = v[in[0]] & v[in[1]];
+        for (int k = 2; k < n; k++) r &= v[in[k]];
+    }
+};
+
+template <> struct OpKernel<GateOp::OR> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int n) {
+        r = v[in[0]] | v[in[1]];
+        for (int k = 2; k < n; k++) r |= v[in[k]];
+    }
+};
+
+template <> struct OpKernel<GateOp::XOR> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int n) {
+        r = v[in[0]] ^ v[in[1]];
+        for (int k = 2; k < n; k++) r ^= v[in[k]];
+    }
+};
+
+template <> struct OpKernel<GateOp::NAND> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int n) { OpKernel<GateOp::AND>::apply(r, v, in, n); r = ~r; }
+};
+
+template <> struct OpKernel<GateOp::NOR> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int n) { OpKernel<GateOp::OR>::apply(r, v, in, n); r = ~r; }
+};
+
+template <> struct OpKernel<GateOp::XNOR> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int n) { OpKernel<GateOp::XOR>::apply(r, v, in, n); r = ~r; }
+};
+
+template <> struct OpKernel<GateOp::NOT> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int) { r = ~v[in[0]]; }
+};
+
+template <> struct OpKernel<GateOp::BUF> {
+    template <typename W> static void apply(W &r, const W *v, const int *in, int) { r = v[in[0]]; }
+};
+
+template <> struct OpKernel<GateOp::CONST0> {
+    template <typename W> static void apply(W &r, const W *, const int *, int) { r = W{}; }
+};
+
+template <> struct OpKernel<GateOp::CONST1> {
+    template <typename W> static void apply(W &r, const W *, const int *, int) { r = ~W{}; }
+};
+
+/**
+ * @class CircuitArena
+ * @brief One heap block carved into the arrays of a CompiledCircuit
+ * 
+ * Used in two passes: a sizing pass makes every take() call with no
+ * block allocated (returning nullptr), then allocate() reserves the total
+ * and the same take() calls hand out the arrays. However large the
+ * circuit, its arrays cost one allocation. Every array starts on an
+ * ALIGNMENT boundary.
+ */
+class CircuitArena {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+    
+    /// Next array of count elements (nullptr during the sizing pass)
+    template <typename T>
+    T *take(size_t count) {
+        size_t offset = used;
+        used += (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        return block ? reinterpret_cast<T *>(block.get() + offset) : nullptr;
+    }
+    
+    /// Ends the sizing pass: allocates everything requested so far
+    void allocate() {
+        char *p = static_cast<char *>(::operator new(max(used, ALIGNMENT), align_val_t(ALIGNMENT)));
+        block = shared_ptr<char>(p, [](char *q) { ::operator delete(q, align_val_t(ALIGNMENT)); });
+        used = 0;
+    }
+    
+    /// The block, to be kept alive by the circuit
+    shared_ptr<const void> storage() const { return block; }
+    
+private:
+    shared_ptr<char> block;
+    size_t used = 0;
+};
+
+/**
+ * @class CircuitBuilder
+ * @brief Collects a netlist by net ID and freezes it into a CompiledCircuit
+ * 
+ * Every netlist reader goes through a builder. Net names are interned
+ * into one flat string table as they are first seen (open-addressing hash
+ * of net IDs, no per-name allocations) and gates are appended straight to
+ * fixed-size gate records, so loading costs a handful of growing arrays
+ * however large the netlist is. finish() lays the result out in a single
+ * CircuitArena block.
+ */
+class CircuitBuilder {
+public:
+    CircuitBuilder() : slots(1024, -1) {}
+    
+    /// Net ID of a name, allocating a new net on first use
+    int net(string_view name) {
+        size_t slot = findSlot(name);
+        if (slots[slot] >= 0) return slots[slot];
+        
+        int id = addNetName(name);
+        slots[slot] = id;
+        if (++namedNets * 2 > slots.size()) rehash();
+        return id;
+    }
+    
+    /// Net ID of a name, or -1 if it has not been seen
+    int findNet(string_view name) const { return slots[findSlot(name)]; }
+    
+    /// Allocates a net that net() never returns, for signals introduced by readers
+    int anonymousNet(string_view name) { return addNetName(name); }
+    
+    /// Net driven by a constant gate, created on first use
+    int constantNet(bool value) {
+        int &id = constants[value ? 1 : 0];
+        if (id < 0) {
+            id = anonymousNet(value ? "1'b1" : "1'b0");
+            addGate(value ? GateOp::CONST1 : GateOp::CONST0, id, nullptr, 0);
+        }
+        return id;
+    }
+    
+    void addInput(int id) { inputs.push_back(id); }
+    void addOutput(string_view name) { outputs.emplace_back(name); }
+    
+    /// Appends a gate (a DFF becomes a flip-flop); the input count must match the opcode
+    void addGate(GateOp op, int out, const int *in, size_t count) {
+        if (op == GateOp::DFF) {
+            addFlop(out, in[0], false);
+            return;
+        }
+        GateRecord g = {};
+        g.op = op;
+        g.inputCount = static_cast<uint16_t>(count);
+        g.out = out;
+        g.firstInput = static_cast<uint32_t>(fanins.size());
+        gates.push_back(g);
+        fanins.insert(fanins.end(), in, in + count);
+    }
+    
+    /// Appends a flip-flop latching net d into net q on every clock
+    void addFlop(int q, int d, bool resetValue) { flops.push_back({q, d, resetValue}); }
+    
+    /**
+     * @brief Appends an AND/OR/NAND/NOR/XOR/XNOR gate of any width
+     * @param op Gate opcode (BUF and NOT take exactly one input)
+     * @param out Output net ID
+     * @param in Input net IDs (at least one); used as scratch space
+     * 
+     * A single input becomes a BUF (or a NOT for the inverting gates).
+     * Inputs beyond MAX_GATE_INPUTS are folded into inner gates of the
+     * non-inverting form.
+     */
+    void addWideGate(GateOp op, int out, vector<int> &in) {
+        if (in.size() == 1 || op == GateOp::BUF || op == GateOp::NOT) {
+            GateOp single = isInvertingGateOp(op) ? GateOp::NOT : GateOp::BUF;
+            addGate(single, out, in.data(), 1);
+            return;
+        }
+        while (in.size() > static_cast<size_t>(MAX_GATE_INPUTS)) {
+            int temp = anonymousNet(string(netName(out)) + "$" + to_string(tempCount++));
+            addGate(baseGateOp(op), temp, in.data() + in.size() - MAX_GATE_INPUTS, MAX_GATE_INPUTS);
+            in.resize(in.size() - MAX_GATE_INPUTS);
+            in.push_back(temp);
+        }
+        addGate(op, out, in.data(), in.size());
+    }
+    
+    size_t netCount() const { return offsets.size(); }
+    size_t gateCount() const { return gates.size(); }
+    size_t flopCount() const { return flops.size(); }
+    string_view netName(int id) const { return string_view(chars.data() + offsets[id]); }
+    
+    /// Why the last finish() or optimization pass failed
+    const string &error() const { return problem; }
+    
+    /**
+     * @brief Levelizes the netlist and moves it into a compiled circuit
+     * @param c Receives the circuit
+     * @param circuitName Circuit name to record
+     * @return false (see error()) if the netlist cannot be levelized
+     * 
+     * Primary inputs and outputs are sorted by name and deduplicated.
+     * The builder is left empty.
+     */
+    bool finish(CompiledCircuit &c, string_view circuitName);
+    
+    /**
+     * @brief Merges gates to shrink the evaluation graph
+     * @return false (see error()) if the netlist cannot be levelized
+     * 
+     * Works in dependency order, so whole chains collapse in one pass:
+     * - AND/OR chains merge into one N-input gate (AND(AND(a,b),c) = AND(a,b,c),
+     *   also under a NAND/NOR root)
+     * - XOR/XNOR trees merge likewise, absorbing inverters by flipping polarity
+     * - NOT of a gate folds into its inverted form (NOT(AND) = NAND, NOT(NOT(a)) = a)
+     * - AND/OR/NAND/NOR whose inputs are all inverters apply De Morgan
+     *   (AND(NOT a, NOT b) = NOR(a, b))
+     * - BUFs are bypassed
+     * Only nets with a single reader that are not primary outputs are
+     * removed, so every primary output keeps its value. Nets left
+     * unused are dropped.
+     */
+    bool fuseGates();
+    
+    /**
+     * @brief Folds gates whose value is fixed by constant inputs
+     * @return false (see error()) if the netlist cannot be levelized
+     * 
+     * Constants flow forward in dependency order: a controlling input
+     * (0 for AND, 1 for OR) fixes the output, other constant inputs are
+     * dropped (XOR inputs flip the polarity), repeated AND/OR inputs
+     * collapse and repeated XOR input pairs cancel. Gates left with a
+     * single input become BUF/NOT. Constant gates no longer read by
+     * anything are removed; the logic that fed them is left for
+     * removeDeadLogic().
+     */
+    bool propagateConstants();
+    
+    /**
+     * @brief Removes gates outside the transitive fanin of the primary outputs
+     * @return false (see error()) if the netlist cannot be levelized
+     */
+    bool removeDeadLogic();
+    
+    /**
+     * @brief Merges structurally identical gates
+     * @return false (see error()) if the netlist cannot be levelized
+     * 
+     * Gates with the same opcode and the same set of inputs (in any order)
+     * compute the same value; readers of every duplicate are redirected to
+     * the first one, working in dependency order so duplicated cones
+     * collapse completely. Duplicates driving a primary output are kept.
+     */
+    bool hashGates();
+    
+private:
+    size_t findSlot(string_view name) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = hash<string_view>()(name) & mask;
+        while (slots[slot] >= 0 && netName(slots[slot]) != name) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+    
+    int addNetName(string_view name) {
+        offsets.push_back(static_cast<uint32_t>(chars.size()));
+        chars.insert(chars.end(), name.begin(), name.end());
+        chars.push_back('\0');
+        return static_cast<int>(offsets.size() - 1);
+    }
+    
+    void rehash() {
+        vector<int32_t> old(slots.size() * 2, -1);
+        old.swap(slots);
+        for (int32_t id : old) {
+            if (id >= 0) slots[findSlot(netName(id))] = id;
+        }
+    }
+    
+    bool levelize(vector<uint32_t> &levelOf, uint32_t &levels);
+    
+    /// Gate indices in dependency order; false (see error()) if the netlist cannot be levelized
+    bool dependencyOrder(vector<uint32_t> &order) {
+        vector<uint32_t> levelOf, levelOffsets;
+        uint32_t levels = 0;
+        if (!levelize(levelOf, levels)) return false;
+        order = levelOrder(levelOf, levels, levelOffsets);
+        return true;
+    }
+    
+    /// Flags of the nets seen outside the logic (primary outputs and flip-flop inputs), by net ID
+    vector<char> observedNets() const {
+        vector<char> observed(netCount(), 0);
+        for (const auto &output : outputs) {
+            int id = findNet(output);
+            if (id >= 0) observed[id] = 1;
+        }
+        for (const auto &f : flops) {
+            observed[f.d] = 1;
+        }
+        return observed;
+    }
+    
+    /// Replaces the inputs of a gate (in place when they fit)
+    void setGateInputs(GateRecord &g, const vector<int> &in) {
+        if (in.size() > g.inputCount) {
+            g.firstInput = static_cast<uint32_t>(fanins.size());
+            fanins.resize(fanins.size() + in.size());
+        }
+        g.inputCount = static_cast<uint16_t>(in.size());
+        copy(in.begin(), in.end(), fanins.begin() + g.firstInput);
+    }
+    
+    /// Drops the flagged gates and any nets no longer used
+    void removeGates(const vector<char> &dead);
+    
+    /// Gate indices in level order (definition order within a level); fills levelOffsets
+    static vector<uint32_t> levelOrder(const vector<uint32_t> &levelOf, uint32_t levels,
+                                       vector<uint32_t> &levelOffsets) {
+        levelOffsets.assign(levels ? levels + 1 : 0, 0);
+        for (uint32_t level : levelOf) {
+            levelOffsets[level + 1]++;
+        }
+        for (size_t l = 1; l < levelOffsets.size(); l++) {
+            levelOffsets[l] += levelOffsets[l - 1];
+        }
+        vector<uint32_t> order(levelOf.size());
+        vector<uint32_t> next(levelOffsets.begin(), levelOffsets.end() - (levels ? 1 : 0));
+        for (size_t i = 0; i < levelOf.size(); i++) {
+            order[next[levelOf[i]]++] = static_cast<uint32_t>(i);
+        }
+        return order;
+    }
+    
+    vector<char> chars;             ///< Net names, NUL-terminated
+    vector<uint32_t> offsets;       ///< Start of each net name in chars
+    vector<int32_t> slots;          ///< Name hash table of net IDs (-1 = empty)
+    size_t namedNets = 0;
+    size_t tempCount = 0;
+    int constants[2] = {-1, -1};
+    
+    vector<int32_t> inputs;
+    vector<string> outputs;
+    vector<GateRecord> gates;     ///< Gates in definition order
+    vector<int32_t> fanins;
+    
+    /// A flip-flop of the netlist being built
+    struct FlopRecord {
+        int q;              ///< Output net
+        int d;              ///< Input net
+        bool resetValue;    ///< Value before the first clock
+    };
+    vector<FlopRecord> flops;     ///< Flip-flops in definition order
+    
+    string problem;               ///< Reason levelize() failed
+};
+
+/**
+ * @brief Assigns logic levels to the builder's gates
+ * @param levelOf Receives the level of each gate, in definition order
+ * @param levels Receives the number of levels
+ * @return true on success, false (setting problem) if the netlist cannot be levelized
+ * 
+ * A gate's level is one more than the highest level of the gates driving
+ * its inputs; gates fed only by primary inputs, flip-flop outputs or
+ * undriven nets are level 0. Nets driven by more than one gate or
+ * flip-flop, gates driving a primary input, and combinational loops
+ * are reported as errors. Loops through a flip-flop are fine.
+ */
+bool CircuitBuilder::levelize(vector<uint32_t> &levelOf, uint32_t &levels) {
+    const size_t nGates = gates.size();
+    const size_t nNets = netCount();
+    
+    // Find the driving gate of every net
+    vector<int> driver(nNets, -1);
+    for (int id : inputs) {
+        driver[id] = -2;  // Driven from outside the circuit
+    }
+    for (const auto &f : flops) {
+        if (driver[f.q] != -1) {
+            problem = "Flip-flop output '" + string(netName(f.q)) + "' is " +
+                      (driver[f.q] == -2 ? "a primary input." : "driven by another flip-flop.");
+            return false;
+        }
+        driver[f.q] = -3;  // Driven by a flip-flop
+    }
+    for (size_t i = 0; i < nGates; i++) {
+        const GateRecord &g = gates[i];
+        if (driver[g.out] == -3) {
+            problem = "Net '" + string(netName(g.out)) + "' is driven by both a gate and a flip-flop.";
+            return false;
+        }
+        if (driver[g.out] == -2) {
+            problem = "Gate " + string(gateOpName(g.op)) + " " + string(netName(g.out)) +
+                      " drives primary input '" + string(netName(g.out)) + "'.";
+            return false;
+        }
+        if (driver[g.out] >= 0) {
+            problem = "Net '" + string(netName(g.out)) + "' is driven by more than one gate.";
+            return false;
+        }
+        driver[g.out] = static_cast<int>(i);
+    }
+    
+    // Count the distinct gate-driven inputs of each gate and index readers by net
+    auto firstUse = [this](const GateRecord &g, uint32_t j) {
+        const int32_t *in = fanins.data() + g.firstInput;
+        return find(in, in + j, in[j]) == in + j;
+    };
+    vector<int> pending(nGates, 0);
+    vector<uint32_t> readerOffsets(nNets + 1, 0);
+    for (size_t i = 0; i < nGates; i++) {
+        const GateRecord &g = gates[i];
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            int in = fanins[g.firstInput + j];
+            if (driver[in] >= 0 && firstUse(g, j)) {
+                pending[i]++;
+                readerOffsets[in + 1]++;
+            }
+        }
+    }
+    for (size_t id = 1; id <= nNets; id++) {
+        readerOffsets[id] += readerOffsets[id - 1];
+    }
+    vector<int> readers(readerOffsets.back());
+    vector<uint32_t> next(readerOffsets.begin(), readerOffsets.end() - 1);
+    for (size_t i = 0; i < nGates; i++) {
+        const GateRecord &g = gates[i];
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            int in = fanins[g.firstInput + j];
+            if (driver[in] >= 0 && firstUse(g, j)) readers[next[in]++] = static_cast<int>(i);
+        }
+    }
+    
+    // Kahn's algorithm: a gate is ready once all of its drivers are placed
+    levelOf.assign(nGates, 0);
+    vector<int> ready;
+    for (size_t i = 0; i < nGates; i++) {
+        if (pending[i] == 0) ready.push_back(static_cast<int>(i));
+    }
+    
+    size_t placed = 0;
+    uint32_t maxLevel = 0;
+    while (!ready.empty()) {
+        int gi = ready.back();
+        ready.pop_back();
+        placed++;
+        maxLevel = max(maxLevel, levelOf[gi]);
+        
+        int out = gates[gi].out;
+        for (uint32_t k = readerOffsets[out]; k < readerOffsets[out + 1]; k++) {
+            int succ = readers[k];
+            levelOf[succ] = max(levelOf[succ], levelOf[gi] + 1);
+            if (--pending[succ] == 0) ready.push_back(succ);
+        }
+    }
+    
+    if (placed != nGates) {
+        // Every unplaced gate has an unplaced driver, so walking drivers
+        // from any unplaced gate must eventually revisit one: that is a loop
+        vector<int> visitOrder(nGates, -1);
+        vector<int> path;
+        int gi = 0;
+        while (pending[gi] == 0) gi++;
+        while (visitOrder[gi] < 0) {
+            visitOrder[gi] = static_cast<int>(path.size());
+            path.push_back(gi);
+            const GateRecord &g = gates[gi];
+            for (uint32_t j = 0; j < g.inputCount; j++) {
+                int in = fanins[g.firstInput + j];
+                if (driver[in] >= 0 && pending[driver[in]] > 0) {
+                    gi = driver[in];
+                    break;
+                }
+            }
+        }
+        
+        problem = "Combinational loop detected: ";
+        for (size_t k = visitOrder[gi]; k < path.size(); k++) {
+            problem.append(netName(gates[path[k]].out)).append(" <- ");
+        }
+        problem.append(netName(gates[gi].out));
+        return false;
+    }
+    
+    levels = nGates ? maxLevel + 1 : 0;
+    return true;
+}
+
+bool CircuitBuilder::fuseGates() {
+    vector<uint32_t> order;
+    if (!dependencyOrder(order)) return false;
+    
+    const size_t nNets = netCount();
+    vector<int> driver(nNets, -1);
+    vector<uint32_t> readers(nNets, 0);
+    for (size_t i = 0; i < gates.size(); i++) {
+        driver[gates[i].out] = static_cast<int>(i);
+        for (uint32_t j = 0; j < gates[i].inputCount; j++) {
+            readers[fanins[gates[i].firstInput + j]]++;
+        }
+    }
+    const vector<char> observed = observedNets();
+    vector<int> alias(nNets);
+    for (size_t id = 0; id < nNets; id++) {
+        alias[id] = static_cast<int>(id);
+    }
+    vector<char> dead(gates.size(), 0);
+    
+    // The gate driving a net that only one gate reads and nothing observes, or -1
+    auto absorbable = [&](int net) {
+        return (readers[net] == 1 && !observed[net]) ? driver[net] : -1;
+    };
+    auto inputsOf = [this](int gi) {
+        return fanins.data() + gates[gi].firstInput;
+    };
+    
+    vector<int> in, fused;
+    for (uint32_t gi : order) {
+        GateRecord &g = gates[gi];
+        GateOp op = g.op;
+        in.clear();
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            in.push_back(alias[fanins[g.firstInput + j]]);
+        }
+        
+        GateOp base = baseGateOp(op);
+        if (base == GateOp::AND || base == GateOp::OR || base == GateOp::XOR) {
+            // Splice in the inputs of same-family drivers (and, for XOR, inverters)
+            fused.clear();
+            bool invert = false;
+            for (size_t k = 0; k < in.size(); k++) {
+                int d = absorbable(in[k]);
+                GateOp dop = (d >= 0) ? gates[d].op : GateOp::INVALID;
+                bool sameFamily = (base == GateOp::XOR) ? (baseGateOp(dop) == GateOp::XOR) : (dop == base);
+                size_t width = fused.size() + (in.size() - k - 1) + (d >= 0 ? gates[d].inputCount : 1);
+                if (sameFamily && width <= static_cast<size_t>(MAX_GATE_INPUTS)) {
+                    fused.insert(fused.end(), inputsOf(d), inputsOf(d) + gates[d].inputCount);
+                    invert ^= isInvertingGateOp(dop);
+                } else if (base == GateOp::XOR && dop == GateOp::NOT) {
+                    fused.push_back(inputsOf(d)[0]);
+                    invert = !invert;
+                } else {
+                    fused.push_back(in[k]);
+                    continue;
+                }
+                readers[in[k]] = 0;
+                dead[d] = 1;
+            }
+            in.swap(fused);
+            if (invert) op = invertGateOp(op);
+            
+            // De Morgan: AND/OR of inverters only
+            bool allInverted = (base != GateOp::XOR);
+            for (int net : in) {
+                int d = absorbable(net);
+                allInverted = allInverted && d >= 0 && gates[d].op == GateOp::NOT;
+            }
+            if (allInverted) {
+                for (int &net : in) {
+                    int d = driver[net];
+                    readers[net] = 0;
+                    dead[d] = 1;
+                    net = inputsOf(d)[0];
+                }
+                GateOp flipped = (base == GateOp::AND) ? GateOp::OR : GateOp::AND;
+                op = isInvertingGateOp(op) ? flipped : invertGateOp(flipped);
+            }
+        } else if (op == GateOp::NOT) {
+            // NOT of a gate becomes the inverted gate
+            int d = absorbable(in[0]);
+            if (d >= 0) {
+                readers[in[0]] = 0;
+                dead[d] = 1;
+                op = invertGateOp(gates[d].op);
+                in.assign(inputsOf(d), inputsOf(d) + gates[d].inputCount);
+            }
+        }
+        
+        // Bypass buffers: readers of the output read the input instead
+        if (op == GateOp::BUF && !observed[g.out]) {
+            alias[g.out] = in[0];
+            readers[in[0]] += readers[g.out] - 1;
+            dead[gi] = 1;
+            continue;
+        }
+        
+        g.op = op;
+        setGateInputs(g, in);
+    }
+    removeGates(dead);
+    return true;
+}
+
+void CircuitBuilder::removeGates(const vector<char> &dead) {
+    // Rebuild with only the surviving gates and the nets they use
+    CircuitBuilder compact;
+    vector<int> remap(netCount(), -1);
+    auto mapNet = [&](int id) {
+        if (remap[id] < 0) {
+            string_view name = netName(id);
+            remap[id] = (findNet(name) == id) ? compact.net(name) : compact.anonymousNet(name);
+        }
+        return remap[id];
+    };
+    for (int id : inputs) {
+        compact.addInput(mapNet(id));
+    }
+    vector<int> in;
+    for (size_t i = 0; i < gates.size(); i++) {
+        if (dead[i]) continue;
+        const GateRecord &g = gates[i];
+        in.clear();
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            in.push_back(mapNet(fanins[g.firstInput + j]));
+        }
+        compact.addGate(g.op, mapNet(g.out), in.data(), in.size());
+    }
+    for (const auto &f : flops) {
+        compact.addFlop(mapNet(f.q), mapNet(f.d), f.resetValue);
+    }
+    compact.outputs.swap(outputs);
+    compact.tempCount = tempCount;
+    *this = move(compact);
+}
+
+bool CircuitBuilder::propagateConstants() {
+    vector<uint32_t> order;
+    if (!dependencyOrder(order)) return false;
+    
+    vector<signed char> value(netCount(), -1);  // Known constant value of each net, or -1
+    vector<int> in;
+    for (uint32_t gi : order) {
+        GateRecord &g = gates[gi];
+        const GateOp base = baseGateOp(g.op);
+        bool invert = isInvertingGateOp(g.op);
+        in.assign(fanins.begin() + g.firstInput, fanins.begin() + g.firstInput + g.inputCount);
+        
+        int result = -1;
+        if (g.op == GateOp::CONST0 || g.op == GateOp::CONST1) {
+            result = (g.op == GateOp::CONST1);
+        } else if (base == GateOp::BUF) {
+            if (value[in[0]] >= 0) result = value[in[0]] ^ invert;
+        } else if (base == GateOp::AND || base == GateOp::OR) {
+            // A controlling input fixes the output; the other constants drop out
+            const int controlling = (base == GateOp::AND) ? 0 : 1;
+            size_t kept = 0;
+            for (int net : in) {
+                if (value[net] == controlling) result = controlling ^ invert;
+                if (value[net] < 0) in[kept++] = net;
+            }
+            in.resize(kept);
+            sort(in.begin(), in.end());
+            in.erase(unique(in.begin(), in.end()), in.end());
+            if (result < 0 && in.empty()) result = (1 - controlling) ^ invert;
+        } else if (base == GateOp::XOR) {
+            // Constant 1 inputs flip the output; equal inputs cancel in pairs
+            size_t kept = 0;
+            for (int net : in) {
+                if (value[net] >= 0) invert ^= (value[net] == 1);
+                else in[kept++] = net;
+            }
+            in.resize(kept);
+            sort(in.begin(), in.end());
+            kept = 0;
+            for (size_t k = 0; k < in.size(); k++) {
+                if (k + 1 < in.size() && in[k] == in[k + 1]) k++;
+                else in[kept++] = in[k];
+            }
+            in.resize(kept);
+            if (in.empty()) result = invert;
+        }
+        
+        if (result >= 0) {
+            value[g.out] = static_cast<signed char>(result);
+            g.op = result ? GateOp::CONST1 : GateOp::CONST0;
+            g.inputCount = 0;
+            continue;
+        }
+        if (base != GateOp::BUF) {
+            if (in.size() == 1) g.op = invert ? GateOp::NOT : GateOp::BUF;
+            else g.op = invert ? invertGateOp(base) : base;
+            setGateInputs(g, in);
+        }
+    }
+    
+    // Drop constant gates nothing reads any more
+    const vector<char> observed = observedNets();
+    vector<char> read(netCount(), 0);
+    for (const auto &g : gates) {
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            read[fanins[g.firstInput + j]] = 1;
+        }
+    }
+    vector<char> dead(gates.size(), 0);
+    for (size_t i = 0; i < gates.size(); i++) {
+        dead[i] = value[gates[i].out] >= 0 && !read[gates[i].out] && !observed[gates[i].out];
+    }
+    removeGates(dead);
+    return true;
+}
+
+bool CircuitBuilder::removeDeadLogic() {
+    vector<uint32_t> order;
+    if (!dependencyOrder(order)) return false;
+    
+    // Walk back from the primary outputs against dependency order
+    vector<char> live = observedNets();
+    vector<char> dead(gates.size(), 1);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        const GateRecord &g = gates[*it];
+        if (!live[g.out]) continue;
+        dead[*it] = 0;
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            live[fanins[g.firstInput + j]] = 1;
+        }
+    }
+    removeGates(dead);
+    return true;
+}
+
+bool CircuitBuilder::hashGates() {
+    vector<uint32_t> order;
+    if (!dependencyOrder(order)) return false;
+    
+    const vector<char> observed = observedNets();
+    vector<int> alias(netCount());
+    for (size_t id = 0; id < alias.size(); id++) {
+        alias[id] = static_cast<int>(id);
+    }
+    vector<char> dead(gates.size(), 0);
+    
+    // Key: opcode followed by the sorted input IDs
+    unordered_map<string, int> table;
+    table.reserve(gates.size());
+    string key;
+    vector<int> in;
+    for (uint32_t gi : order) {
+        GateRecord &g = gates[gi];
+        in.clear();
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            in.push_back(alias[fanins[g.firstInput + j]]);
+        }
+        setGateInputs(g, in);
+        
+        sort(in.begin(), in.end());
+        key.assign(1, static_cast<char>(g.op));
+        key.append(reinterpret_cast<const char *>(in.data()), in.size() * sizeof(int));
+        auto found = table.emplace(key, g.out);
+        if (!found.second && !observed[g.out]) {
+            alias[g.out] = found.first->second;
+            dead[gi] = 1;
+        }
+    }
+    removeGates(dead);
+    return true;
+}
+
+bool CircuitBuilder::finish(CompiledCircuit &c, string_view circuitName) {
+    vector<uint32_t> levelOf, levelOffsets;
+    uint32_t levels = 0;
+    if (!levelize(levelOf, levels)) return false;
+    const size_t nNets = netCount();
+    const size_t nGates = gates.size();
+    const size_t nFanins = fanins.size();
+    const size_t nFlops = flops.size();
+    
+    // Gates in level order, keeping definition order within each level
+    vector<uint32_t> order = levelOrder(levelOf, levels, levelOffsets);
+    
+    // Primary I/O in name order
+    auto byName = [this](int a, int b) { return netName(a) < netName(b); };
+    sort(inputs.begin(), inputs.end(), byName);
+    inputs.erase(unique(inputs.begin(), inputs.end()), inputs.end());
+    sort(outputs.begin(), outputs.end());
+    outputs.erase(unique(outputs.begin(), outputs.end()), outputs.end());
+    
+    // A gate reading the same net twice appears in its fanout only once
+    auto firstUse = [](const int32_t *in, uint32_t j) { return find(in, in + j, in[j]) == in + j; };
+    size_t nFanouts = 0;
+    for (const auto &g : gates) {
+        for (uint32_t j = 0; j < g.inputCount; j++) {
+            if (firstUse(fanins.data() + g.firstInput, j)) nFanouts++;
+        }
+    }
+    
+    // String table: net names by ID, then undefined output names, then the circuit name
+    size_t nStrings = nNets + 1;
+    size_t nChars = chars.size() + circuitName.size() + 1;
+    for (const auto &output : outputs) {
+        if (findNet(output) < 0) {
+            nStrings++;
+            nChars += output.size() + 1;
+        }
+    }
+    
+    // Size every array, then carve them all out of one block
+    CircuitArena arena;
+    GateOp *ops;
+    int32_t *gateOutputs, *faninIds, *fanoutGates, *flopOutputs, *flopInputs, *inputIds, *outputIds, *netsByName;
+    uint8_t *flopResetValues;
+    uint32_t *faninOffsets, *gateLevels, *levelStarts, *fanoutOffsets, *outputNameIds, *stringOffsets;
+    char *stringChars;
+    auto place = [&arena](auto &view, size_t count) {
+        using T = typename remove_reference_t<decltype(view)>::value_type;
+        T *p = arena.take<T>(count);
+        view = ArrayView<T>(p, count);
+        return p;
+    };
+    c = CompiledCircuit();
+    auto carve = [&]() {
+        ops = place(c.gateOps, nGates);
+        gateOutputs = place(c.gateOutputs, nGates);
+        faninOffsets = place(c.faninOffsets, nGates + 1);
+        faninIds = place(c.fanins, nFanins);
+        gateLevels = place(c.gateLevels, nGates);
+        levelStarts = place(c.levelOffsets, levelOffsets.size());
+        fanoutOffsets = place(c.fanoutOffsets, nNets + 1);
+        fanoutGates = place(c.fanoutGates, nFanouts);
+        flopOutputs = place(c.flopOutputs, nFlops);
+        flopInputs = place(c.flopInputs, nFlops);
+        flopResetValues = place(c.flopResetValues, nFlops);
+        inputIds = place(c.primaryInputIds, inputs.size());
+        outputIds = place(c.primaryOutputIds, outputs.size());
+        outputNameIds = place(c.outputNameIds, outputs.size());
+        netsByName = place(c.netsByName, nNets);
+        stringOffsets = place(c.stringOffsets, nStrings);
+        stringChars = place(c.stringChars, nChars);
+    };
+    carve();
+    arena.allocate();
+    carve();
+    
+    // Gates, with their inputs laid out in evaluation order
+    uint32_t nextInput = 0;
+    for (size_t k = 0; k < nGates; k++) {
+        const GateRecord &g = gates[order[k]];
+        ops[k] = g.op;
+        gateOutputs[k] = g.out;
+        faninOffsets[k] = nextInput;
+        copy(fanins.begin() + g.firstInput, fanins.begin() + g.firstInput + g.inputCount, faninIds + nextInput);
+        nextInput += g.inputCount;
+        gateLevels[k] = levelOf[order[k]];
+    }
+    faninOffsets[nGates] = nextInput;
+    copy(levelOffsets.begin(), levelOffsets.end(), levelStarts);
+    
+    // Fanout lists: count per net, turn the counts into range ends, then
+    // fill each range backwards so it ends up in ascending gate order
+    fill(fanoutOffsets, fanoutOffsets + nNets + 1, 0);
+    for (size_t k = 0; k < nGates; k++) {
+        const int32_t *in = faninIds + faninOffsets[k];
+        for (uint32_t j = 0; j < faninOffsets[k + 1] - faninOffsets[k]; j++) {
+            if (firstUse(in, j)) fanoutOffsets[in[j]]++;
+        }
+    }
+    for (size_t id = 1; id <= nNets; id++) {
+        fanoutOffsets[id] += fanoutOffsets[id - 1];
+    }
+    for (size_t k = nGates; k-- > 0;) {
+        const int32_t *in = faninIds + faninOffsets[k];
+        for (uint32_t j = 0; j < faninOffsets[k + 1] - faninOffsets[k]; j++) {
+            if (firstUse(in, j)) fanoutGates[--fanoutOffsets[in[j]]] = static_cast<int32_t>(k);
+        }
+    }
+    
+    for (size_t f = 0; f < nFlops; f++) {
+        flopOutputs[f] = flops[f].q;
+        flopInputs[f] = flops[f].d;
+        flopResetValues[f] = flops[f].resetValue;
+    }
+    copy(inputs.begin(), inputs.end(), inputIds);
+    for (size_t i = 0; i < nNets; i++) {
+        netsByName[i] = static_cast<int32_t>(i);
+    }
+    sort(netsByName, netsByName + nNets, byName);
+    
+    copy(chars.begin(), chars.end(), stringChars);
+    copy(offsets.begin(), offsets.end(), stringOffsets);
+    uint32_t nextString = static_cast<uint32_t>(nNets);
+    uint32_t nextChar = static_cast<uint32_t>(chars.size());
+    auto addString = [&](string_view text) {
+        stringOffsets[nextString] = nextChar;
+        copy(text.begin(), text.end(), stringChars + nextChar);
+        nextChar += static_cast<uint32_t>(text.size());
+        stringChars[nextChar++] = '\0';
+        return nextString++;
+    };
+    for (size_t o = 0; o < outputs.size(); o++) {
+        int id = findNet(outputs[o]);
+        outputIds[o] = id;
+        outputNameIds[o] = id >= 0 ? static_cast<uint32_t>(id) : addString(outputs[o]);
+    }
+    c.nets = static_cast<uint32_t>(nNets);
+    c.nameIndex = addString(circuitName);
+    c.storage = arena.storage();
+    *this = CircuitBuilder();
+    return true;
+}
+
+/**
+ * @struct OptimizationPass
+ * @brief One netlist optimization pass of --optimize
+ */
+struct OptimizationPass {
+    const char *name;               ///< Name used in the report
+    bool (CircuitBuilder::*run)();  ///< Pass; false if the netlist cannot be levelized
+};
+
+/// Optimization passes in the order they run: dead logic goes before
+/// fusion, so gates that only fed removed logic count as single-reader
+const OptimizationPass OPTIMIZATION_PASSES[] = {
+    {"constants",  &CircuitBuilder::propagateConstants},
+    {"dead logic", &CircuitBuilder::removeDeadLogic},
+    {"fusion",     &CircuitBuilder::fuseGates},
+    {"hashing",    &CircuitBuilder::hashGates},
+};
+
+/**
+ * @brief Optionally optimizes a built netlist, then compiles it
+ * @param builder Netlist to compile (left empty)
+ * @param c Receives the compiled circuit
+ * @param circuitName Circuit name to record
+ * @param optimize Run OPTIMIZATION_PASSES first
+ * @param error Receives the reason on failure
+ * @param report If given, receives the gate counts of the optimization as one status line
+ * @return true on success, false if the netlist cannot be levelized
+ */
+bool finishCircuit(CircuitBuilder &builder, CompiledCircuit &c, string_view circuitName, bool optimize,
+                   string &error, string *report = nullptr) {
+    if (optimize) {
+        const size_t before = builder.gateCount();
+        string passes;
+        for (const auto &pass : OPTIMIZATION_PASSES) {
+            size_t gatesIn = builder.gateCount();
+            if (!(builder.*pass.run)()) {
+                error = builder.error();
+                return false;
+            }
+            passes += string(passes.empty() ? "" : ", ") + pass.name + " -" +
+                      to_string(gatesIn - builder.gateCount());
+        }
+        const size_t after = builder.gateCount();
+        if (report) {
+            *report = "✓ Optimized: " + to_string(before) + " -> " + to_string(after) + " gates";
+            if (before > 0) *report += " (" + to_string(100 * (before - after) / before) + "% removed: " + passes + ")";
+        }
+    }
+    if (!builder.finish(c, circuitName)) {
+        error = builder.error();
+        return false;
+    }
+    return true;
+}
+
+bool compileCircuit(CompiledCircuit &c, const vector<Gate> &gates, const set<string> &primaryInputs,
+                    const set<string> &primaryOutputs, const string &circuitName, bool optimize, string &error) {
+    CircuitBuilder builder;
+    for (const auto &input : primaryInputs) {
+        builder.addInput(builder.net(input));
+    }
+    
+    vector<int> inputIds;
+    for (const auto &g : gates) {
+        inputIds.clear();
+        for (const auto &input : g.inputs) {
+            inputIds.push_back(builder.net(input));
+        }
+        builder.addGate(g.op, builder.net(g.out), inputIds.data(), inputIds.size());
+    }
+    
+    for (const auto &output : primaryOutputs) {
+        builder.addOutput(output);
+    }
+    return finishCircuit(builder, c, circuitName, optimize, error);
+}
+
+/**
+ * @brief Applies a gate operation to the values of its input nets
+ * @tparam W Value word type (0/1 int for scalar nets, uint64_t for packed nets)
+ * @param r Receives the bitwise result of the operation
+ * @param op Gate opcode
+ * @param v Net value array
+ * @param in Input net IDs of the gate
+ * @param n Number of inputs
+ */
+template <typename W>
+inline void applyGate(W &r, GateOp op, const W *v, const int *in, int n) {
+    switch (op) {
+        // N-input gates
+        case GateOp::AND:  OpKernel<GateOp::AND>::apply(r, v, in, n); return;
+        case GateOp::OR:   OpKernel<GateOp::OR>::apply(r, v, in, n); return;
+        case GateOp::NAND: OpKernel<GateOp::NAND>::apply(r, v, in, n); return;
+        case GateOp::NOR:  OpKernel<GateOp::NOR>::apply(r, v, in, n); return;
+        case GateOp::XOR:  OpKernel<GateOp::XOR>::apply(r, v, in, n); return;
+        case GateOp::XNOR: OpKernel<GateOp::XNOR>::apply(r, v, in, n); return;
+        
+        // Single-input gates
+        case GateOp::NOT:  OpKernel<GateOp::NOT>::apply(r, v, in, n); return;
+        case GateOp::BUF:  OpKernel<GateOp::BUF>::apply(r, v, in, n); return;
+        
+        // Constant drivers
+        case GateOp::CONST0: OpKernel<GateOp::CONST0>::apply(r, v, in, n); return;
+        case GateOp::CONST1: OpKernel<GateOp::CONST1>::apply(r, v, in, n); return;
+        
+        default:
+            break;
+    }
+    
+    // Error handling for unknown gate types
+    cerr << "Error: Unknown gate type: " << gateOpName(op) << "\n";
+    r = W{};
+}
+
+/**
+ * @brief Evaluates a logic gate based on its type and input values
+ * @param c Compiled circuit the gate belongs to
+ * @param g Index of the gate to evaluate
+ * @param values Net values (0 or 1), indexed by net ID
+ * @return The output value (0 or 1) of the gate
+ */
+int evalGate(const CompiledCircuit &c, size_t g, const int *values) {
+    int out;
+    applyGate(out, c.gateOps[g], values, c.gateInputs(g), static_cast<int>(c.gateInputCount(g)));
+    return out & 1;
+}
+
+void simulate(const CompiledCircuit &c, SimState &s) {
+    int *values = s.netValues.data();
+    for (size_t g = 0; g < c.gateCount(); g++) {
+        values[c.gateOutputs[g]] = evalGate(c, g, values);
+    }
+    PROFILE(s.profile.sweeps++);
+}
+
+/**
+ * @brief Schedules every gate reading a net for re-evaluation
+ * @param c Levelized circuit
+ * @param s Simulation state
+ * @param id Net ID whose value changed
+ */
+inline void scheduleFanout(const CompiledCircuit &c, SimState &s, int id) {
+    for (uint32_t k = c.fanoutOffsets[id]; k < c.fanoutOffsets[id + 1]; k++) {
+        int gi = c.fanoutGates[k];
+        if (!s.gateScheduled[gi]) {
+            s.gateScheduled[gi] = 1;
+            s.levelEvents[c.gateLevels[gi]].push_back(gi);
+        }
+    }
+}
+
+void setInputValue(const CompiledCircuit &c, SimState &s, int id, int value) {
+    if (s.netValues[id] == value) return;
+    s.netValues[id] = value;
+    PROFILE(s.profile.netToggles[id]++);
+    if (s.eventStateValid) scheduleFanout(c, s, id);
+}
+
+EventStats simulateEventDriven(const CompiledCircuit &c, SimState &s) {
+    EventStats stats;
+    
+    if (!s.eventStateValid) {
+        simulate(c, s);
+        s.eventStateValid = true;
+        stats.evaluated = c.gateCount();
+    } else {
+        int *values = s.netValues.data();
+        
+        // Fanout always points to a higher level, so one ascending pass suffices
+        for (auto &events : s.levelEvents) {
+            for (size_t k = 0; k < events.size(); k++) {
+                int gi = events[k];
+                int out = c.gateOutputs[gi];
+                s.gateScheduled[gi] = 0;
+                stats.evaluated++;
+                PROFILE(s.profile.opEvaluations[static_cast<size_t>(c.gateOps[gi])]++);
+                PROFILE(s.profile.levelEvaluations[c.gateLevels[gi]]++);
+                
+                int value = evalGate(c, gi, values);
+                if (value != values[out]) {
+                    values[out] = value;
+                    scheduleFanout(c, s, out);
+                    PROFILE(s.profile.netToggles[out]++);
+                    PROFILE(s.profile.levelChanges[c.gateLevels[gi]]++);
+                }
+            }
+            events.clear();
+        }
+    }
+    
+    stats.skipped = c.gateCount() - stats.evaluated;
+    s.totalEventStats.evaluated += stats.evaluated;
+    s.totalEventStats.skipped += stats.skipped;
+    s.lastEventStats = stats;
+    return stats;
+}
+
+/**
+ * @brief Evaluates a range of gates once over packed net values of type V
+ * @tparam V Packed lane type (uint64_t, or a 256/512-bit vector of words)
+ * @param c Levelized circuit
+ * @param v Net value array, one V per net ID
+ * @param begin First gate to evaluate
+ * @param end One past the last gate to evaluate
+ */
+template <typename V>
+inline void sweepGateRange(const CompiledCircuit &c, V *v, size_t begin, size_t end) {
+    const GateOp *ops = c.gateOps.data();
+    const int32_t *outputs = c.gateOutputs.data();
+    const uint32_t *offsets = c.faninOffsets.data();
+    const int32_t *fanins = c.fanins.data();
+    for (size_t g = begin; g < end; g++) {
+        V r;
+        applyGate(r, ops[g], v, fanins + offsets[g], static_cast<int>(offsets[g + 1] - offsets[g]));
+        v[outputs[g]] = r;
+    }
+}
+
+/**
+ * @brief Evaluates every gate once over packed net values of type V
+ * @tparam V Packed lane type (uint64_t, or a 256/512-bit vector of words)
+ * @param c Levelized circuit
+ * @param v Net value array, one V per net ID
+ */
+template <typename V>
+inline void sweepGates(const CompiledCircuit &c, V *v) {
+    sweepGateRange(c, v, 0, c.gateCount());
+}
+
+#ifdef CIRCUIT_X86_WIDE_KERNELS
+
+/// Sweep with 256-bit lanes; 'flatten' inlines the kernels so they use AVX2
+__attribute__((target("avx2"), flatten))
+void sweepGatesAvx2(const CompiledCircuit &c, uint64_t *words) {
+    sweepGates(c, reinterpret_cast<Word256 *>(words));
+}
+
+/// Sweep with 512-bit lanes; 'flatten' inlines the kernels so they use AVX-512
+__attribute__((target("avx512f"), flatten))
+void sweepGatesAvx512(const CompiledCircuit &c, uint64_t *words) {
+    sweepGates(c, reinterpret_cast<Word512 *>(words));
+}
+
+#endif
+
+bool packedKernelSupported(PackedKernel kernel) {
+    switch (kernel) {
+        case PackedKernel::SCALAR: return true;
+#ifdef CIRCUIT_X86_WIDE_KERNELS
+        case PackedKernel::AVX2:   return __builtin_cpu_supports("avx2");
+        case PackedKernel::AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+        default:                   return false;
+    }
+}
+
+PackedKernel detectPackedKernel() {
+    if (packedKernelSupported(PackedKernel::AVX512)) return PackedKernel::AVX512;
+    if (packedKernelSupported(PackedKernel::AVX2)) return PackedKernel::AVX2;
+    return PackedKernel::SCALAR;
+}
+
+void initSimState(const CompiledCircuit &c, SimState &s, PackedKernel kernel) {
+    if (!packedKernelSupported(kernel)) kernel = PackedKernel::SCALAR;
+    s.packedKernel = kernel;
+    s.packedWordsPerNet = PACKED_KERNELS[static_cast<int>(kernel)].lanes / 64;
+    s.netValues.assign(c.netCount(), 0);
+    s.netWords.assign(c.netCount() * s.packedWordsPerNet, 0);
+    s.flopWords.assign(c.flopCount() * s.packedWordsPerNet, 0);
+    
+    s.eventStateValid = false;
+    s.levelEvents.assign(c.levelCount(), vector<int>());
+    s.gateScheduled.assign(c.gateCount(), 0);
+    s.lastEventStats = EventStats();
+    s.totalEventStats = EventStats();
+    
+#ifdef CIRCUIT_PROFILE
+    s.profile = SimProfile();
+    s.profile.levelEvaluations.assign(c.levelCount(), 0);
+    s.profile.levelChanges.assign(c.levelCount(), 0);
+    s.profile.netToggles.assign(c.netCount(), 0);
+#endif
+}
+
+void simulatePacked(const CompiledCircuit &c, SimState &s) {
+    switch (s.packedKernel) {
+#ifdef CIRCUIT_X86_WIDE_KERNELS
+        case PackedKernel::AVX2:   sweepGatesAvx2(c, s.netWords.data()); break;
+        case PackedKernel::AVX512: sweepGatesAvx512(c, s.netWords.data()); break;
+#endif
+        default:                   sweepGates(c, s.netWords.data()); break;
+    }
+    PROFILE(s.profile.sweeps++);
+}
+
+/**
+ * @brief Sets every flip-flop to its reset value in all packed lanes
+ * @param c Levelized circuit
+ * @param s Simulation state prepared by initSimState()
+ */
+void resetFlops(const CompiledCircuit &c, SimState &s) {
+    const size_t k = s.packedWordsPerNet;
+    for (size_t f = 0; f < c.flopCount(); f++) {
+        uint64_t *q = &s.netWords[c.flopOutputs[f] * k];
+        fill(q, q + k, c.flopResetValues[f] ? ~0ULL : 0ULL);
+    }
+}
+
+/**
+ * @brief Clocks every flip-flop at once over packed net values
+ * @param c Levelized circuit
+ * @param s Simulation state whose logic was evaluated for the current cycle
+ * 
+ * All D words are gathered before any Q is written, so flip-flops that
+ * feed each other directly (shift registers) see the pre-edge values.
+ */
+void clockFlops(const CompiledCircuit &c, SimState &s) {
+    const size_t k = s.packedWordsPerNet;
+    uint64_t *words = s.netWords.data();
+    uint64_t *latched = s.flopWords.data();
+    for (size_t f = 0; f < c.flopCount(); f++) {
+        copy(words + c.flopInputs[f] * k, words + (c.flopInputs[f] + 1) * k, latched + f * k);
+    }
+    for (size_t f = 0; f < c.flopCount(); f++) {
+        copy(latched + f * k, latched + (f + 1) * k, words + c.flopOutputs[f] * k);
+    }
+}
+
+/**
+ * @brief Runs clock cycles on packed, independent stimulus streams
+ * @param c Levelized circuit
+ * @param s Simulation state; bit lane p of every net word is stream p
+ * @param stimulus Primary input words of each cycle, nInputs * packedWordsPerNet words per cycle
+ * @param stimulusCycles Cycles in stimulus; later cycles keep the last inputs
+ * @param cycles Clock cycles to run
+ * @param hook Called after the logic of every cycle (and the final evaluation) settles
+ * @param hookLane Bit lane passed to the hook
+ * 
+ * Flip-flops start at their reset values. Every cycle loads its inputs,
+ * evaluates the logic in one levelized sweep and clocks all flip-flops;
+ * nothing is read or written between cycles. After the last clock the
+ * logic is evaluated once more, so the outputs reflect the final state.
+ */
+void runCycles(const CompiledCircuit &c, SimState &s, const uint64_t *stimulus,
+               size_t stimulusCycles, uint64_t cycles, const SampleHook &hook = nullptr, int hookLane = 0) {
+    const size_t k = s.packedWordsPerNet;
+    const size_t nInputs = c.primaryInputIds.size();
+    auto loadInputs = [&](size_t t) {
+        const uint64_t *words = stimulus + t * nInputs * k;
+        for (size_t i = 0; i < nInputs; i++) {
+            copy(words + i * k, words + (i + 1) * k, &s.netWords[c.primaryInputIds[i] * k]);
+        }
+    };
+    
+    resetFlops(c, s);
+    for (uint64_t t = 0; t < cycles; t++) {
+        if (t < stimulusCycles) loadInputs(t);
+        simulatePacked(c, s);
+        if (hook) hook(s, hookLane);
+        clockFlops(c, s);
+    }
+    simulatePacked(c, s);
+    if (hook) hook(s, hookLane);
+}
+
+/**
+ * @brief Builds the sweep order of a compiled module body
+ * @param m Module whose body and instances are complete
+ * 
+ * Consecutive ordinary gates form one run; an instance is placed at its
+ * input-reading INST gate, and the INST gates of its outputs are skipped.
+ */
+void scheduleModule(CompiledModule &m) {
+    const CompiledCircuit &c = m.body;
+    vector<int32_t> instanceOf(c.netCount(), -1);
+    for (size_t i = 0; i < m.instances.size(); i++) {
+        instanceOf[m.instances[i].net] = static_cast<int32_t>(i);
+    }
+    m.steps.clear();
+    uint32_t begin = 0;
+    for (uint32_t g = 0; g < c.gateCount(); g++) {
+        if (c.gateOps[g] != GateOp::INST) continue;
+        if (begin < g) m.steps.push_back({begin, g, -1});
+        int32_t instance = instanceOf[c.gateOutputs[g]];
+        if (instance >= 0) m.steps.push_back({g, g, instance});
+        begin = g + 1;
+    }
+    if (begin < c.gateCount()) m.steps.push_back({begin, static_cast<uint32_t>(c.gateCount()), -1});
+}
+
+/**
+ * @brief Evaluates one module over packed values, descending into its instances
+ * @param d Design
+ * @param m Index of the module to sweep
+ * @param slots Value array of the whole design, slotCount words
+ * 
+ * The module's inputs must already be in its frame. Each instance gets
+ * its input values copied into the child's frame, is swept, and has its
+ * output values copied back into this module's nets.
+ */
+void sweepModule(const CompiledDesign &d, size_t m, uint64_t *slots) {
+    const CompiledModule &mod = d.modules[m];
+    uint64_t *v = slots + mod.frameOffset;
+    for (const auto &step : mod.steps) {
+        if (step.instance < 0) {
+            sweepGateRange(mod.body, v, step.begin, step.end);
+            continue;
+        }
+        const ModuleInstance &inst = mod.instances[step.instance];
+        const CompiledModule &child = d.modules[inst.module];
+        uint64_t *cv = slots + child.frameOffset;
+        const int32_t *ports = mod.instancePorts.data() + inst.firstPort;
+        for (size_t k = 0; k < child.inputPorts.size(); k++) cv[child.inputPorts[k]] = v[ports[k]];
+        sweepModule(d, inst.module, slots);
+        ports += child.inputPorts.size();
+        for (size_t k = 0; k < child.outputPorts.size(); k++) v[ports[k]] = cv[child.outputPorts[k]];
+    }
+}
+
+/**
+ * @brief Adds the gates of one module instance to a flat netlist
+ * @param d Design holding the module definitions
+ * @param m Index of the instantiated module
+ * @param builder Flat netlist receiving the gates
+ * @param prefix Hierarchical instance name, prepended to the module's own nets
+ * @param ports Builder nets on the module inputs, then outputs
+ * 
+ * Nested instances are expanded recursively; their nets are named
+ * "outer.inner.net" and cannot be looked up by name.
+ */
+void flattenInstance(const CompiledDesign &d, size_t m, CircuitBuilder &builder,
+                     const string &prefix, const int *ports) {
+    const CompiledModule &mod = d.modules[m];
+    const CompiledCircuit &body = mod.body;
+    const size_t nInputs = mod.inputPorts.size();
+    vector<int> netMap(body.netCount(), -1);
+    for (size_t k = 0; k < nInputs; k++) netMap[mod.inputPorts[k]] = ports[k];
+    for (size_t k = 0; k < mod.outputPorts.size(); k++) {
+        int &id = netMap[mod.outputPorts[k]];
+        if (id < 0) id = ports[nInputs + k];
+        else builder.addGate(GateOp::BUF, ports[nInputs + k], &id, 1);  // Output wired to an input
+    }
+    auto mapNet = [&](int id) {
+        if (netMap[id] < 0) netMap[id] = builder.anonymousNet(prefix + "." + string(body.netName(id)));
+        return netMap[id];
+    };
+    
+    vector<int> in;
+    for (const auto &step : mod.steps) {
+        if (step.instance >= 0) {
+            const ModuleInstance &inst = mod.instances[step.instance];
+            in.clear();
+            for (size_t k = 0; k < d.modules[inst.module].portCount(); k++) {
+                in.push_back(mapNet(mod.instancePorts[inst.firstPort + k]));
+            }
+            flattenInstance(d, inst.module, builder, prefix + "." + inst.name, in.data());
+            continue;
+        }
+        for (uint32_t g = step.begin; g < step.end; g++) {
+            in.clear();
+            for (uint32_t j = 0; j < body.gateInputCount(g); j++) in.push_back(mapNet(body.gateInputs(g)[j]));
+            builder.addGate(body.gateOps[g], mapNet(body.gateOutputs[g]), in.data(), in.size());
+        }
+    }
+}
+
+uint64_t exhaustivePatternWord(uint64_t base, int bit) {
+    // Within a 64-pattern block the low six index bits follow fixed masks
+    static const uint64_t LOW_BIT_MASKS[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+    if (bit < 6) return LOW_BIT_MASKS[bit];
+    return ((base >> bit) & 1) ? ~0ULL : 0ULL;
+}
+
+string toUpper(string str) {
+    transform(str.begin(), str.end(), str.begin(), ::toupper);
+    return str;
+}
+
+/**
+ * @brief Validates if a gate type is supported
+ * @param type Gate type to validate
+ * @return true if the gate type is supported, false otherwise
+ */
+bool isValidGateType(const string& type) {
+    return parseGateOp(type) != GateOp::INVALID;
+}
+
+/**
+ * @brief Gets the required number of inputs for a specific gate type
+ * @param type Gate type
+ * @return Number of required inputs (the minimum for N-input gates), or -1 if invalid gate type
+ */
+int getRequiredInputs(const string& type) {
+    GateOp op = parseGateOp(type);
+    if (op == GateOp::INVALID) return -1;  // Invalid gate type
+    return GATE_OPS[static_cast<int>(op)].inputs;
+}
+
+bool isEndMarker(const string &line) {
+    stringstream ss(line);
+    string word;
+    ss >> word;
+    return toUpper(word) == "END";
+}
+
+/**
+ * @brief Resolves the type of a gate definition
+ * @param type Gate type name (uppercase)
+ * @param error Receives a description of the problem if the type is unknown
+ * @return Matching opcode, or GateOp::INVALID
+ */
+GateOp parseGateType(const string &type, string &error) {
+    GateOp op = parseGateOp(type);
+    if (op == GateOp::INVALID || op == GateOp::INST) {
+        op = GateOp::INVALID;
+        error = "Unknown gate type '" + type + "'.\n"
+                "   Supported types: AND, OR, NOT, NAND, NOR, XOR, XNOR, BUF, CONST0, CONST1, DFF";
+    }
+    return op;
+}
+
+/**
+ * @brief Checks the number of inputs of a gate definition
+ * @param op Gate opcode
+ * @param inputCount Number of inputs given
+ * @param error Receives a description of the problem if the count is wrong
+ * @return true if the gate type accepts that many inputs
+ */
+bool checkGateInputCount(GateOp op, size_t inputCount, string &error) {
+    const GateOpInfo &info = GATE_OPS[static_cast<int>(op)];
+    const string type = gateOpName(op);
+    if (info.variadic && (inputCount < static_cast<size_t>(info.inputs) ||
+                          inputCount > static_cast<size_t>(MAX_GATE_INPUTS))) {
+        error = type + " gate requires " + to_string(info.inputs) + " to " +
+                to_string(MAX_GATE_INPUTS) + " inputs, got " + to_string(inputCount) + ".";
+        return false;
+    }
+    if (!info.variadic && inputCount != static_cast<size_t>(info.inputs)) {
+        error = type + " gate requires exactly " + to_string(info.inputs) +
+                " input(s), got " + to_string(inputCount) + ".";
+        return false;
+    }
+    return true;
+}
+
+bool parseGateLine(const string &line, Gate &g, string &error) {
+    stringstream ss(line);
+    string type;
+    ss >> type;
+    type = toUpper(type);
+    
+    // Validate gate type and resolve its opcode once
+    GateOp op = parseGateType(type, error);
+    if (op == GateOp::INVALID) return false;
+    
+    g = Gate();
+    g.op = op;
+    ss >> g.out;
+    
+    if (g.out.empty()) {
+        error = "Output name required.";
+        return false;
+    }
+    
+    // Parse inputs
+    string input;
+    while (ss >> input) {
+        g.inputs.push_back(input);
+    }
+    
+    return checkGateInputCount(op, g.inputs.size(), error);
+}
+
+/**
+ * @struct LineReader
+ * @brief Reads a file line by line through one reusable buffer
+ */
+struct LineReader {
+    static const size_t CHUNK_SIZE = 1 << 20;
+    
+    FILE *file = nullptr;
+    vector<char> buffer;    ///< Holds the unread part of the file
+    size_t begin = 0;       ///< Start of unread data in buffer
+    size_t end = 0;         ///< End of valid data in buffer
+    bool eof = false;
+    
+    explicit LineReader(FILE *f) : file(f), buffer(CHUNK_SIZE) {}
+    
+    /**
+     * @brief Returns the next line (without its terminator)
+     * @param data Receives a pointer to the line, valid until the next call
+     * @param length Receives the line length
+     * @return false at end of file
+     */
+    bool next(const char *&data, size_t &length) {
+        while (true) {
+            const char *start = buffer.data() + begin;
+            const char *nl = static_cast<const char *>(memchr(start, '\n', end - begin));
+            if (nl || (eof && begin < end)) {
+                length = (nl ? nl : buffer.data() + end) - start;
+                data = start;
+                begin += length + (nl ? 1 : 0);
+                if (length > 0 && data[length - 1] == '\r') length--;
+                return true;
+            }
+            if (eof) return false;
+            
+            // Move the partial line to the front and refill (grow for huge lines)
+            memmove(buffer.data(), start, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) buffer.resize(buffer.size() * 2);
+            size_t got = fread(buffer.data() + end, 1, buffer.size() - end, file);
+            end += got;
+            if (got == 0) eof = true;
+        }
+    }
+};
+
+/**
+ * @brief Appends a node identifier such as "g42" without temporaries
+ * @param text Destination
+ * @param kind Node kind prefix: 'n' net, 'g' gate, 'f' flip-flop
+ * @param id Index of the net, gate or flip-flop
+ */
+inline void appendDotNode(string &text, char kind, size_t id) {
+    char digits[24];
+    digits[0] = kind;
+    char *end = to_chars(digits + 1, digits + sizeof(digits), id).ptr;
+    text.append(digits, end - digits);
+}
+
+/**
+ * @brief Appends a name as a quoted DOT string
+ * @param text Destination
+ * @param name Net or circuit name
+ */
+inline void appendDotString(string &text, string_view name) {
+    text.push_back('"');
+    for (char ch : name) {
+        if (ch == '"' || ch == '\\') text.push_back('\\');
+        text.push_back(ch);
+    }
+    text.push_back('"');
+}
+
+bool writeDot(const CompiledCircuit &c, const string &path, const DotOptions &options, size_t &gatesWritten) {
+    auto inLevels = [&](size_t g) {
+        return c.gateLevels[g] >= options.firstLevel && c.gateLevels[g] <= options.lastLevel;
+    };
+    vector<char> drawGate(c.gateCount(), 0);
+    vector<char> drawFlop(c.flopCount(), options.cone.empty());
+    if (options.cone.empty()) {
+        for (size_t g = 0; g < c.gateCount(); g++) drawGate[g] = inLevels(g);
+    } else {
+        // Walk back from the cone outputs through gates and flip-flops
+        vector<int32_t> driver(c.netCount(), -1);  // Gate index, or -2 - flip-flop index
+        for (size_t g = 0; g < c.gateCount(); g++) driver[c.gateOutputs[g]] = static_cast<int32_t>(g);
+        for (size_t f = 0; f < c.flopCount(); f++) driver[c.flopOutputs[f]] = -2 - static_cast<int32_t>(f);
+        vector<char> visited(c.netCount(), 0);
+        vector<int> pending;
+        for (const auto &name : options.cone) {
+            size_t o = 0;
+            while (o < c.primaryOutputIds.size() && c.outputName(o) != name) o++;
+            if (o == c.primaryOutputIds.size()) {
+                cerr << "❌ Error: No primary output named '" << name << "'.\n";
+                return false;
+            }
+            if (c.primaryOutputIds[o] >= 0) pending.push_back(c.primaryOutputIds[o]);
+        }
+        while (!pending.empty()) {
+            int id = pending.back();
+            pending.pop_back();
+            if (visited[id]) continue;
+            visited[id] = 1;
+            if (driver[id] >= 0) {
+                size_t g = static_cast<size_t>(driver[id]);
+                drawGate[g] = inLevels(g);
+                pending.insert(pending.end(), c.gateInputs(g), c.gateInputs(g) + c.gateInputCount(g));
+            } else if (driver[id] <= -2) {
+                size_t f = static_cast<size_t>(-2 - driver[id]);
+                drawFlop[f] = 1;
+                pending.push_back(c.flopInputs[f]);
+            }
+        }
+    }
+    
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        cerr << "❌ Error: Could not create DOT file '" << path << "'.\n";
+        return false;
+    }
+    OutputBuffer out(file);
+    string text;
+    auto flushText = [&]() {
+        if (text.size() < OutputBuffer::FLUSH_SIZE / 4) return;
+        out.appendLines(text);
+        text.clear();
+    };
+    
+    text += "digraph ";
+    appendDotString(text, c.name());
+    text += " {\n    rankdir=LR;\n    node [shape=box, style=filled, color=lightblue];\n";
+    
+    // Net nodes: only the nets the drawn gates and flip-flops touch
+    vector<char> drawNet(c.netCount(), 0);
+    gatesWritten = 0;
+    for (size_t g = 0; g < c.gateCount(); g++) {
+        if (!drawGate[g]) continue;
+        gatesWritten++;
+        drawNet[c.gateOutputs[g]] = 1;
+        for (uint32_t j = 0; j < c.gateInputCount(g); j++) drawNet[c.gateInputs(g)[j]] = 1;
+    }
+    for (size_t f = 0; f < c.flopCount(); f++) {
+        if (drawFlop[f]) drawNet[c.flopOutputs[f]] = drawNet[c.flopInputs[f]] = 1;
+    }
+    vector<char> netRole(c.netCount(), 0);  // 1 primary input, 2 primary output
+    for (int id : c.primaryInputIds) netRole[id] = 1;
+    for (int id : c.primaryOutputIds) {
+        if (id >= 0) netRole[id] = 2;
+    }
+    for (size_t id = 0; id < c.netCount(); id++) {
+        if (!drawNet[id]) continue;
+        text += "    ";
+        appendDotNode(text, 'n', id);
+        text += " [label=";
+        appendDotString(text, c.netName(static_cast<int>(id)));
+        if (netRole[id] == 1) text += ", xlabel=\"IN\", color=lightgreen";
+        if (netRole[id] == 2) text += ", xlabel=\"OUT\", color=lightcoral";
+        text += "];\n";
+        flushText();
+    }
+    
+    // Gate nodes with their input and output edges
+    for (size_t g = 0; g < c.gateCount(); g++) {
+        if (!drawGate[g]) continue;
+        text += "    ";
+        appendDotNode(text, 'g', g);
+        text += " [label=\"";
+        text += gateOpName(c.gateOps[g]);
+        text += "\", color=lightyellow];\n";
+        for (uint32_t j = 0; j < c.gateInputCount(g); j++) {
+            text += "    ";
+            appendDotNode(text, 'n', static_cast<size_t>(c.gateInputs(g)[j]));
+            text += " -> ";
+            appendDotNode(text, 'g', g);
+            text += ";\n";
+        }
+        text += "    ";
+        appendDotNode(text, 'g', g);
+        text += " -> ";
+        appendDotNode(text, 'n', static_cast<size_t>(c.gateOutputs[g]));
+        text += ";\n";
+        flushText();
+    }
+    for (size_t f = 0; f < c.flopCount(); f++) {
+        if (!drawFlop[f]) continue;
+        text += "    ";
+        appendDotNode(text, 'f', f);
+        text += " [label=\"DFF\", color=plum];\n    ";
+        appendDotNode(text, 'n', static_cast<size_t>(c.flopInputs[f]));
+        text += " -> ";
+        appendDotNode(text, 'f', f);
+        text += ";\n    ";
+        appendDotNode(text, 'f', f);
+        text += " -> ";
+        appendDotNode(text, 'n', static_cast<size_t>(c.flopOutputs[f]));
+        text += ";\n";
+    }
+    text += "}\n";
+    out.appendLines(text);
+    out.flush();
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) ok = false;
+    if (!ok) cerr << "❌ Error: Could not write DOT file '" << path << "'.\n";
+    return ok;
+}
+
+void VcdWriter::sample(const SimState &s, int lane) {
+    const uint64_t t = time++;
+    if (t < firstTime || t > lastTime) return;
+    
+    const size_t k = s.packedWordsPerNet;
+    text.clear();
+    bool stamped = false;
+    for (size_t i = 0; i < nets.size(); i++) {
+        const int id = nets[i];
+        const char value = lane < 0 ? s.netValues[id]
+                                    : static_cast<char>((s.netWords[id * k + lane / 64] >> (lane % 64)) & 1);
+        if (t != firstTime && value == values[i]) continue;
+        if (!stamped) {
+            appendTime(t);
+            if (t == firstTime) text += "$dumpvars\n";
+            stamped = true;
+        }
+        values[i] = value;
+        text += static_cast<char>('0' + value);
+        appendCode(i);
+        text += '\n';
+    }
+    if (t == firstTime) text += "$end\n";
+    out.appendLines(text);
+}
+
+void VcdWriter::finish() {
+    if (!file) return;
+    if (time > firstTime) {
+        text.clear();
+        appendTime(min(time - 1, lastTime) + 1);
+        out.appendLines(text);
+    }
+    out.flush();
+    fclose(file);
+    file = nullptr;
+}
+
+void VcdWriter::appendTime(uint64_t t) {
+    char digits[24];
+    digits[0] = '#';
+    char *end = to_chars(digits + 1, digits + sizeof(digits), t).ptr;
+    text.append(digits, end - digits);
+    text += '\n';
+}
+
+void VcdWriter::appendCode(size_t i) {
+    do {
+        text += static_cast<char>('!' + i % 94);
+        i /= 94;
+    } while (i > 0);
+}
+
+void VcdWriter::writeHeader(const CompiledCircuit &c, const string &scope) {
+    text = "$version Digital Circuit Simulator $end\n";
+    text += "$comment one time step per vector or clock cycle $end\n";
+    text += "$timescale 1ns $end\n";
+    text += "$scope module " + scope + " $end\n";
+    
+    // Names arrive sorted, so each scope's nets are contiguous
+    vector<string_view> open;
+    for (size_t i = 0; i < nets.size(); i++) {
+        string_view name = c.netName(nets[i]);
+        vector<string_view> path;
+        size_t start = 0, dot;
+        while ((dot = name.find('.', start)) != string_view::npos) {
+            path.push_back(name.substr(start, dot - start));
+            start = dot + 1;
+        }
+        size_t common = 0;
+        while (common < open.size() && common < path.size() && open[common] == path[common]) common++;
+        for (size_t d = open.size(); d > common; d--) text += "$upscope $end\n";
+        open.resize(common);
+        for (size_t d = common; d < path.size(); d++) {
+            ((text += "$scope module ") += path[d]) += " $end\n";
+            open.push_back(path[d]);
+        }
+        text += "$var wire 1 ";
+        appendCode(i);
+        ((text += ' ') += name.substr(start)) += " $end\n";
+        if (text.size() >= OutputBuffer::FLUSH_SIZE) {
+            out.appendLines(text);
+            text.clear();
+        }
+    }
+    for (size_t d = 0; d <= open.size(); d++) text += "$upscope $end\n";
+    text += "$enddefinitions $end\n";
+    out.appendLines(text);
+}
+
+unique_ptr<VcdWriter> openVcdWriter(const CompiledCircuit &c, const string &circuitName,
+                                    const VcdOptions &options) {
+    vector<char> selected(c.nets, options.nets.empty());
+    for (const auto &name : options.nets) {
+        bool found = false;
+        string prefix = name + ".";
+        auto it = lower_bound(c.netsByName.begin(), c.netsByName.end(), string_view(name),
+                              [&c](int32_t id, string_view key) { return c.netName(id) < key; });
+        for (; it != c.netsByName.end(); ++it) {
+            string_view net = c.netName(*it);
+            if (net != name && net.compare(0, prefix.size(), prefix) != 0) break;
+            selected[*it] = 1;
+            found = true;
+        }
+        if (!found) {
+            cerr << "❌ Error: No net or scope named '" << name << "' to dump.\n";
+            return nullptr;
+        }
+    }
+    vector<int> nets;
+    for (int id : c.netsByName) {
+        if (selected[id]) nets.push_back(id);
+    }
+    
+    FILE *file = fopen(options.path.c_str(), "wb");
+    if (!file) {
+        cerr << "❌ Error: Could not create VCD file '" << options.path << "'.\n";
+        return nullptr;
+    }
+    return unique_ptr<VcdWriter>(new VcdWriter(file, c, circuitName.empty() ? "top" : circuitName,
+                                               move(nets), options.firstTime, options.lastTime));
+}
+
+/**
+ * @brief Parses one input vector line into 0/1 values
+ * @param data Line text
+ * @param length Line length
+ * @param bits Receives the values (buffer is reused between calls)
+ * @return true if the line holds only 0/1 digits and whitespace
+ * 
+ * Values may be separated by whitespace ("0 1 1") or written together ("011").
+ */
+bool parseVectorLine(const char *data, size_t length, vector<char> &bits) {
+    bits.clear();
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (c == '0' || c == '1') bits.push_back(c - '0');
+        else if (c != ' ' && c != '\t') return false;
+    }
+    return true;
+}
+
+/**
+ * @enum VectorLineKind
+ * @brief What a line of a vector file holds
+ */
+enum class VectorLineKind {
+    VECTOR,  ///< Input values
+    SKIP,    ///< Blank line or '#' comment
+    STREAM,  ///< STREAM line: the following vectors form another stimulus stream
+    END      ///< EXIT line: no vectors follow
+};
+
+/**
+ * @brief Classifies one line of a vector file
+ * @param data Line text
+ * @param length Line length
+ * @return SKIP for blank and comment lines, END for EXIT, STREAM for STREAM, else VECTOR
+ * 
+ * Comments and EXIT are accepted so interactive scripts can be replayed.
+ * Only the cycle-based engine accepts STREAM lines.
+ */
+VectorLineKind classifyVectorLine(const char *data, size_t length) {
+    size_t first = 0;
+    while (first < length && (data[first] == ' ' || data[first] == '\t')) first++;
+    if (first == length || data[first] == '#') return VectorLineKind::SKIP;
+    if ((data[first] == 'E' || data[first] == 'e') &&
+        toUpper(string(data + first, length - first)).compare(0, 4, "EXIT") == 0) return VectorLineKind::END;
+    if ((data[first] == 'S' || data[first] == 's') &&
+        toUpper(string(data + first, length - first)).compare(0, 6, "STREAM") == 0) return VectorLineKind::STREAM;
+    return VectorLineKind::VECTOR;
+}
+
+void VectorReader::run() {
+    LineReader lines(file);
+    vector<char> row((nInputs + 7) / 8);
+    vector<char> bits;
+    size_t lineNumber = 0;
+    bool done = false;
+    for (size_t filling = 0; ; filling ^= 1) {
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&]() { return !full[filling] || stopping; });
+            if (stopping) return;
+        }
+        VectorChunk &chunk = chunks[filling];
+        chunk.count = 0;
+        char *out = chunk.bits.data();
+        while (!done && chunk.count < chunkVectors) {
+            if (binary) {
+                size_t got = fread(row.data(), 1, row.size(), file);
+                if (got == 0 || row.empty()) {
+                    done = true;
+                } else if (got < row.size()) {
+                    cerr << "❌ Error: " << path << ": truncated vector " << lineNumber + 1 << ".\n";
+                    error = done = true;
+                } else {
+                    // Input i is bit i + pad of the row, counting from the most significant
+                    const size_t pad = row.size() * 8 - nInputs;
+                    for (size_t i = 0; i < nInputs; i++) {
+                        out[i] = static_cast<char>((row[(i + pad) / 8] >> (7 - (i + pad) % 8)) & 1);
+                    }
+                    lineNumber++;
+                    out += nInputs;
+                    chunk.count++;
+                }
+                continue;
+            }
+            
+            const char *data;
+            size_t length;
+            if (!lines.next(data, length)) {
+                done = true;
+                break;
+            }
+            lineNumber++;
+            VectorLineKind kind = classifyVectorLine(data, length);
+            if (kind == VectorLineKind::SKIP) continue;
+            if (kind == VectorLineKind::END) {
+                done = true;
+                break;
+            }
+            if (!parseVectorLine(data, length, bits) || bits.size() != nInputs) {
+                cerr << "❌ Error: " << path << ":" << lineNumber << ": expected "
+                     << nInputs << " input values (0 or 1).\n";
+                error = done = true;
+                break;
+            }
+            out = copy(bits.begin(), bits.end(), out);
+            chunk.count++;
+        }
+        chunk.last = done;
+        {
+            lock_guard<mutex> guard(lock);
+            full[filling] = true;
+        }
+        changed.notify_all();
+        if (done) return;
+    }
+}
+
+/**
+ * @class ResultWriter
+ * @brief Writes blocks of result text on a background thread
+ * 
+ * The last stage of the batch pipeline: while it writes one chunk's
+ * results, the simulator fills the next chunk's. A submitted block must
+ * stay untouched until the next submit() or finish() returns, so callers
+ * alternate between two sets of buffers.
+ */
+class ResultWriter {
+public:
+    explicit ResultWriter(OutputBuffer &out) : out(out), worker([this]() { run(); }) {}
+    
+    ~ResultWriter() { finish(); }
+    
+    /// Waits for the previous block, then queues texts[0..count) for writing
+    void submit(const vector<string> &texts, size_t count) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this]() { return !pending; });
+        block = &texts;
+        blockCount = count;
+        pending = true;
+        changed.notify_all();
+    }
+    
+    /// Waits until everything submitted is written and stops the thread
+    void finish() {
+        if (!worker.joinable()) return;
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this]() { return !pending; });
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+    
+private:
+    OutputBuffer &out;
+    const vector<string> *block = nullptr;
+    size_t blockCount = 0;
+    bool pending = false;    ///< A block is queued or being written
+    bool stopping = false;
+    mutex lock;
+    condition_variable changed;
+    thread worker;
+    
+    void run() {
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [this]() { return pending || stopping; });
+                if (!pending) return;
+            }
+            for (size_t t = 0; t < blockCount; t++) out.appendLines((*block)[t]);
+            {
+                lock_guard<mutex> guard(lock);
+                pending = false;
+            }
+            changed.notify_all();
+        }
+    }
+};
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads that run parallel-for jobs
+ * 
+ * The calling thread takes part in every job as worker 0, so a pool of
+ * size 1 starts no threads and runs jobs inline.
+ */
+class ThreadPool {
+public:
+    /// Task callback: task index and the index of the worker running it
+    using Task = function<void(size_t task, size_t worker)>;
+    
+    /**
+     * @brief Starts the worker threads
+     * @param threads Total number of workers, including the calling thread
+     */
+    explicit ThreadPool(size_t threads) {
+        for (size_t w = 1; w < threads; w++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, w);
+        }
+    }
+    
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : workers) t.join();
+    }
+    
+    /// Number of workers, including the calling thread
+    size_t size() const { return workers.size() + 1; }
+    
+    /**
+     * @brief Runs task(i, worker) for every i in [0, count) and waits for all of them
+     * @param count Number of tasks
+     * @param task Callback; tasks are handed out dynamically to balance load
+     */
+    void parallelFor(size_t count, const Task &task) {
+        {
+            lock_guard<mutex> guard(lock);
+            job = &task;
+            jobCount = count;
+            nextTask = 0;
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        runTasks(0);
+        
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [this] { return busy == 0; });
+        job = nullptr;
+    }
+    
+private:
+    void runTasks(size_t worker) {
+        size_t i;
+        while ((i = nextTask.fetch_add(1)) < jobCount) (*job)(i, worker);
+    }
+    
+    void workerLoop(size_t worker) {
+        size_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            runTasks(worker);
+            
+            lock_guard<mutex> guard(lock);
+            if (--busy == 0) done.notify_one();
+        }
+    }
+    
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;        ///< Signals a new job or shutdown
+    condition_variable done;        ///< Signals that every worker finished the job
+    const Task *job = nullptr;
+    size_t jobCount = 0;
+    atomic<size_t> nextTask{0};
+    size_t generation = 0;          ///< Incremented for every job
+    size_t busy = 0;                ///< Workers still running the current job
+    bool stopping = false;
+};
+
+/**
+ * @class SpinBarrier
+ * @brief Reusable barrier for a fixed number of threads
+ * 
+ * Levels are short, so waiting threads spin (yielding) instead of
+ * sleeping. Arrival and release use acquire/release ordering, so every
+ * net written before the barrier is visible to all threads after it.
+ */
+class SpinBarrier {
+public:
+    explicit SpinBarrier(size_t threads) : count(threads) {}
+    
+    void wait() {
+        const size_t gen = generation.load(memory_order_acquire);
+        if (arrived.fetch_add(1, memory_order_acq_rel) + 1 == count) {
+            arrived.store(0, memory_order_relaxed);
+            generation.store(gen + 1, memory_order_release);
+            return;
+        }
+        while (generation.load(memory_order_acquire) == gen) this_thread::yield();
+    }
+    
+private:
+    const size_t count;
+    atomic<size_t> arrived{0};
+    atomic<size_t> generation{0};
+};
+
+/**
+ * @class LevelParallelSimulator
+ * @brief Evaluates the gates of each logic level in parallel for one vector
+ * 
+ * Gates within a level never depend on each other, so a wide level is cut
+ * into chunks that all workers evaluate concurrently, with a barrier
+ * before the next level. Each worker starts on its own contiguous share
+ * of the chunks and then steals remaining chunks from the other workers,
+ * which balances uneven chunks. Consecutive levels narrower than the
+ * parallel threshold are evaluated serially by the calling thread with
+ * no synchronization at all.
+ * 
+ * Produces exactly the same net values as simulate().
+ */
+class LevelParallelSimulator {
+public:
+    static const size_t DEFAULT_MIN_PARALLEL_WIDTH = 2048;  ///< Narrower levels run serially
+    static const size_t DEFAULT_CHUNK_GATES = 256;          ///< Gates per stealable chunk
+    
+    /**
+     * @brief Plans the level schedule and starts the workers
+     * @param circuit Levelized circuit; must outlive the simulator
+     * @param threads Total workers, including the calling thread
+     * @param minParallelWidth Levels with fewer gates run serially
+     * @param chunkGates Gates per chunk
+     */
+    LevelParallelSimulator(const CompiledCircuit &circuit, size_t threads,
+                           size_t minParallelWidth = DEFAULT_MIN_PARALLEL_WIDTH,
+                           size_t chunkGates = DEFAULT_CHUNK_GATES)
+        : c(circuit), nThreads(max<size_t>(threads, 1)), chunkSize(max<size_t>(chunkGates, 1)),
+          barrier(nThreads), shares(2 * nThreads) {
+        // Merge runs of narrow levels into single serial steps
+        for (size_t l = 0; l < c.levelCount(); l++) {
+            size_t begin = c.levelOffsets[l], end = c.levelOffsets[l + 1];
+            bool parallel = nThreads > 1 && end - begin >= minParallelWidth;
+            if (!parallel && !steps.empty() && !steps.back().parallel) {
+                steps.back().end = end;
+            } else {
+                steps.push_back({begin, end, parallel});
+            }
+            if (parallel) parallelLevels++;
+        }
+        
+        if (parallelLevels > 0) {
+            for (size_t w = 1; w < nThreads; w++) {
+                workers.emplace_back(&LevelParallelSimulator::workerLoop, this, w);
+            }
+        }
+    }
+    
+    ~LevelParallelSimulator() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : workers) t.join();
+    }
+    
+    /// Levels wide enough to be evaluated in parallel
+    size_t parallelLevelCount() const { return parallelLevels; }
+    
+    /**
+     * @brief Simulates the circuit for the primary inputs set in s.netValues
+     * @param s Simulation state; only the calling thread may use it meanwhile
+     */
+    void simulate(SimState &s) {
+        values = s.netValues.data();
+        if (!workers.empty()) {
+            {
+                lock_guard<mutex> guard(lock);
+                run++;
+            }
+            wake.notify_all();
+        }
+        runSteps(0);
+        PROFILE(s.profile.sweeps++);
+    }
+    
+private:
+    /// A run of serial levels, or one parallel level
+    struct Step {
+        size_t begin;   ///< First gate
+        size_t end;     ///< One past the last gate
+        bool parallel;
+    };
+    
+    /// Chunks of the current level still owned by one worker
+    struct alignas(64) Share {
+        atomic<size_t> next{0};  ///< Next unclaimed chunk
+        size_t end = 0;          ///< One past the worker's last chunk
+    };
+    
+    void evalRange(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            values[c.gateOutputs[i]] = evalGate(c, i, values);
+        }
+    }
+    
+    /// Claims chunks from a share until it is empty
+    void drainShare(const Step &step, Share &share) {
+        size_t chunk;
+        while ((chunk = share.next.fetch_add(1, memory_order_relaxed)) < share.end) {
+            size_t begin = step.begin + chunk * chunkSize;
+            evalRange(begin, min(begin + chunkSize, step.end));
+        }
+    }
+    
+    /// Executes the schedule; serial steps are run by worker 0 only
+    void runSteps(size_t worker) {
+        bool synced = false;  // Whether the shares of this step are already published
+        size_t parity = 0;    // Consecutive parallel levels alternate share buffers
+        for (size_t k = 0; k < steps.size(); k++) {
+            const Step &step = steps[k];
+            if (!step.parallel) {
+                if (worker == 0) evalRange(step.begin, step.end);
+                synced = false;
+                continue;
+            }
+            
+            Share *current = &shares[parity * nThreads];
+            if (!synced) {
+                // Worker 0 publishes the shares once the serial prefix is done
+                if (worker == 0) assignShares(step, current);
+                barrier.wait();
+            }
+            
+            drainShare(step, current[worker]);
+            for (size_t v = 1; v < nThreads; v++) {
+                drainShare(step, current[(worker + v) % nThreads]);  // Steal
+            }
+            
+            // The other buffer was last used two levels ago, so worker 0 can
+            // fill it for the next level while others finish this one
+            bool nextParallel = k + 1 < steps.size() && steps[k + 1].parallel;
+            if (nextParallel && worker == 0) {
+                assignShares(steps[k + 1], &shares[(parity ^ 1) * nThreads]);
+            }
+            barrier.wait();
+            synced = nextParallel;
+            parity ^= 1;
+        }
+    }
+    
+    /// Splits a level's chunks into one contiguous share per worker
+    void assignShares(const Step &step, Share *target) {
+        size_t chunks = (step.end - step.begin + chunkSize - 1) / chunkSize;
+        for (size_t w = 0; w < nThreads; w++) {
+            target[w].next.store(chunks * w / nThreads, memory_order_relaxed);
+            target[w].end = chunks * (w + 1) / nThreads;
+        }
+    }
+    
+    void workerLoop(size_t worker) {
+        size_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || run != seen; });
+                if (stopping) return;
+                seen = run;
+            }
+            runSteps(worker);
+        }
+    }
+    
+    const CompiledCircuit &c;
+    const size_t nThreads;
+    const size_t chunkSize;
+    vector<Step> steps;
+    size_t parallelLevels = 0;
+    int *values = nullptr;          ///< Net values of the state being simulated
+    
+    SpinBarrier barrier;
+    vector<Share> shares;           ///< Two buffers of one share per worker
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;        ///< Signals a new run or shutdown
+    size_t run = 0;                 ///< Incremented for every simulate() call
+    bool stopping = false;
+};
+
+/// Gates per generated function; keeps each function small enough to compile quickly
+const size_t NATIVE_GATES_PER_FUNCTION = 2048;
+
+/// Bumped whenever the generated code changes, so stale cache entries are not reused
+const uint32_t NATIVE_CODE_VERSION = 1;
+
+/**
+ * @struct NativeLaneInfo
+ * @brief Word type of a generated sweep for one packed kernel
+ */
+struct NativeLaneInfo {
+    const char *type;    ///< C++ type of one net's lanes
+    const char *flags;   ///< Extra compiler flags
+};
+
+/// Word types of generated sweeps, indexed by PackedKernel (same layout as SimState::netWords)
+const NativeLaneInfo NATIVE_LANES[] = {
+    {"uint64_t", ""},
+    {"uint64_t __attribute__((vector_size(32)))", " -mavx2"},
+    {"uint64_t __attribute__((vector_size(64)))", " -mavx512f"},
+};
+
+/**
+ * @brief Hashes everything the generated sweep of a circuit depends on
+ * @param c Levelized circuit
+ * @param kernel Lane width of the generated code
+ * @param storeAllNets Whether the sweep stores every net (see generateSweepSource())
+ * @return 64-bit FNV-1a hash as 16 hex digits
+ */
+string nativeCodeHash(const CompiledCircuit &c, PackedKernel kernel, bool storeAllNets) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&h](const void *data, size_t bytes) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < bytes; i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+    };
+    const uint32_t header[] = {NATIVE_CODE_VERSION, static_cast<uint32_t>(NATIVE_GATES_PER_FUNCTION),
+                               static_cast<uint32_t>(kernel), c.nets, storeAllNets};
+    mix(header, sizeof(header));
+    mix(c.gateOps.data(), c.gateOps.size() * sizeof(GateOp));
+    mix(c.gateOutputs.data(), c.gateOutputs.size() * sizeof(int32_t));
+    mix(c.faninOffsets.data(), c.faninOffsets.size() * sizeof(uint32_t));
+    mix(c.fanins.data(), c.fanins.size() * sizeof(int32_t));
+    mix(c.primaryOutputIds.data(), c.primaryOutputIds.size() * sizeof(int32_t));
+    
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+    return hex;
+}
+
+/**
+ * @brief Generates C++ source for a straight-line packed sweep of a circuit
+ * @param c Levelized circuit
+ * @param kernel Lane width of the generated code
+ * @param storeAllNets Store every net, for callers that read internal nets
+ * @return Source defining extern "C" void circuit_sweep(void *words)
+ * 
+ * The generated function does what simulatePacked() does with the same
+ * kernel, on the same SimState::netWords layout. Each gate becomes one
+ * bitwise statement on a local; only nets read by a later function or
+ * driving a primary output are stored back to the word array. Gates are
+ * split into functions of NATIVE_GATES_PER_FUNCTION, in level order.
+ */
+string generateSweepSource(const CompiledCircuit &c, PackedKernel kernel, bool storeAllNets) {
+    const size_t nGates = c.gateCount();
+    auto partOf = [](size_t g) { return static_cast<int64_t>(g / NATIVE_GATES_PER_FUNCTION); };
+    
+    // Which function defines each net, and whether any other function needs it
+    vector<int64_t> definedIn(c.netCount(), -1);
+    vector<char> stored(c.netCount(), storeAllNets);
+    for (size_t g = 0; g < nGates; g++) definedIn[c.gateOutputs[g]] = partOf(g);
+    for (size_t g = 0; g < nGates; g++) {
+        const int32_t *in = c.gateInputs(g);
+        for (uint32_t j = 0; j < c.gateInputCount(g); j++) {
+            if (definedIn[in[j]] >= 0 && definedIn[in[j]] != partOf(g)) stored[in[j]] = 1;
+        }
+    }
+    for (int32_t id : c.primaryOutputIds) {
+        if (id >= 0) stored[id] = 1;
+    }
+    
+    string src = string("// Generated by circuit: native packed sweep\n"
+                        "#include <stdint.h>\n"
+                        "typedef ") + NATIVE_LANES[static_cast<int>(kernel)].type + " W;\n";
+    auto net = [&](size_t g, int32_t id) {
+        return definedIn[id] == partOf(g) ? "n" + to_string(id) : "v[" + to_string(id) + "]";
+    };
+    const size_t parts = (nGates + NATIVE_GATES_PER_FUNCTION - 1) / NATIVE_GATES_PER_FUNCTION;
+    for (size_t part = 0; part < parts; part++) {
+        src += "\nstatic void __attribute__((noinline)) part" + to_string(part) + "(W *v) {\n";
+        const size_t end = min(nGates, (part + 1) * NATIVE_GATES_PER_FUNCTION);
+        for (size_t g = part * NATIVE_GATES_PER_FUNCTION; g < end; g++) {
+            const GateOp op = c.gateOps[g];
+            const int32_t *in = c.gateInputs(g);
+            const uint32_t n = c.gateInputCount(g);
+            const string out = to_string(c.gateOutputs[g]);
+            
+            // Inverting gates (NAND, NOR, XNOR, NOT) wrap their base form in ~( )
+            string expr;
+            const char *join = nullptr;
+            switch (baseGateOp(op)) {
+                case GateOp::AND: join = " & "; break;
+                case GateOp::OR:  join = " | "; break;
+                case GateOp::XOR: join = " ^ "; break;
+                default:          break;
+            }
+            if (op == GateOp::CONST0 || op == GateOp::CONST1) {
+                expr = (op == GateOp::CONST1) ? "~W{}" : "W{}";
+            } else {
+                for (uint32_t j = 0; j < (join ? n : 1); j++) {
+                    if (j > 0) expr += join;
+                    expr += net(g, in[j]);
+                }
+            }
+            if (isInvertingGateOp(op)) expr = "~(" + expr + ")";
+            
+            src += "    const W n" + out + " = " + expr + ";\n";
+            if (stored[c.gateOutputs[g]]) src += "    v[" + out + "] = n" + out + ";\n";
+        }
+        src += "}\n";
+    }
+    
+    src += "\nextern \"C\" void circuit_sweep(void *words) {\n"
+           "    W *v = static_cast<W *>(words);\n";
+    for (size_t part = 0; part < parts; part++) src += "    part" + to_string(part) + "(v);\n";
+    src += "}\n";
+    return src;
+}
+
+#ifndef _WIN32
+bool runCommand(const vector<string> &args, const string &outputPath) {
+    vector<char *> argv;
+    for (const string &arg : args) argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+    
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, outputPath.c_str(),
+                                     O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    pid_t pid;
+    const bool started = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+    if (!started) return false;
+    
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Checks that a JIT cache entry can only have been written by this user
+ * @param path Cache directory or library
+ * @param directory Whether path must be a directory (otherwise a regular file)
+ * @param error Receives the reason on failure
+ * @return true if path is owned by the effective user and writable by nobody else
+ * 
+ * Cached libraries are loaded into the process, so anything another user
+ * could have planted or replaced is refused.
+ */
+bool checkPrivatePath(const string &path, bool directory, string &error) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        error = "cannot access '" + path + "'";
+        return false;
+    }
+    if (directory ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode)) {
+        error = "'" + path + "' is not a " + (directory ? "directory" : "regular file");
+        return false;
+    }
+    if (st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        error = "'" + path + "' is not private to this user";
+        return false;
+    }
+    return true;
+}
+#endif
+
+NativeSweep::~NativeSweep() {
+#ifndef _WIN32
+    if (handle) dlclose(handle);
+#endif
+}
+
+bool NativeSweep::load(const CompiledCircuit &c, PackedKernel kernel, string &error, bool storeAllNets) {
+    compiled = chrono::milliseconds(0);
+#ifdef _WIN32
+    (void)c;
+    (void)kernel;
+    (void)storeAllNets;
+    error = "native code generation is not supported on Windows";
+    return false;
+#else
+    // The cache is private to the user; there is no shared fallback directory
+    const char *env = getenv("CIRCUIT_JIT_CACHE");
+    const char *home = getenv("HOME");
+    if (!env && !home) {
+        error = "no cache directory (set CIRCUIT_JIT_CACHE or HOME)";
+        return false;
+    }
+    const string dir = env ? env : string(home) + "/.cache/circuit-jit";
+    if (!env) mkdir((string(home) + "/.cache").c_str(), 0700);
+    mkdir(dir.c_str(), 0700);
+    if (!checkPrivatePath(dir, true, error)) return false;
+    
+    const string base = dir + "/" + nativeCodeHash(c, kernel, storeAllNets);
+    const string library = base + ".so";
+    if (access(library.c_str(), F_OK) != 0) {
+        // Source, log and partial library share a unique stem, so concurrent
+        // runs never touch each other's files or load a partial library
+        string source = base + ".XXXXXX.cpp";
+        const int fd = mkstemps(&source[0], 4);
+        FILE *file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+        if (!file) {
+            if (fd >= 0) close(fd);
+            error = "cannot write to '" + dir + "'";
+            return false;
+        }
+        const string text = generateSweepSource(c, kernel, storeAllNets);
+        bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+        if (fclose(file) != 0 || !written) {
+            remove(source.c_str());
+            error = "cannot write '" + source + "'";
+            return false;
+        }
+        const string stem = source.substr(0, source.size() - 4);
+        const string log = stem + ".log";
+        const string partial = stem + ".so";
+        
+        // $CIRCUIT_JIT_CXX is split into words; no shell ever sees it
+        vector<string> args;
+        const char *cxx = getenv("CIRCUIT_JIT_CXX");
+        istringstream words(string(cxx ? cxx : "c++") + " -O1 -shared -fPIC" +
+                            NATIVE_LANES[static_cast<int>(kernel)].flags);
+        for (string word; words >> word;) args.push_back(word);
+        args.insert(args.end(), {"-o", partial, source});
+        
+        auto start = chrono::steady_clock::now();
+        if (!runCommand(args, log) || rename(partial.c_str(), library.c_str()) != 0) {
+            remove(partial.c_str());
+            error = "compiler failed (see " + log + ")";
+            return false;
+        }
+        remove(log.c_str());
+        remove(source.c_str());
+        compiled = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    }
+    if (!checkPrivatePath(library, false, error)) return false;
+    
+    handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        error = dlerror();
+        return false;
+    }
+    function = reinterpret_cast<void (*)(void *)>(dlsym(handle, "circuit_sweep"));
+    if (!function) {
+        error = "'" + library + "' has no circuit_sweep";
+        return false;
+    }
+    return true;
+#endif
+}
+
+/// Memory all cone tables of a circuit may take together
+const size_t CONE_TABLE_MEMORY_LIMIT = 64 << 20;
+
+/**
+ * @class ConeTables
+ * @brief Lookup tables replacing the logic cones of reported nets with a small input support
+ * 
+ * The support of every net (the primary inputs its value depends on) is
+ * computed in level order, tracked only while it stays within the limit.
+ * A reported net whose support is small and whose cone has more gates
+ * than support inputs gets a packed truth table, built once by sweeping
+ * its cone over every support combination, 64 patterns per word. The
+ * scalar engine then evaluates only the residual gates, those in the
+ * cone of the other reported nets, and finds each tabled net with one
+ * table index per vector. Nets other than the reported ones and the
+ * inputs are left stale, so tables only serve callers that read nothing
+ * else.
+ */
+class ConeTables {
+public:
+    /**
+     * @brief Builds the tables of some reported nets
+     * @param c Levelized circuit
+     * @param nets Nets read after each vector (-1 entries are ignored)
+     * @param maxSupport Largest support to tabulate (at most CONE_TABLE_MAX_SUPPORT)
+     */
+    ConeTables(const CompiledCircuit &c, const vector<int32_t> &nets, size_t maxSupport) {
+        maxSupport = min(maxSupport, CONE_TABLE_MAX_SUPPORT);
+        const size_t nGates = c.gateCount();
+        vector<int32_t> driver(c.netCount(), -1);
+        for (size_t g = 0; g < nGates; g++) driver[c.gateOutputs[g]] = static_cast<int32_t>(g);
+        
+        // Supports as sorted net lists; UINT32_MAX marks one over the limit
+        vector<uint32_t> supportStart(c.netCount() + 1, 0), supportEnd(c.netCount(), 0);
+        vector<int32_t> supports;
+        for (int id : c.primaryInputIds) {
+            supportStart[id] = static_cast<uint32_t>(supports.size());
+            supports.push_back(id);
+            supportEnd[id] = static_cast<uint32_t>(supports.size());
+        }
+        vector<int32_t> merged;
+        for (size_t g = 0; g < nGates; g++) {
+            merged.clear();
+            bool large = false;
+            for (uint32_t j = 0; j < c.gateInputCount(g) && !large; j++) {
+                const int in = c.gateInputs(g)[j];
+                if (supportEnd[in] == UINT32_MAX) large = true;
+                else merged.insert(merged.end(), &supports[0] + supportStart[in], &supports[0] + supportEnd[in]);
+            }
+            sort(merged.begin(), merged.end());
+            merged.erase(unique(merged.begin(), merged.end()), merged.end());
+            const int out = c.gateOutputs[g];
+            if (large || merged.size() > maxSupport) {
+                supportEnd[out] = UINT32_MAX;
+                continue;
+            }
+            supportStart[out] = static_cast<uint32_t>(supports.size());
+            supports.insert(supports.end(), merged.begin(), merged.end());
+            supportEnd[out] = static_cast<uint32_t>(supports.size());
+        }
+        
+        // Pick the nets to tabulate while the memory budget lasts
+        vector<char> reported(c.netCount(), 0), tabled(c.netCount(), 0);
+        vector<uint32_t> coneGates;
+        vector<char> inCone(nGates, 0);
+        size_t words = 0;
+        for (int id : nets) {
+            if (id < 0 || reported[id]) continue;
+            reported[id] = 1;
+            if (driver[id] < 0 || supportEnd[id] == UINT32_MAX) continue;
+            const size_t support = supportEnd[id] - supportStart[id];
+            const size_t tableWords = ((size_t(1) << support) + 63) / 64;
+            if ((words + tableWords) * sizeof(uint64_t) > CONE_TABLE_MEMORY_LIMIT) continue;
+            if (coneOf(c, driver, id, inCone, coneGates) <= support) continue;
+            tabled[id] = 1;
+            words += tableWords;
+        }
+        
+        // Residual gates: the cones of the reported nets left untabled
+        vector<char> needed(c.netCount(), 0);
+        for (int id : nets) {
+            if (id >= 0 && !tabled[id]) needed[id] = 1;
+        }
+        vector<char> keep(nGates, 0);
+        for (size_t g = nGates; g-- > 0;) {
+            if (!needed[c.gateOutputs[g]]) continue;
+            keep[g] = 1;
+            for (uint32_t j = 0; j < c.gateInputCount(g); j++) needed[c.gateInputs(g)[j]] = 1;
+        }
+        for (size_t g = 0; g < nGates; g++) {
+            if (keep[g]) residualGates.push_back(static_cast<uint32_t>(g));
+        }
+        
+        // A net the residual logic computes anyway needs no table
+        vector<uint64_t> v(c.netCount(), 0);
+        for (int id : nets) {
+            if (id < 0 || !tabled[id] || needed[id]) continue;
+            tabled[id] = 0;
+            tableNets.push_back(id);
+            supportOffsets.push_back(static_cast<uint32_t>(supportNets.size()));
+            supportNets.insert(supportNets.end(), &supports[0] + supportStart[id], &supports[0] + supportEnd[id]);
+            tableOffsets.push_back(static_cast<uint32_t>(tableWords.size()));
+            
+            const size_t support = supportEnd[id] - supportStart[id];
+            const uint64_t patterns = 1ULL << support;
+            coneOf(c, driver, id, inCone, coneGates);
+            for (uint64_t base = 0; base < patterns; base += 64) {
+                for (size_t j = 0; j < support; j++) {
+                    v[supports[supportStart[id] + j]] = exhaustivePatternWord(base, static_cast<int>(j));
+                }
+                for (uint32_t g : coneGates) {
+                    applyGate(v[c.gateOutputs[g]], c.gateOps[g], v.data(), c.gateInputs(g),
+                              static_cast<int>(c.gateInputCount(g)));
+                }
+                tableWords.push_back(patterns < 64 ? v[id] & ((1ULL << patterns) - 1) : v[id]);
+            }
+        }
+        supportOffsets.push_back(static_cast<uint32_t>(supportNets.size()));
+    }
+    
+    /// Nets found by lookup
+    size_t tableCount() const { return tableNets.size(); }
+    
+    /// Gates the scalar engine still evaluates, in level order
+    const vector<uint32_t> &gates() const { return residualGates; }
+    
+    /// Bytes held by the tables and their support lists
+    size_t bytes() const {
+        return tableWords.size() * sizeof(uint64_t) +
+               (supportNets.size() + tableNets.size() + supportOffsets.size() + tableOffsets.size()) * sizeof(int32_t);
+    }
+    
+    /**
+     * @brief Evaluates the residual gates, then looks up the tabled nets
+     * @param c Levelized circuit the tables were built for
+     * @param s Simulation state whose primary input values are set
+     */
+    void simulate(const CompiledCircuit &c, SimState &s) const {
+        int *values = s.netValues.data();
+        for (uint32_t g : residualGates) values[c.gateOutputs[g]] = evalGate(c, g, values);
+        for (size_t t = 0; t < tableNets.size(); t++) {
+            uint32_t index = 0;
+            for (uint32_t j = supportOffsets[t]; j < supportOffsets[t + 1]; j++) {
+                index |= static_cast<uint32_t>(values[supportNets[j]]) << (j - supportOffsets[t]);
+            }
+            values[tableNets[t]] = static_cast<int>((tableWords[tableOffsets[t] + index / 64] >> (index % 64)) & 1);
+        }
+        PROFILE(s.profile.sweeps++);
+    }
+    
+private:
+    vector<uint32_t> residualGates;
+    vector<int32_t> tableNets;        ///< Net of each table
+    vector<uint32_t> supportOffsets;  ///< Start of each table's support in supportNets
+    vector<int32_t> supportNets;      ///< Support inputs; the first is bit 0 of the table index
+    vector<uint32_t> tableOffsets;    ///< Start of each table in tableWords
+    vector<uint64_t> tableWords;      ///< Bit i of a table is the net's value for index i
+    
+    /// Gates of a net's cone in level order; returns their count
+    static size_t coneOf(const CompiledCircuit &c, const vector<int32_t> &driver, int id,
+                         vector<char> &inCone, vector<uint32_t> &gates) {
+        gates.clear();
+        vector<int32_t> stack(1, driver[id]);
+        while (!stack.empty()) {
+            int32_t g = stack.back();
+            stack.pop_back();
+            if (g < 0 || inCone[g]) continue;
+            inCone[g] = 1;
+            gates.push_back(static_cast<uint32_t>(g));
+            for (uint32_t j = 0; j < c.gateInputCount(g); j++) stack.push_back(driver[c.gateInputs(g)[j]]);
+        }
+        sort(gates.begin(), gates.end());
+        for (uint32_t g : gates) inCone[g] = 0;
+        return gates.size();
+    }
+};
+
+/**
+ * @brief Appends one compact result line: input bits, a space, output bits
+ * @param text Destination
+ * @param inputs Input values (0/1 bytes)
+ * @param nInputs Number of inputs
+ * @param outputBit Callback returning the value of output o, or -1 if undefined
+ * @param nOutputs Number of outputs
+ */
+template <typename OutputBit>
+inline void appendResultRow(string &text, const char *inputs, size_t nInputs,
+                            const OutputBit &outputBit, size_t nOutputs) {
+    for (size_t i = 0; i < nInputs; i++) text.push_back(static_cast<char>('0' + inputs[i]));
+    text.push_back(' ');
+    for (size_t o = 0; o < nOutputs; o++) {
+        int bit = outputBit(o);
+        text.push_back(bit < 0 ? '-' : static_cast<char>('0' + bit));
+    }
+    text.push_back('\n');
+}
+
+ResultFormat outputResultFormat(const CompiledCircuit &c, ResultMode mode) {
+    ResultFormat format;
+    format.mode = mode;
+    format.nets.assign(c.primaryOutputIds.begin(), c.primaryOutputIds.end());
+    for (size_t o = 0; o < c.primaryOutputIds.size(); o++) format.names.emplace_back(c.outputName(o));
+    return format;
+}
+
+/**
+ * @brief Appends the result of one vector in a FULL, OUTPUTS, HEX or BINARY format
+ * @param text Destination
+ * @param format Result format
+ * @param inputs Input values (0/1 bytes)
+ * @param nInputs Number of inputs
+ * @param netBit Callback returning the value of reported net k, or -1 if undefined
+ * 
+ * HEX and BINARY read the bits as one number, the first net most
+ * significant, with leading zero padding to whole digits or bytes;
+ * undefined nets count as 0 there.
+ */
+template <typename NetBit>
+inline void appendResult(string &text, const ResultFormat &format, const char *inputs, size_t nInputs,
+                         const NetBit &netBit) {
+    const size_t n = format.nets.size();
+    switch (format.mode) {
+        case ResultMode::FULL:
+            appendResultRow(text, inputs, nInputs, netBit, n);
+            break;
+        case ResultMode::OUTPUTS:
+            for (size_t k = 0; k < n; k++) {
+                int bit = netBit(k);
+                text.push_back(bit < 0 ? '-' : static_cast<char>('0' + bit));
+            }
+            text.push_back('\n');
+            break;
+        case ResultMode::HEX:
+        case ResultMode::BINARY: {
+            // The bits form one number, padded with leading zeros to whole digits or bytes
+            const size_t groupBits = (format.mode == ResultMode::HEX) ? 4 : 8;
+            const size_t padded = (n + groupBits - 1) / groupBits * groupBits;
+            for (size_t first = 0; first < padded; first += groupBits) {
+                unsigned value = 0;
+                for (size_t b = first; b < first + groupBits; b++) {
+                    size_t k = b - (padded - n);  // Wraps around for the padding bits
+                    value = (value << 1) | (k < n && netBit(k) == 1 ? 1 : 0);
+                }
+                text.push_back(groupBits == 4 ? "0123456789abcdef"[value] : static_cast<char>(value));
+            }
+            if (format.mode == ResultMode::HEX) text.push_back('\n');
+            break;
+        }
+        case ResultMode::SUMMARY:
+            break;
+    }
+}
+
+/**
+ * @brief Simulates a run of vectors and formats their results
+ * @param c Levelized circuit
+ * @param s Simulation state owned by the calling thread
+ * @param engine Engine to use
+ * @param vectors Input values, nInputs 0/1 bytes per vector
+ * @param count Number of vectors
+ * @param text Receives the results (cleared first)
+ * @param format What to report for each vector
+ * @param ones Per-net counts of ones, added to in SUMMARY mode (one per reported net)
+ * @param levelSim Level-parallel simulator for the LEVEL engine
+ * @param native Compiled sweep for the JIT engine
+ * @param design Hierarchical design for the PACKED engine (c is its top-level body)
+ * @param hook Called for every vector, in order, once its values are final
+ * @param tables Cone tables for the SCALAR engine (only the reported nets are then valid)
+ */
+void simulateVectors(const CompiledCircuit &c, SimState &s, BatchEngine engine,
+                     const char *vectors, size_t count, string &text,
+                     const ResultFormat &format, uint64_t *ones,
+                     LevelParallelSimulator *levelSim = nullptr, const NativeSweep *native = nullptr,
+                     const CompiledDesign *design = nullptr, const SampleHook &hook = nullptr,
+                     const ConeTables *tables = nullptr) {
+    const size_t nInputs = c.primaryInputIds.size();
+    const size_t nNets = format.nets.size();
+    const bool summary = (format.mode == ResultMode::SUMMARY);
+    text.clear();
+    
+    if (engine == BatchEngine::PACKED || engine == BatchEngine::JIT) {
+        const size_t k = s.packedWordsPerNet;
+        const size_t lanes = s.packedLanes();
+        
+        for (size_t first = 0; first < count; first += lanes) {
+            const size_t n = min(lanes, count - first);
+            const char *block = vectors + first * nInputs;
+            
+            for (size_t i = 0; i < nInputs; i++) {
+                uint64_t *words = &s.netWords[c.primaryInputIds[i] * k];
+                fill(words, words + k, 0);
+                for (size_t p = 0; p < n; p++) {
+                    words[p / 64] |= static_cast<uint64_t>(block[p * nInputs + i]) << (p % 64);
+                }
+            }
+            if (design) {
+                sweepModule(*design, design->modules.size() - 1, s.netWords.data());
+            } else if (native) {
+                native->sweep(s.netWords.data());
+                PROFILE(s.profile.sweeps++);
+            } else {
+                simulatePacked(c, s);
+            }
+            if (hook) {
+                for (size_t p = 0; p < n; p++) hook(s, static_cast<int>(p));
+            }
+            
+            if (summary) {
+                // Whole words at once; lanes past the last vector are masked off
+                for (size_t o = 0; o < nNets; o++) {
+                    if (format.nets[o] < 0) continue;
+                    const uint64_t *words = &s.netWords[format.nets[o] * k];
+                    for (size_t w = 0; w * 64 < n; w++) {
+                        uint64_t mask = (n - w * 64 >= 64) ? ~0ULL : ((1ULL << (n - w * 64)) - 1);
+                        ones[o] += static_cast<uint64_t>(__builtin_popcountll(words[w] & mask));
+                    }
+                }
+                continue;
+            }
+            for (size_t p = 0; p < n; p++) {
+                appendResult(text, format, block + p * nInputs, nInputs, [&](size_t o) {
+                    int id = format.nets[o];
+                    return id < 0 ? -1 : static_cast<int>((s.netWords[id * k + p / 64] >> (p % 64)) & 1);
+                });
+            }
+        }
+        return;
+    }
+    
+    for (size_t v = 0; v < count; v++) {
+        const char *bits = vectors + v * nInputs;
+        if (engine == BatchEngine::EVENT) {
+            for (size_t i = 0; i < nInputs; i++) setInputValue(c, s, c.primaryInputIds[i], bits[i]);
+            simulateEventDriven(c, s);
+        } else {
+            for (size_t i = 0; i < nInputs; i++) s.netValues[c.primaryInputIds[i]] = bits[i];
+            if (engine == BatchEngine::LEVEL) levelSim->simulate(s);
+            else if (tables) tables->simulate(c, s);
+            else simulate(c, s);
+        }
+        if (hook) hook(s, -1);
+        if (summary) {
+            for (size_t o = 0; o < nNets; o++) {
+                if (format.nets[o] >= 0) ones[o] += static_cast<uint64_t>(s.netValues[format.nets[o]]);
+            }
+            continue;
+        }
+        appendResult(text, format, bits, nInputs, [&](size_t o) {
+            int id = format.nets[o];
+            return id < 0 ? -1 : s.netValues[id];
+        });
+    }
+}
+
+#ifdef CIRCUIT_PROFILE
+
+/// Entries listed in each section of printSimProfile()
+const size_t PROFILE_TOP_ENTRIES = 10;
+
+/**
+ * @brief Adds the counters of one simulation state to another
+ * @param into Accumulated profile (sized for the same circuit)
+ * @param from Profile to add
+ */
+void mergeSimProfile(SimProfile &into, const SimProfile &from) {
+    into.sweeps += from.sweeps;
+    for (size_t op = 0; op < GATE_OP_COUNT; op++) into.opEvaluations[op] += from.opEvaluations[op];
+    for (size_t l = 0; l < into.levelEvaluations.size(); l++) {
+        into.levelEvaluations[l] += from.levelEvaluations[l];
+        into.levelChanges[l] += from.levelChanges[l];
+    }
+    for (size_t id = 0; id < into.netToggles.size(); id++) into.netToggles[id] += from.netToggles[id];
+}
+
+void printSimProfile(const CompiledCircuit &c, const SimProfile &p) {
+    uint64_t opGates[GATE_OP_COUNT] = {};
+    for (size_t g = 0; g < c.gateCount(); g++) opGates[static_cast<size_t>(c.gateOps[g])]++;
+    
+    uint64_t opTotals[GATE_OP_COUNT];
+    uint64_t total = 0;
+    for (size_t op = 0; op < GATE_OP_COUNT; op++) {
+        opTotals[op] = p.sweeps * opGates[op] + p.opEvaluations[op];
+        total += opTotals[op];
+    }
+    
+    fprintf(stderr, "=== Simulation profile ===\n");
+    fprintf(stderr, "Full sweeps: %llu; gate evaluations: %llu\n",
+            static_cast<unsigned long long>(p.sweeps), static_cast<unsigned long long>(total));
+    
+    fprintf(stderr, "Gate evaluations by type:\n");
+    for (size_t op = 0; op < GATE_OP_COUNT; op++) {
+        if (opTotals[op] == 0) continue;
+        fprintf(stderr, "  %-7s %14llu  %5.1f%%\n", gateOpName(static_cast<GateOp>(op)),
+                static_cast<unsigned long long>(opTotals[op]), 100.0 * opTotals[op] / total);
+    }
+    
+    // Levels ranked by evaluations, the deepest first among equals
+    vector<uint64_t> levelTotals(c.levelCount());
+    vector<size_t> levels(c.levelCount());
+    for (size_t l = 0; l < c.levelCount(); l++) {
+        levelTotals[l] = p.sweeps * (c.levelOffsets[l + 1] - c.levelOffsets[l]) + p.levelEvaluations[l];
+        levels[l] = l;
+    }
+    size_t shown = min(PROFILE_TOP_ENTRIES, levels.size());
+    partial_sort(levels.begin(), levels.begin() + shown, levels.end(), [&](size_t a, size_t b) {
+        return levelTotals[a] != levelTotals[b] ? levelTotals[a] > levelTotals[b] : a > b;
+    });
+    fprintf(stderr, "Busiest levels:\n");
+    for (size_t k = 0; k < shown; k++) {
+        size_t l = levels[k];
+        fprintf(stderr, "  level %-5zu %8u gates %14llu evaluations %12llu output changes\n", l,
+                c.levelOffsets[l + 1] - c.levelOffsets[l], static_cast<unsigned long long>(levelTotals[l]),
+                static_cast<unsigned long long>(p.levelChanges[l]));
+    }
+    
+    // Nets ranked by fanout, the most active first among equals
+    vector<int> nets(c.netCount());
+    for (size_t id = 0; id < nets.size(); id++) nets[id] = static_cast<int>(id);
+    auto fanout = [&](int id) { return c.fanoutOffsets[id + 1] - c.fanoutOffsets[id]; };
+    shown = min(PROFILE_TOP_ENTRIES, nets.size());
+    partial_sort(nets.begin(), nets.begin() + shown, nets.end(), [&](int a, int b) {
+        return fanout(a) != fanout(b) ? fanout(a) > fanout(b) : p.netToggles[a] > p.netToggles[b];
+    });
+    fprintf(stderr, "Highest-fanout nets:\n");
+    for (size_t k = 0; k < shown; k++) {
+        int id = nets[k];
+        string_view name = c.netName(id);
+        fprintf(stderr, "  %-20.*s fanout %8u toggles %12llu\n", static_cast<int>(name.size()), name.data(),
+                fanout(id), static_cast<unsigned long long>(p.netToggles[id]));
+    }
+}
+
+#endif
+
+bool runBatch(const CompiledCircuit &c, const string &vectorPath, OutputBuffer &out,
+              BatchEngine engine, PackedKernel kernel, size_t threads, const ResultFormat &format,
+              const CompiledDesign *design, const SampleHook &hook,
+              bool binaryInput, size_t coneSupport) {
+    FILE *file = (vectorPath == "-") ? stdin : fopen(vectorPath.c_str(), "rb");
+    if (!file) {
+        cerr << "❌ Error: Could not open vector file '" << vectorPath << "'.\n";
+        return false;
+    }
+    
+    // LEVEL parallelizes inside each vector, so its vectors run in sequence
+    unique_ptr<LevelParallelSimulator> levelSim;
+    if (engine == BatchEngine::LEVEL) {
+        levelSim.reset(new LevelParallelSimulator(c, threads));
+        threads = 1;
+    }
+    
+    unique_ptr<NativeSweep> native;
+    if (engine == BatchEngine::JIT) {
+        native.reset(new NativeSweep());
+        string error;
+        if (!packedKernelSupported(kernel)) kernel = PackedKernel::SCALAR;
+        // Internal nets live in registers unless they are reported or dumped
+        bool storeAllNets = static_cast<bool>(hook);
+        for (int id : format.nets) {
+            if (id >= 0 && find(c.primaryOutputIds.begin(), c.primaryOutputIds.end(), id) ==
+                           c.primaryOutputIds.end()) storeAllNets = true;
+        }
+        if (!native->load(c, kernel, error, storeAllNets)) {
+            cerr << "⚠ JIT unavailable (" << error << "); using the packed engine.\n";
+            native.reset();
+            engine = BatchEngine::PACKED;
+        } else if (native->compileTime().count() > 0) {
+            cerr << "✓ JIT: compiled " << c.gateCount() << " gates in " << native->compileTime().count() << " ms\n";
+        }
+    }
+    
+    // A hook may read any net, so only hookless runs skip gates
+    unique_ptr<ConeTables> tables;
+    if (engine == BatchEngine::SCALAR && !hook && coneSupport > 0) {
+        tables.reset(new ConeTables(c, format.nets, coneSupport));
+        if (tables->tableCount() == 0) tables.reset();
+    }
+    
+    if (design) kernel = PackedKernel::SCALAR;
+    ThreadPool pool(max<size_t>(threads, 1));
+    vector<SimState> states(pool.size());
+    for (auto &s : states) {
+        initSimState(c, s, kernel);
+        if (design) s.netWords.assign(design->slotCount, 0);
+    }
+    
+    // A chunk gives every worker several tasks, so uneven tasks still balance
+    const size_t nInputs = c.primaryInputIds.size();
+    const bool packed = (engine == BatchEngine::PACKED || engine == BatchEngine::JIT);
+    const size_t taskVectors = packed ? states[0].packedLanes() : SCALAR_TASK_VECTORS;
+    const size_t chunkVectors = taskVectors * max<size_t>(pool.size() * 4, PIPELINE_CHUNK_TASKS);
+    size_t totalVectors = 0;
+    vector<string> taskText[2];   // Filled by the simulator and drained by the writer in turn
+    vector<vector<uint64_t>> ones(pool.size(), vector<uint64_t>(format.nets.size(), 0));
+    
+    // Parsing the next chunk, simulating this one and writing the results of
+    // the previous one overlap. Vectors before a bad one are still reported.
+    bool ok;
+    {
+        VectorReader reader(file, vectorPath, nInputs, chunkVectors, binaryInput);
+        ResultWriter writer(out);
+        for (size_t side = 0; ; side ^= 1) {
+            const VectorChunk &chunk = reader.next();
+            const size_t tasks = (chunk.count + taskVectors - 1) / taskVectors;
+            vector<string> &text = taskText[side];
+            if (text.size() < tasks) text.resize(tasks);
+            pool.parallelFor(tasks, [&](size_t t, size_t worker) {
+                const size_t first = t * taskVectors;
+                simulateVectors(c, states[worker], engine, chunk.bits.data() + first * nInputs,
+                                min(taskVectors, chunk.count - first), text[t], format, ones[worker].data(),
+                                levelSim.get(), native.get(), design, hook, tables.get());
+            });
+            totalVectors += chunk.count;
+            const bool last = chunk.last;
+            reader.release();
+            writer.submit(text, tasks);
+            if (last) break;
+        }
+        writer.finish();
+        ok = !reader.failed();
+    }
+    
+    if (file != stdin) fclose(file);
+    
+    if (tables) {
+        // Fixed when the tables are built: every vector looks up each tabled net once
+        vector<int32_t> reported(format.nets);
+        sort(reported.begin(), reported.end());
+        reported.erase(unique(reported.begin(), reported.end()), reported.end());
+        reported.erase(remove(reported.begin(), reported.end(), -1), reported.end());
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "✓ Cone tables: %zu of %zu reported nets, %zu of %zu gates skipped, %.1f KB; "
+                 "tabled share of reported nets %.2f%%\n",
+                 tables->tableCount(), reported.size(), c.gateCount() - tables->gates().size(), c.gateCount(),
+                 tables->bytes() / 1024.0, 100.0 * tables->tableCount() / reported.size());
+        cerr << line;
+    }
+    
+    if (format.mode == ResultMode::SUMMARY) {
+        string text = "# Vectors: " + to_string(totalVectors) + "\n";
+        char line[64];
+        for (size_t o = 0; o < format.nets.size(); o++) {
+            uint64_t total = 0;
+            for (const auto &counts : ones) total += counts[o];
+            if (format.nets[o] < 0) {
+                text += format.names[o] + " undefined\n";
+                continue;
+            }
+            snprintf(line, sizeof(line), " %llu (%.2f%%)\n", static_cast<unsigned long long>(total),
+                     totalVectors ? 100.0 * total / totalVectors : 0.0);
+            text += format.names[o] + line;
+        }
+        out.appendLines(text);
+    }
+    
+#ifdef CIRCUIT_PROFILE
+    for (size_t w = 1; w < states.size(); w++) mergeSimProfile(states[0].profile, states[w].profile);
+    printSimProfile(c, states[0].profile);
+#endif
+    return ok;
+}
+
+uint64_t writeTruthTable(const CompiledCircuit &c, SimState &s, OutputBuffer &out) {
+    const size_t nInputs = c.primaryInputIds.size();
+    const size_t nOutputs = c.primaryOutputIds.size();
+    const uint64_t nRows = 1ULL << nInputs;
+    
+    string header = "#";
+    for (int id : c.primaryInputIds) (header += " ") += c.netName(id);
+    header += " |";
+    for (size_t o = 0; o < nOutputs; o++) (header += " ") += c.outputName(o);
+    out.appendLines(header + "\n");
+    
+    // Row 0 is all zeros; every later row flips the input at the lowest set bit of its index
+    vector<char> row(nInputs, 0);
+    for (int id : c.primaryInputIds) setInputValue(c, s, id, 0);
+    
+    string text;
+    for (uint64_t r = 0; r < nRows; r++) {
+        if (r > 0) {
+            size_t flip = nInputs - 1 - static_cast<size_t>(__builtin_ctzll(r));
+            row[flip] ^= 1;
+            setInputValue(c, s, c.primaryInputIds[flip], row[flip]);
+        }
+        simulateEventDriven(c, s);
+        
+        appendResultRow(text, row.data(), nInputs, [&](size_t o) {
+            int id = c.primaryOutputIds[o];
+            return id < 0 ? -1 : s.netValues[id];
+        }, nOutputs);
+        if (text.size() >= OutputBuffer::FLUSH_SIZE / 4) {
+            out.appendLines(text);
+            text.clear();
+        }
+    }
+    out.appendLines(text);
+    return nRows;
+}
+
+/// Faulty machines per simulation pass; lane 0 of every word is the fault-free machine
+const size_t FAULTS_PER_PASS = 63;
+
+vector<StuckAtFault> enumerateStuckAtFaults(const CompiledCircuit &c) {
+    vector<char> driven(c.netCount(), 0);
+    for (int id : c.primaryInputIds) driven[id] = 1;
+    for (size_t g = 0; g < c.gateCount(); g++) driven[c.gateOutputs[g]] = 1;
+    
+    vector<StuckAtFault> faults;
+    for (size_t id = 0; id < driven.size(); id++) {
+        if (!driven[id]) continue;
+        faults.push_back({static_cast<int>(id), 0});
+        faults.push_back({static_cast<int>(id), 1});
+    }
+    return faults;
+}
+
+/**
+ * @struct FaultSimBuffers
+ * @brief Per-thread net words and cone lists of the parallel-fault simulator
+ */
+struct FaultSimBuffers {
+    vector<uint64_t> values;     ///< Net values, one machine per bit
+    vector<uint64_t> good;       ///< Fault-free net values, one vector per bit (64-vector block)
+    vector<uint64_t> forceOne;   ///< Lanes whose machine holds the net at 1
+    vector<uint64_t> forceZero;  ///< Lanes whose machine holds the net at 0
+    vector<char> inCone;         ///< Nets a fault of the current pass can reach
+    vector<int> coneGates;       ///< Gates driving cone nets, in level order
+    vector<int> boundary;        ///< Nets outside the cone read by cone gates
+    vector<int> coneOutputs;     ///< Primary output nets inside the cone
+};
+
+/**
+ * @brief Grades up to FAULTS_PER_PASS faults against a vector set
+ * @param c Levelized circuit
+ * @param faults Faults to grade; detectedBy is set for every detected one
+ * @param count Number of faults (at most FAULTS_PER_PASS)
+ * @param vectors Input values, nInputs 0/1 bytes per vector
+ * @param nVectors Number of vectors
+ * @param observable Nets with a path to a primary output (see gradeStuckAtFaults())
+ * @param b Buffers sized for the circuit; forceOne, forceZero and inCone are left all zero
+ * 
+ * Bit 0 of every net word simulates the fault-free circuit and bit k + 1
+ * the circuit with faults[k] injected: after every gate (and primary
+ * input) the force masks pin the faulty lanes. Only the fanout cone of
+ * the faults is simulated this way; every other net carries its
+ * fault-free value, which a packed sweep computes for 64 vectors at a
+ * time. A fault is detected when any primary output differs from the
+ * fault-free lane. Detected faults are dropped, and the pass ends once
+ * every fault is detected.
+ */
+void gradeFaultGroup(const CompiledCircuit &c, StuckAtFault *faults, size_t count,
+                     const char *vectors, size_t nVectors, const vector<char> &observable,
+                     FaultSimBuffers &b) {
+    uint64_t *v = b.values.data();
+    uint64_t *good = b.good.data();
+    uint64_t *one = b.forceOne.data();
+    uint64_t *zero = b.forceZero.data();
+    char *inCone = b.inCone.data();
+    for (size_t k = 0; k < count; k++) {
+        (faults[k].value ? one : zero)[faults[k].net] |= 1ULL << (k + 1);
+        inCone[faults[k].net] = 1;
+    }
+    
+    // Gates are level-ordered, so one ascending pass finds the whole cone
+    const GateOp *ops = c.gateOps.data();
+    const int32_t *outputs = c.gateOutputs.data();
+    const uint32_t *offsets = c.faninOffsets.data();
+    const int32_t *fanins = c.fanins.data();
+    b.coneGates.clear();
+    for (size_t g = 0; g < c.gateCount(); g++) {
+        if (!observable[outputs[g]]) continue;
+        bool reached = inCone[outputs[g]];
+        for (uint32_t k = offsets[g]; k < offsets[g + 1] && !reached; k++) reached = inCone[fanins[k]];
+        if (!reached) continue;
+        inCone[outputs[g]] = 1;
+        b.coneGates.push_back(static_cast<int>(g));
+    }
+    
+    // Nets the cone reads from outside, each listed once
+    vector<char> &listed = b.inCone;
+    b.boundary.clear();
+    for (int g : b.coneGates) {
+        for (uint32_t k = offsets[g]; k < offsets[g + 1]; k++) {
+            int id = fanins[k];
+            if (!listed[id]) {
+                listed[id] = 2;
+                b.boundary.push_back(id);
+            }
+        }
+    }
+    for (size_t i = 0; i < c.primaryInputIds.size(); i++) {
+        int id = c.primaryInputIds[i];
+        if (listed[id] == 1) b.boundary.push_back(id);  // Faulty input: forced below
+    }
+    b.coneOutputs.clear();
+    for (int id : c.primaryOutputIds) {
+        if (id >= 0 && listed[id] == 1) b.coneOutputs.push_back(id);
+    }
+    
+    const size_t nInputs = c.primaryInputIds.size();
+    uint64_t active = (count == FAULTS_PER_PASS) ? ~1ULL : ((1ULL << (count + 1)) - 2);
+    if (b.coneOutputs.empty()) active = 0;  // No fault reaches an output
+    
+    for (size_t first = 0; first < nVectors && active != 0; first += 64) {
+        const size_t n = min<size_t>(64, nVectors - first);
+        const char *block = vectors + first * nInputs;
+        for (size_t i = 0; i < nInputs; i++) {
+            uint64_t w = 0;
+            for (size_t p = 0; p < n; p++) w |= static_cast<uint64_t>(block[p * nInputs + i]) << p;
+            good[c.primaryInputIds[i]] = w;
+        }
+        sweepGates(c, good);
+        
+        for (size_t p = 0; p < n && active != 0; p++) {
+            for (int id : b.boundary) {
+                v[id] = ((0 - ((good[id] >> p) & 1)) | one[id]) & ~zero[id];
+            }
+            for (int g : b.coneGates) {
+                int out = outputs[g];
+                uint64_t w;
+                applyGate(w, ops[g], v, fanins + offsets[g], static_cast<int>(offsets[g + 1] - offsets[g]));
+                v[out] = (w | one[out]) & ~zero[out];
+            }
+            
+            // Broadcast the fault-free lane and compare every machine with it
+            uint64_t differs = 0;
+            for (int id : b.coneOutputs) differs |= v[id] ^ (0 - (v[id] & 1));
+            for (uint64_t hit = differs & active; hit != 0; hit &= hit - 1) {
+                faults[__builtin_ctzll(hit) - 1].detectedBy = static_cast<int64_t>(first + p);
+            }
+            active &= ~differs;
+        }
+    }
+    
+    for (size_t k = 0; k < count; k++) one[faults[k].net] = zero[faults[k].net] = 0;
+    for (int g : b.coneGates) inCone[outputs[g]] = 0;
+    for (int id : b.boundary) inCone[id] = 0;
+    for (size_t k = 0; k < count; k++) inCone[faults[k].net] = 0;
+}
+
+void gradeStuckAtFaults(const CompiledCircuit &c, vector<StuckAtFault> &faults,
+                        const vector<char> &vectors, size_t nVectors, size_t threads) {
+    ThreadPool pool(max<size_t>(threads, 1));
+    vector<FaultSimBuffers> buffers(pool.size());
+    for (auto &b : buffers) {
+        b.values.assign(c.netCount(), 0);
+        b.good.assign(c.netCount(), 0);
+        b.inCone.assign(c.netCount(), 0);
+        b.forceOne.assign(c.netCount(), 0);
+        b.forceZero.assign(c.netCount(), 0);
+    }
+    
+    // Fanin always points to a lower level, so one descending pass suffices
+    vector<char> observable(c.netCount(), 0);
+    for (int id : c.primaryOutputIds) {
+        if (id >= 0) observable[id] = 1;
+    }
+    for (size_t g = c.gateCount(); g-- > 0;) {
+        if (!observable[c.gateOutputs[g]]) continue;
+        for (uint32_t k = c.faninOffsets[g]; k < c.faninOffsets[g + 1]; k++) observable[c.fanins[k]] = 1;
+    }
+    
+    vector<StuckAtFault> graded;
+    for (const auto &f : faults) {
+        if (observable[f.net]) graded.push_back(f);
+    }
+    
+    const size_t groups = (graded.size() + FAULTS_PER_PASS - 1) / FAULTS_PER_PASS;
+    pool.parallelFor(groups, [&](size_t group, size_t worker) {
+        const size_t first = group * FAULTS_PER_PASS;
+        gradeFaultGroup(c, graded.data() + first, min(FAULTS_PER_PASS, graded.size() - first),
+                        vectors.data(), nVectors, observable, buffers[worker]);
+    });
+    
+    // Copy the results back in the original fault order
+    size_t next = 0;
+    for (auto &f : faults) {
+        if (observable[f.net]) f = graded[next++];
+    }
+}
+
+bool loadVectorFile(const string &path, size_t nInputs, vector<char> &vectors,
+                    vector<size_t> *streamStarts) {
+    FILE *file = (path == "-") ? stdin : fopen(path.c_str(), "rb");
+    if (!file) {
+        cerr << "❌ Error: Could not open vector file '" << path << "'.\n";
+        return false;
+    }
+    
+    LineReader reader(file);
+    const char *data;
+    size_t length;
+    size_t lineNumber = 0;
+    vector<char> bits;
+    size_t count = 0;
+    bool ok = true;
+    if (streamStarts) streamStarts->assign(1, 0);
+    while (reader.next(data, length)) {
+        lineNumber++;
+        VectorLineKind kind = classifyVectorLine(data, length);
+        if (kind == VectorLineKind::SKIP) continue;
+        if (kind == VectorLineKind::END) break;
+        if (kind == VectorLineKind::STREAM && streamStarts) {
+            if (streamStarts->back() != count) streamStarts->push_back(count);  // Empty streams are dropped
+            continue;
+        }
+        
+        if (!parseVectorLine(data, length, bits) || bits.size() != nInputs) {
+            cerr << "❌ Error: " << path << ":" << lineNumber << ": expected "
+                 << nInputs << " input values (0 or 1).\n";
+            ok = false;
+            break;
+        }
+        vectors.insert(vectors.end(), bits.begin(), bits.end());
+        count++;
+    }
+    
+    if (file != stdin) fclose(file);
+    return ok;
+}
+
+void writeFaultReport(const CompiledCircuit &c, const vector<StuckAtFault> &faults,
+                      size_t nVectors, OutputBuffer &out) {
+    size_t detected = 0;
+    for (const auto &f : faults) detected += (f.detectedBy >= 0);
+    const double coverage = faults.empty() ? 100.0 : 100.0 * detected / faults.size();
+    
+    char line[160];
+    string text;
+    snprintf(line, sizeof(line), "# Stuck-at faults: %zu, vectors: %zu\n", faults.size(), nVectors);
+    text += line;
+    snprintf(line, sizeof(line), "# Detected: %zu (%.2f%% coverage)\n", detected, coverage);
+    text += line;
+    snprintf(line, sizeof(line), "# Undetected: %zu\n", faults.size() - detected);
+    text += line;
+    for (const auto &f : faults) {
+        if (f.detectedBy >= 0) continue;
+        ((text += c.netName(f.net)) += (f.value ? " SA1" : " SA0")) += "\n";
+    }
+    out.appendLines(text);
+}
+
+bool parseDecimal(string_view token, long &value) {
+    if (token.empty() || token.size() > 9) return false;
+    value = 0;
+    for (char ch : token) {
+        if (ch < '0' || ch > '9') return false;
+        value = value * 10 + (ch - '0');
+    }
+    return true;
+}
+
+/// Default delay of each gate type in time units, indexed by GateOp: one
+/// for a single inverting stage, two for AND/OR (NAND/NOR plus an
+/// inverter), three for XOR/XNOR; constants never switch
+const uint32_t DEFAULT_GATE_DELAYS[] = {2, 2, 1, 1, 3, 3, 1, 1, 0, 0, 0, 0};
+
+/// Largest gate delay accepted by loadGateDelays() (the timing wheel has a bucket per unit)
+const uint32_t MAX_GATE_DELAY = 65535;
+
+bool loadGateDelays(const CompiledCircuit &c, const string &path, vector<uint32_t> &delays) {
+    uint32_t typeDelays[sizeof(DEFAULT_GATE_DELAYS) / sizeof(DEFAULT_GATE_DELAYS[0])];
+    copy(begin(DEFAULT_GATE_DELAYS), end(DEFAULT_GATE_DELAYS), typeDelays);
+    vector<pair<int, uint32_t>> netDelays;
+    
+    if (!path.empty()) {
+        ifstream file(path);
+        if (!file) {
+            cerr << "❌ Error: Could not open delay file '" << path << "'.\n";
+            return false;
+        }
+        string line;
+        for (size_t lineNo = 1; getline(file, line); lineNo++) {
+            stringstream words(line.substr(0, line.find('#')));
+            string name, value, extra;
+            if (!(words >> name)) continue;
+            long delay = 0;
+            if (!(words >> value) || (words >> extra) || !parseDecimal(value, delay) || delay < 1 ||
+                delay > static_cast<long>(MAX_GATE_DELAY)) {
+                cerr << "❌ Error: " << path << ":" << lineNo << ": expected 'TYPE|NET DELAY' with a delay from 1 to "
+                     << MAX_GATE_DELAY << ".\n";
+                return false;
+            }
+            GateOp op = parseGateOp(toUpper(name));
+            if (op != GateOp::INVALID && op != GateOp::DFF && op != GateOp::INST) {
+                typeDelays[static_cast<int>(op)] = static_cast<uint32_t>(delay);
+                continue;
+            }
+            int id = c.findNet(name);
+            if (id < 0) {
+                cerr << "❌ Error: " << path << ":" << lineNo << ": no gate type or net named '" << name << "'.\n";
+                return false;
+            }
+            netDelays.push_back({id, static_cast<uint32_t>(delay)});
+        }
+    }
+    
+    vector<int32_t> driver(c.netCount(), -1);
+    delays.resize(c.gateCount());
+    for (size_t g = 0; g < c.gateCount(); g++) {
+        delays[g] = typeDelays[static_cast<int>(c.gateOps[g])];
+        driver[c.gateOutputs[g]] = static_cast<int32_t>(g);
+    }
+    for (const auto &entry : netDelays) {
+        if (driver[entry.first] < 0) {
+            cerr << "❌ Error: " << path << ": net '" << c.netName(entry.first) << "' is not driven by a gate.\n";
+            return false;
+        }
+        delays[driver[entry.first]] = entry.second;
+    }
+    return true;
+}
+
+TimedSimulator::TimedSimulator(const CompiledCircuit &c, const vector<uint32_t> &delays)
+    : c(c), delays(delays),
+      wheel(delays.empty() ? 1 : *max_element(delays.begin(), delays.end())),
+      values(c.netCount(), 0), outputSlot(c.netCount(), -1), gateMarked(c.gateCount(), 0) {
+    for (size_t g = 0; g < c.gateCount(); g++) values[c.gateOutputs[g]] = evalGate(c, g, values.data());
+    projected = values;
+    
+    // Statistics are kept per net, so outputs sharing a net share them
+    for (size_t o = 0; o < c.primaryOutputIds.size(); o++) {
+        int id = c.primaryOutputIds[o];
+        if (id < 0 || outputSlot[id] >= 0) continue;
+        outputSlot[id] = static_cast<int32_t>(trackedNets.size());
+        trackedNets.push_back(id);
+    }
+    tracked.resize(trackedNets.size());
+    vectorTransitions.assign(trackedNets.size(), 0);
+    startValues.assign(trackedNets.size(), 0);
+    lastChange.assign(trackedNets.size(), 0);
+}
+
+uint64_t TimedSimulator::apply(const char *bits, uint64_t &glitches) {
+    for (size_t t = 0; t < trackedNets.size(); t++) {
+        vectorTransitions[t] = 0;
+        startValues[t] = values[trackedNets[t]];
+    }
+    wheel.reset();
+    for (size_t i = 0; i < c.primaryInputIds.size(); i++) {
+        const int id = c.primaryInputIds[i];
+        if (values[id] == bits[i]) continue;
+        projected[id] = bits[i];
+        change(id, bits[i], 0);
+    }
+    evaluateMarked(0);
+    while (!wheel.empty()) {
+        const uint64_t at = wheel.next(current);
+        for (const auto &e : current) change(e.net, e.value, at);
+        evaluateMarked(at);
+        eventCount += current.size();
+    }
+    
+    uint64_t settle = 0;
+    glitches = 0;
+    for (size_t t = 0; t < trackedNets.size(); t++) {
+        if (vectorTransitions[t] == 0) continue;
+        const uint64_t needed = (values[trackedNets[t]] != startValues[t]);
+        const uint64_t pulses = (vectorTransitions[t] - needed) / 2;
+        OutputTiming &stats = tracked[t];
+        stats.settle = max(stats.settle, lastChange[t]);
+        stats.transitions += vectorTransitions[t];
+        stats.glitches += pulses;
+        stats.glitchyVectors += (pulses > 0);
+        settle = max(settle, lastChange[t]);
+        glitches += pulses;
+    }
+    return settle;
+}
+
+void TimedSimulator::change(int id, int value, uint64_t at) {
+    values[id] = value;
+    if (outputSlot[id] >= 0) {
+        vectorTransitions[outputSlot[id]]++;
+        lastChange[outputSlot[id]] = at;
+    }
+    for (uint32_t k = c.fanoutOffsets[id]; k < c.fanoutOffsets[id + 1]; k++) {
+        const uint32_t g = c.fanoutGates[k];
+        if (!gateMarked[g]) {
+            gateMarked[g] = 1;
+            marked.push_back(g);
+        }
+    }
+}
+
+void TimedSimulator::evaluateMarked(uint64_t at) {
+    for (uint32_t g : marked) {
+        gateMarked[g] = 0;
+        const int out = c.gateOutputs[g];
+        const int v = evalGate(c, g, values.data());
+        if (v == projected[out]) continue;
+        projected[out] = v;
+        wheel.schedule(at + delays[g], out, v);
+    }
+    marked.clear();
+}
+
+uint64_t criticalPathDelay(const CompiledCircuit &c, const vector<uint32_t> &delays) {
+    vector<uint64_t> arrival(c.netCount(), 0);
+    for (size_t g = 0; g < c.gateCount(); g++) {
+        // Constant drivers never switch
+        if (c.gateInputCount(g) == 0) continue;
+        uint64_t latest = 0;
+        for (uint32_t j = 0; j < c.gateInputCount(g); j++) latest = max(latest, arrival[c.gateInputs(g)[j]]);
+        arrival[c.gateOutputs[g]] = latest + delays[g];
+    }
+    uint64_t critical = 0;
+    for (int id : c.primaryOutputIds) {
+        if (id >= 0) critical = max(critical, arrival[id]);
+    }
+    return critical;
+}
+
+PackedKernel streamKernel(size_t streams) {
+    PackedKernel widest = PackedKernel::SCALAR;
+    for (size_t i = 0; i < sizeof(PACKED_KERNELS) / sizeof(PACKED_KERNELS[0]); i++) {
+        PackedKernel kernel = static_cast<PackedKernel>(i);
+        if (!packedKernelSupported(kernel)) continue;
+        widest = kernel;
+        if (PACKED_KERNELS[i].lanes >= streams) break;
+    }
+    return widest;
+}
+
+void simulateStreams(const CompiledCircuit &c, const vector<char> &vectors, const vector<size_t> &streamStarts,
+                     size_t nVectors, uint64_t cycles, PackedKernel kernel, size_t threads, OutputBuffer &out,
+                     const SampleHook &hook, size_t hookStream) {
+    const size_t nInputs = c.primaryInputIds.size();
+    const size_t nFlops = c.flopCount();
+    const size_t nOutputs = c.primaryOutputIds.size();
+    const size_t nStreams = streamStarts.size();
+    
+    ThreadPool pool(max<size_t>(threads, 1));
+    vector<SimState> states(pool.size());
+    for (auto &s : states) initSimState(c, s, kernel);
+    const size_t k = states[0].packedWordsPerNet;
+    const size_t lanes = states[0].packedLanes();
+    const size_t blocks = (nStreams + lanes - 1) / lanes;
+    
+    vector<string> blockText(blocks);
+    pool.parallelFor(blocks, [&](size_t block, size_t worker) {
+        SimState &s = states[worker];
+        const size_t first = block * lanes;
+        const size_t n = min(lanes, nStreams - first);
+        auto streamBegin = [&](size_t p) { return streamStarts[first + p]; };
+        auto streamEnd = [&](size_t p) { return first + p + 1 < nStreams ? streamStarts[first + p + 1] : nVectors; };
+        
+        // Pack the block's inputs: cycle t, input i, word w
+        size_t stimulusCycles = 0;
+        for (size_t p = 0; p < n; p++) stimulusCycles = max(stimulusCycles, streamEnd(p) - streamBegin(p));
+        stimulusCycles = static_cast<size_t>(min<uint64_t>(stimulusCycles, cycles));
+        vector<uint64_t> stimulus(stimulusCycles * nInputs * k, 0);
+        for (size_t p = 0; p < n; p++) {
+            const size_t length = streamEnd(p) - streamBegin(p);
+            for (size_t t = 0; t < stimulusCycles; t++) {
+                const char *bits = vectors.data() + (streamBegin(p) + min(t, length - 1)) * nInputs;
+                uint64_t *words = stimulus.data() + t * nInputs * k + p / 64;
+                for (size_t i = 0; i < nInputs; i++) {
+                    words[i * k] |= static_cast<uint64_t>(bits[i]) << (p % 64);
+                }
+            }
+        }
+        
+        const bool observed = hook && hookStream >= first && hookStream < first + n;
+        runCycles(c, s, stimulus.data(), stimulusCycles, cycles, observed ? hook : nullptr,
+                  static_cast<int>(hookStream - first));
+        
+        vector<char> state(nFlops);
+        string &text = blockText[block];
+        for (size_t p = 0; p < n; p++) {
+            auto bit = [&](int id) { return static_cast<int>((s.netWords[id * k + p / 64] >> (p % 64)) & 1); };
+            for (size_t f = 0; f < nFlops; f++) state[f] = static_cast<char>(bit(c.flopOutputs[f]));
+            appendResultRow(text, state.data(), nFlops, [&](size_t o) {
+                int id = c.primaryOutputIds[o];
+                return id < 0 ? -1 : bit(id);
+            }, nOutputs);
+        }
+    });
+    
+    string header = "#";
+    for (int id : c.flopOutputs) (header += " ") += c.netName(id);
+    header += " |";
+    for (size_t o = 0; o < nOutputs; o++) (header += " ") += c.outputName(o);
+    out.appendLines(header + "\n");
+    for (const auto &text : blockText) out.appendLines(text);
+}
+
+/// Binary netlist file identification
+const char BINARY_MAGIC[8] = {'D', 'C', 'S', 'I', 'M', 'B', 'I', 'N'};
+
+const uint32_t BINARY_VERSION = 3;                ///< 3: flip-flop sections
+
+const uint32_t BINARY_BYTE_ORDER = 0x01020304;  ///< Reads back byte-swapped on a foreign-endian host
+
+const size_t BINARY_ALIGNMENT = CircuitArena::ALIGNMENT;  ///< Section alignment (the in-memory arena layout)
+
+/**
+ * @enum BinarySectionId
+ * @brief Arrays stored in a binary netlist, one section each
+ */
+enum BinarySectionId {
+    SECTION_GATE_OPS, SECTION_GATE_OUTPUTS, SECTION_FANIN_OFFSETS, SECTION_FANINS,
+    SECTION_GATE_LEVELS, SECTION_LEVEL_OFFSETS, SECTION_FANOUT_OFFSETS,
+    SECTION_FANOUT_GATES, SECTION_FLOP_OUTPUTS, SECTION_FLOP_INPUTS, SECTION_FLOP_RESET_VALUES,
+    SECTION_PRIMARY_INPUTS, SECTION_PRIMARY_OUTPUTS,
+    SECTION_OUTPUT_NAMES, SECTION_NETS_BY_NAME, SECTION_STRING_OFFSETS, SECTION_STRING_CHARS,
+    BINARY_SECTION_COUNT
+};
+
+/**
+ * @struct BinarySection
+ * @brief Location of one array in a binary netlist file
+ */
+struct BinarySection {
+    uint64_t offset;    ///< Byte offset from the start of the file (BINARY_ALIGNMENT aligned)
+    uint64_t count;     ///< Number of elements
+};
+
+/**
+ * @struct BinaryHeader
+ * @brief Header at the start of a binary netlist file
+ * 
+ * The file is the CompiledCircuit arrays written out as-is, so loading is
+ * a single mmap plus validation; nothing is parsed or copied.
+ */
+struct BinaryHeader {
+    char magic[8];              ///< BINARY_MAGIC
+    uint32_t version;           ///< BINARY_VERSION
+    uint32_t byteOrder;         ///< BINARY_BYTE_ORDER as written by the host
+    uint32_t netCount;          ///< Number of nets
+    uint32_t nameIndex;         ///< String index of the circuit name
+    uint64_t fileSize;          ///< Total file size in bytes
+    BinarySection sections[BINARY_SECTION_COUNT];
+};
+
+/**
+ * @brief Calls a visitor for every array of a compiled circuit, in section order
+ * @param c Circuit (const when writing, mutable when mapping)
+ * @param visit Called as visit(BinarySectionId, ArrayView<T> &)
+ */
+template <typename Circuit, typename Visitor>
+void forEachSection(Circuit &c, Visitor visit) {
+    visit(SECTION_GATE_OPS, c.gateOps);
+    visit(SECTION_GATE_OUTPUTS, c.gateOutputs);
+    visit(SECTION_FANIN_OFFSETS, c.faninOffsets);
+    visit(SECTION_FANINS, c.fanins);
+    visit(SECTION_GATE_LEVELS, c.gateLevels);
+    visit(SECTION_LEVEL_OFFSETS, c.levelOffsets);
+    visit(SECTION_FANOUT_OFFSETS, c.fanoutOffsets);
+    visit(SECTION_FANOUT_GATES, c.fanoutGates);
+    visit(SECTION_FLOP_OUTPUTS, c.flopOutputs);
+    visit(SECTION_FLOP_INPUTS, c.flopInputs);
+    visit(SECTION_FLOP_RESET_VALUES, c.flopResetValues);
+    visit(SECTION_PRIMARY_INPUTS, c.primaryInputIds);
+    visit(SECTION_PRIMARY_OUTPUTS, c.primaryOutputIds);
+    visit(SECTION_OUTPUT_NAMES, c.outputNameIds);
+    visit(SECTION_NETS_BY_NAME, c.netsByName);
+    visit(SECTION_STRING_OFFSETS, c.stringOffsets);
+    visit(SECTION_STRING_CHARS, c.stringChars);
+}
+
+bool writeBinaryCircuit(const CompiledCircuit &c, const string &path) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        cerr << "❌ Error: Could not create output file '" << path << "'.\n";
+        return false;
+    }
+    
+    BinaryHeader header = {};
+    memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+    header.version = BINARY_VERSION;
+    header.byteOrder = BINARY_BYTE_ORDER;
+    header.netCount = c.nets;
+    header.nameIndex = c.nameIndex;
+    
+    // The header is rewritten with the final offsets once the sections are out
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t offset = sizeof(header);
+    const char zeros[BINARY_ALIGNMENT] = {};
+    forEachSection(c, [&](BinarySectionId id, const auto &view) {
+        size_t padding = (BINARY_ALIGNMENT - offset % BINARY_ALIGNMENT) % BINARY_ALIGNMENT;
+        size_t bytes = view.size() * sizeof(view[0]);
+        ok = ok && fwrite(zeros, 1, padding, file) == padding;
+        offset += padding;
+        header.sections[id] = {offset, view.size()};
+        ok = ok && (bytes == 0 || fwrite(view.data(), bytes, 1, file) == 1);
+        offset += bytes;
+    });
+    header.fileSize = offset;
+    
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        cerr << "❌ Error: Could not write output file '" << path << "'.\n";
+    }
+    return ok;
+}
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a whole file
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+#else
+        if (bytes) munmap(const_cast<char *>(bytes), length);
+#endif
+    }
+    
+    /**
+     * @brief Maps a file
+     * @param path File path
+     * @return false if the file cannot be opened, is empty, or cannot be mapped
+     */
+    bool open(const string &path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            length = static_cast<size_t>(fileSize.QuadPart);
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        CloseHandle(file);
+        if (!mapping) return false;
+        bytes = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return bytes != nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            length = static_cast<size_t>(info.st_size);
+            void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) bytes = static_cast<const char *>(p);
+        }
+        ::close(fd);  // The mapping stays valid after the descriptor is closed
+        return bytes != nullptr;
+#endif
+    }
+    
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+    
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+};
+
+/**
+ * @brief Checks that a file starts with the binary netlist magic
+ * @param path File path
+ * @return true if the file looks like a binary netlist
+ */
+bool isBinaryCircuitFile(const string &path) {
+    char magic[sizeof(BINARY_MAGIC)];
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    bool match = fread(magic, sizeof(magic), 1, file) == 1 &&
+                 memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return match;
+}
+
+/**
+ * @brief Checks every index in a mapped circuit
+ * @param c Circuit whose views point into the mapping
+ * @return Description of the first problem found, or an empty string
+ * 
+ * The engines index arrays without bounds checks, so a corrupt or
+ * hand-edited file must be rejected here rather than crash later.
+ */
+string validateMappedCircuit(const CompiledCircuit &c) {
+    const size_t nets = c.nets;
+    const size_t nStrings = c.stringOffsets.size();
+    auto isNet = [nets](int64_t id) { return id >= 0 && static_cast<size_t>(id) < nets; };
+    
+    // String table: every string must end inside the table
+    if (nStrings < nets || c.nameIndex >= nStrings) return "string table too small";
+    if (!c.stringChars.empty() && c.stringChars.back() != '\0') return "unterminated string table";
+    for (uint32_t offset : c.stringOffsets) {
+        if (offset >= c.stringChars.size()) return "string offset out of range";
+    }
+    
+    // Levels: contiguous, ascending gate ranges covering every gate
+    const size_t nGates = c.gateCount();
+    if (c.gateOutputs.size() != nGates || c.gateLevels.size() != nGates) return "bad gate table";
+    if (c.levelOffsets.empty() != (nGates == 0)) return "bad level table";
+    if (!c.levelOffsets.empty() && (c.levelOffsets[0] != 0 || c.levelOffsets.back() != nGates)) {
+        return "bad level table";
+    }
+    for (size_t l = 1; l < c.levelOffsets.size(); l++) {
+        if (c.levelOffsets[l] < c.levelOffsets[l - 1]) return "bad level table";
+    }
+    
+    // Input ranges: ascending and inside the fanin array
+    if (c.faninOffsets.size() != nGates + 1 || c.faninOffsets[0] != 0 ||
+        c.faninOffsets.back() != c.fanins.size()) {
+        return "bad fanin table";
+    }
+    for (size_t i = 0; i < nGates; i++) {
+        if (c.faninOffsets[i + 1] < c.faninOffsets[i]) return "bad fanin table";
+    }
+    
+    // Gates: valid opcodes and nets, one driver per net, inputs from lower levels only
+    vector<int64_t> driverLevel(nets, -1);
+    for (size_t l = 0; l < c.levelCount(); l++) {
+        for (size_t i = c.levelOffsets[l]; i < c.levelOffsets[l + 1]; i++) {
+            GateOp op = c.gateOps[i];
+            int32_t out = c.gateOutputs[i];
+            if (op >= GateOp::DFF || c.gateLevels[i] != l || !isNet(out)) return "bad gate record";
+            const GateOpInfo &info = GATE_OPS[static_cast<int>(op)];
+            uint32_t inputCount = c.gateInputCount(i);
+            if (inputCount < static_cast<uint32_t>(info.inputs) ||
+                (!info.variadic && inputCount != static_cast<uint32_t>(info.inputs))) {
+                return "bad gate input count";
+            }
+            if (driverLevel[out] >= 0) return "net driven by more than one gate";
+            driverLevel[out] = l;
+        }
+    }
+    for (size_t i = 0; i < nGates; i++) {
+        const int32_t *in = c.gateInputs(i);
+        for (uint32_t j = 0; j < c.gateInputCount(i); j++) {
+            if (!isNet(in[j])) return "gate input net out of range";
+            if (driverLevel[in[j]] >= static_cast<int64_t>(c.gateLevels[i])) return "gates not in level order";
+        }
+    }
+    
+    // Fanout lists
+    if (c.fanoutOffsets.size() != nets + 1 || c.fanoutOffsets[0] != 0 ||
+        c.fanoutOffsets.back() != c.fanoutGates.size()) {
+        return "bad fanout table";
+    }
+    for (size_t id = 1; id <= nets; id++) {
+        if (c.fanoutOffsets[id] < c.fanoutOffsets[id - 1]) return "bad fanout table";
+    }
+    for (int32_t gi : c.fanoutGates) {
+        if (gi < 0 || static_cast<size_t>(gi) >= nGates) return "fanout gate out of range";
+    }
+    
+    // Flip-flops: each Q is a net no gate and no other flip-flop drives
+    const size_t nFlops = c.flopCount();
+    if (c.flopInputs.size() != nFlops || c.flopResetValues.size() != nFlops) return "bad flip-flop table";
+    for (size_t f = 0; f < nFlops; f++) {
+        int32_t q = c.flopOutputs[f];
+        if (!isNet(q) || !isNet(c.flopInputs[f]) || c.flopResetValues[f] > 1) return "bad flip-flop record";
+        if (driverLevel[q] != -1) return "flip-flop output driven twice";
+        driverLevel[q] = -2;
+    }
+    
+    // Primary I/O and name index
+    for (int32_t id : c.primaryInputIds) {
+        if (!isNet(id)) return "primary input out of range";
+        if (driverLevel[id] >= 0) return "gate drives a primary input";
+    }
+    if (c.outputNameIds.size() != c.primaryOutputIds.size()) return "bad primary output table";
+    for (size_t o = 0; o < c.primaryOutputIds.size(); o++) {
+        if (c.primaryOutputIds[o] != -1 && !isNet(c.primaryOutputIds[o])) return "primary output out of range";
+        if (c.outputNameIds[o] >= nStrings) return "primary output name out of range";
+    }
+    if (c.netsByName.size() != nets) return "bad net name index";
+    for (size_t i = 0; i < nets; i++) {
+        if (!isNet(c.netsByName[i])) return "bad net name index";
+        if (i > 0 && c.netName(c.netsByName[i]) < c.netName(c.netsByName[i - 1])) return "net name index not sorted";
+    }
+    return "";
+}
+
+/**
+ * @brief Maps a binary netlist written by writeBinaryCircuit()
+ * @param path Binary netlist path
+ * @param c Receives the circuit; its arrays point straight into the mapping
+ * @param error Receives the reason on failure
+ * @return true on success
+ */
+bool mapBinaryCircuit(const string &path, CompiledCircuit &c, string &error) {
+    auto file = make_shared<MappedFile>();
+    if (!file->open(path)) {
+        error = "Could not map binary netlist '" + path + "'.";
+        return false;
+    }
+    
+    auto fail = [&](const string &reason) {
+        error = path + ": invalid binary netlist (" + reason + ").";
+        return false;
+    };
+    
+    BinaryHeader header;
+    if (file->size() < sizeof(header)) return fail("truncated header");
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) != 0) return fail("bad magic");
+    if (header.byteOrder != BINARY_BYTE_ORDER) return fail("written on a host with different byte order");
+    if (header.version != BINARY_VERSION) return fail("unsupported version " + to_string(header.version));
+    if (header.fileSize != file->size()) return fail("file size mismatch");
+    
+    CompiledCircuit mapped;
+    mapped.nets = header.netCount;
+    mapped.nameIndex = header.nameIndex;
+    bool inBounds = true;
+    forEachSection(mapped, [&](BinarySectionId id, auto &view) {
+        using T = typename remove_reference_t<decltype(view)>::value_type;
+        const BinarySection &section = header.sections[id];
+        if (section.offset % BINARY_ALIGNMENT != 0 || section.offset > file->size() ||
+            section.count > (file->size() - section.offset) / sizeof(T)) {
+            inBounds = false;
+            return;
+        }
+        view = ArrayView<T>(reinterpret_cast<const T *>(file->data() + section.offset), section.count);
+    });
+    if (!inBounds) return fail("section out of range");
+    
+    string problem = validateMappedCircuit(mapped);
+    if (!problem.empty()) return fail(problem);
+    
+    mapped.storage = move(file);
+    c = move(mapped);
+    return true;
+}
+
+/**
+ * @class VerilogLexer
+ * @brief Splits structural Verilog source into tokens without copying
+ * 
+ * Tokens are identifiers (escaped identifiers keep their leading '\'),
+ * numbers including sized literals such as 1'b0, and single punctuation
+ * characters. Comments, attributes (* ... *) and compiler directives are
+ * skipped.
+ */
+class VerilogLexer {
+public:
+    VerilogLexer(const char *data, size_t size) : p(data), end(data + size) {}
+    
+    /// Returns the next token (empty at end of input) and consumes it
+    string_view next() {
+        string_view token = peek();
+        hasPeeked = false;
+        return token;
+    }
+    
+    /// Returns the next token without consuming it
+    string_view peek() {
+        if (!hasPeeked) {
+            peeked = scan();
+            hasPeeked = true;
+        }
+        return peeked;
+    }
+    
+    /// Line of the most recently returned token
+    int line() const { return tokenLine; }
+    
+private:
+    static bool isIdentChar(char ch) {
+        return isalnum(static_cast<unsigned char>(ch)) || ch == '_' || ch == '$';
+    }
+    
+    void skipPast(const char *terminator) {
+        size_t n = strlen(terminator);
+        while (p < end && !(static_cast<size_t>(end - p) >= n && memcmp(p, terminator, n) == 0)) {
+            if (*p++ == '\n') currentLine++;
+        }
+        p = (p < end) ? p + n : end;
+    }
+    
+    string_view scan() {
+        // Whitespace, comments, attributes and `directives
+        while (p < end) {
+            char ch = *p;
+            if (ch == '\n') {
+                currentLine++;
+                p++;
+            } else if (isspace(static_cast<unsigned char>(ch))) {
+                p++;
+            } else if (ch == '/' && p + 1 < end && p[1] == '/') {
+                skipPast("\n");
+                currentLine++;
+            } else if (ch == '/' && p + 1 < end && p[1] == '*') {
+                p += 2;
+                skipPast("*/");
+            } else if (ch == '(' && p + 1 < end && p[1] == '*' && !(p + 2 < end && p[2] == ')')) {
+                p += 2;
+                skipPast("*)");
+            } else if (ch == '`') {
+                skipPast("\n");
+                currentLine++;
+            } else {
+                break;
+            }
+        }
+        tokenLine = currentLine;
+        if (p >= end) return string_view();
+        
+        const char *start = p;
+        if (*p == '\\') {
+            // Escaped identifier: everything up to the next whitespace
+            while (p < end && !isspace(static_cast<unsigned char>(*p))) p++;
+        } else if (isIdentChar(*p) || *p == '\'') {
+            // Identifiers and numbers, with the base and digits of sized literals
+            while (p < end && isIdentChar(*p)) p++;
+            if (p < end && *p == '\'') {
+                p++;
+                while (p < end && (isIdentChar(*p) || *p == '?')) p++;
+            }
+        } else {
+            p++;
+        }
+        return string_view(start, p - start);
+    }
+    
+    const char *p;
+    const char *end;
+    int currentLine = 1;
+    int tokenLine = 1;
+    string_view peeked;
+    bool hasPeeked = false;
+};
+
+/**
+ * @brief Parses a sized binary literal such as 1'b0 or 4'b1010
+ * @param token Token text
+ * @param bits Receives the bits, most significant first
+ * @return false if the token is not a binary literal of 0/1 digits
+ */
+bool parseBinaryLiteral(string_view token, string &bits) {
+    size_t quote = token.find('\'');
+    if (quote == string_view::npos || quote + 1 >= token.size()) return false;
+    char base = static_cast<char>(tolower(static_cast<unsigned char>(token[quote + 1])));
+    long width = 0;
+    if (base != 'b' || (quote > 0 && !parseDecimal(token.substr(0, quote), width))) return false;
+    
+    bits.clear();
+    for (char ch : token.substr(quote + 2)) {
+        if (ch == '_') continue;
+        if (ch != '0' && ch != '1') return false;
+        bits += ch;
+    }
+    if (bits.empty()) return false;
+    if (quote > 0) {
+        // Zero-extend or truncate to the declared width
+        if (static_cast<size_t>(width) > bits.size()) bits.insert(0, width - bits.size(), '0');
+        if (static_cast<size_t>(width) < bits.size()) bits.erase(0, bits.size() - width);
+    }
+    return !bits.empty();
+}
+
+/// True for identifier tokens (plain or escaped)
+bool isVerilogIdentifier(string_view token) {
+    return !token.empty() && (isalpha(static_cast<unsigned char>(token[0])) ||
+                              token[0] == '_' || token[0] == '\\');
+}
+
+/// Net name of an identifier token (escaped identifiers without the '\\')
+string_view verilogName(string_view token) {
+    return (!token.empty() && token[0] == '\\') ? token.substr(1) : token;
+}
+
+/**
+ * @brief Imports a structural Verilog module
+ * @param data Source text (must stay valid during the call)
+ * @param size Source length
+ * @param builder Receives the nets and gates
+ * @param circuitName Receives the module name
+ * @param error Receives "line N: problem" on failure
+ * @return true on success
+ * 
+ * Supports the first module of the file: input/output/wire declarations
+ * (vectors become one net per bit, named "bus[i]"), and/or/nand/nor/xor/
+ * xnor/not/buf primitive instances with any number of terminals, and
+ * continuous assignments of a net, vector, bit select, binary constant,
+ * or the complement (~) of one. Primitives with more than two inputs are
+ * built as balanced trees of 2-input gates.
+ */
+bool importVerilog(const char *data, size_t size, CircuitBuilder &builder,
+                   string &circuitName, string &error) {
+    VerilogLexer lex(data, size);
+    unordered_map<string_view, pair<long, long>> vectors;  // Declared [msb:lsb] ranges
+    string bitName;                                         // Reused for "bus[i]" names
+    vector<int> terminals;
+    
+    auto fail = [&](const string &message) {
+        error = "line " + to_string(lex.line()) + ": " + message;
+        return false;
+    };
+    auto expect = [&](const char *token) {
+        if (lex.next() == token) return true;
+        return fail(string("expected '") + token + "'");
+    };
+    auto isDirection = [](string_view token) {
+        return token == "input" || token == "output" || token == "inout";
+    };
+    auto setBitName = [&bitName](string_view base, long index) -> const string & {
+        bitName.assign(base.data(), base.size());
+        bitName += "[" + to_string(index) + "]";
+        return bitName;
+    };
+    
+    // Optional [msb:lsb] range (or [index] bit select when lsb is null)
+    auto parseBrackets = [&](long &msb, long *lsb) {
+        lex.next();
+        if (!parseDecimal(lex.next(), msb)) return fail("expected constant index");
+        if (lsb && (lex.next() != ":" || !parseDecimal(lex.next(), *lsb))) {
+            return fail("expected constant [msb:lsb] range");
+        }
+        return expect("]");
+    };
+    
+    // Names of one input/output/wire declaration, up to ';' or ')'
+    auto parseDeclaration = [&](string_view kind) {
+        while (lex.peek() == "wire" || lex.peek() == "reg" || lex.peek() == "signed") lex.next();
+        bool ranged = (lex.peek() == "[");
+        long msb = 0, lsb = 0;
+        if (ranged && !parseBrackets(msb, &lsb)) return false;
+        
+        while (true) {
+            string_view token = lex.next();
+            if (!isVerilogIdentifier(token) || isDirection(token) || token == "wire") {
+                return fail("expected net name in declaration");
+            }
+            string_view base = verilogName(token);
+            long step = (msb >= lsb) ? -1 : 1;
+            long count = ranged ? labs(msb - lsb) + 1 : 1;
+            if (ranged) vectors[base] = {msb, lsb};
+            for (long k = 0; k < count; k++) {
+                string_view bit = ranged ? string_view(setBitName(base, msb + step * k)) : base;
+                if (kind == "input") builder.addInput(builder.net(bit));
+                else if (kind == "output") builder.addOutput(bit);
+                else builder.net(bit);
+            }
+            
+            // In an ANSI port list a new direction keyword may follow the comma
+            if (lex.peek() != ",") return true;
+            lex.next();
+            if (isDirection(lex.peek())) return true;
+        }
+    };
+    
+    // Operand: constant (bits returned in literal), name, name[i] or whole vector
+    auto parseOperand = [&](vector<int> &ids, string &literal) {
+        ids.clear();
+        literal.clear();
+        string_view token = lex.next();
+        if (parseBinaryLiteral(token, literal)) return true;
+        if (!isVerilogIdentifier(token)) return fail("expected net name, got '" + string(token) + "'");
+        
+        string_view base = verilogName(token);
+        auto range = vectors.find(base);
+        if (lex.peek() == "[") {
+            long index = 0;
+            if (!parseBrackets(index, nullptr)) return false;
+            ids.push_back(builder.net(setBitName(base, index)));
+        } else if (range != vectors.end()) {
+            long msb = range->second.first, lsb = range->second.second;
+            long step = (msb >= lsb) ? -1 : 1;
+            for (long k = msb; ; k += step) {
+                ids.push_back(builder.net(setBitName(base, k)));
+                if (k == lsb) break;
+            }
+        } else {
+            ids.push_back(builder.net(base));
+        }
+        return true;
+    };
+    
+    // Primitive terminal: a single bit
+    vector<int> operand;
+    string literal;
+    auto parseTerminal = [&](int &id) {
+        if (!parseOperand(operand, literal)) return false;
+        if (literal.size() > 1 || operand.size() > 1) return fail("expected a single-bit terminal");
+        id = literal.empty() ? operand[0] : builder.constantNet(literal[0] == '1');
+        return true;
+    };
+    
+    // assign LHS = [~]RHS {, LHS = [~]RHS} ;
+    auto parseAssign = [&]() {
+        vector<int> lhs;
+        while (true) {
+            if (!parseOperand(lhs, literal)) return false;
+            if (!literal.empty()) return fail("cannot assign to a constant");
+            if (!expect("=")) return false;
+            bool invert = (lex.peek() == "~");
+            if (invert) lex.next();
+            if (!parseOperand(operand, literal)) return false;
+            
+            if (!literal.empty()) {
+                // Constants are zero-extended or truncated to the target width
+                if (literal.size() < lhs.size()) literal.insert(0, lhs.size() - literal.size(), '0');
+                literal.erase(0, literal.size() - lhs.size());
+                for (size_t k = 0; k < lhs.size(); k++) {
+                    bool one = (literal[k] == '1') != invert;
+                    builder.addGate(one ? GateOp::CONST1 : GateOp::CONST0, lhs[k], nullptr, 0);
+                }
+            } else {
+                if (operand.size() != lhs.size()) return fail("width mismatch in assignment");
+                for (size_t k = 0; k < lhs.size(); k++) {
+                    builder.addGate(invert ? GateOp::NOT : GateOp::BUF, lhs[k], &operand[k], 1);
+                }
+            }
+            
+            string_view sep = lex.next();
+            if (sep == ";") return true;
+            if (sep != ",") return fail("unsupported expression in assign");
+        }
+    };
+    
+    // Module header and port list (plain names, or ANSI declarations)
+    while (!lex.peek().empty() && lex.peek() != "module") lex.next();
+    if (lex.next().empty()) return fail("no module found");
+    string_view moduleName = lex.next();
+    if (!isVerilogIdentifier(moduleName)) return fail("expected module name");
+    circuitName = string(verilogName(moduleName));
+    if (lex.peek() == "#") return fail("parameterized modules are not supported");
+    if (lex.peek() == "(") {
+        lex.next();
+        while (lex.peek() != ")") {
+            string_view token = lex.next();
+            if (token.empty()) return fail("unterminated port list");
+            if (token == "inout") return fail("inout ports are not supported");
+            if (isDirection(token) && !parseDeclaration(token)) return false;
+        }
+        lex.next();
+    }
+    if (!expect(";")) return false;
+    
+    // Module items
+    while (true) {
+        string_view token = lex.next();
+        if (token.empty()) return fail("missing endmodule");
+        if (token == "endmodule") return true;
+        
+        if (token == "input" || token == "output" || token == "wire") {
+            if (!parseDeclaration(token) || !expect(";")) return false;
+            continue;
+        }
+        if (token == "inout") return fail("inout ports are not supported");
+        if (token == "assign") {
+            if (!parseAssign()) return false;
+            continue;
+        }
+        
+        GateOp op = parseGateOp(toUpper(string(token)));
+        if (op == GateOp::INVALID || op == GateOp::CONST0 || op == GateOp::CONST1 || op >= GateOp::DFF) {
+            return fail("unsupported statement or cell '" + string(token) +
+                        "' (only gate primitives and assign are supported)");
+        }
+        if (lex.peek() == "#") return fail("gate delays are not supported");
+        
+        // One or more instances: [name] ( out, in, ... ) {, [name] ( ... )} ;
+        while (true) {
+            if (lex.peek() != "(") lex.next();  // Optional instance name
+            if (!expect("(")) return false;
+            terminals.clear();
+            while (true) {
+                int id;
+                if (!parseTerminal(id)) return false;
+                terminals.push_back(id);
+                if (lex.peek() != ",") break;
+                lex.next();
+            }
+            if (!expect(")")) return false;
+            
+            if (op == GateOp::BUF || op == GateOp::NOT) {
+                // not/buf: every terminal but the last is an output
+                if (terminals.size() < 2) return fail(string(token) + " needs an output and an input");
+                for (size_t k = 0; k + 1 < terminals.size(); k++) {
+                    builder.addGate(op, terminals[k], &terminals.back(), 1);
+                }
+            } else {
+                if (terminals.size() < 3) return fail(string(token) + " needs an output and two or more inputs");
+                int out = terminals[0];
+                terminals.erase(terminals.begin());
+                builder.addWideGate(op, out, terminals);
+            }
+            
+            if (lex.peek() != ",") break;
+            lex.next();
+        }
+        if (!expect(";")) return false;
+    }
+}
+
+/**
+ * @class BlifReader
+ * @brief Splits BLIF source into logical lines of whitespace-separated tokens
+ * 
+ * Handles '#' comments and '\' line continuations; tokens point into the
+ * source buffer.
+ */
+class BlifReader {
+public:
+    BlifReader(const char *data, size_t size) : p(data), end(data + size) {}
+    
+    /**
+     * @brief Reads the next non-empty logical line
+     * @param tokens Receives the tokens (buffer is reused between calls)
+     * @return false at end of input
+     */
+    bool next(vector<string_view> &tokens) {
+        tokens.clear();
+        while (p < end) {
+            if (tokens.empty()) startLine = currentLine + 1;
+            const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!eol) eol = end;
+            const char *stop = static_cast<const char *>(memchr(p, '#', eol - p));
+            if (!stop) stop = eol;
+            
+            // A trailing backslash joins the next physical line
+            const char *last = stop;
+            while (last > p && isspace(static_cast<unsigned char>(last[-1]))) last--;
+            bool continued = (last > p && last[-1] == '\\' && stop == eol);
+            if (continued) last--;
+            
+            const char *q = p;
+            while (q < last) {
+                while (q < last && isspace(static_cast<unsigned char>(*q))) q++;
+                const char *start = q;
+                while (q < last && !isspace(static_cast<unsigned char>(*q))) q++;
+                if (q > start) tokens.emplace_back(start, q - start);
+            }
+            
+            p = (eol < end) ? eol + 1 : end;
+            currentLine++;
+            if (!continued && !tokens.empty()) return true;
+        }
+        return !tokens.empty();
+    }
+    
+    /// First physical line of the most recently returned logical line
+    int line() const { return startLine; }
+    
+private:
+    const char *p;
+    const char *end;
+    int currentLine = 0;
+    int startLine = 0;
+};
+
+/**
+ * @brief Imports a BLIF model
+ * @param data Source text (must stay valid during the call)
+ * @param size Source length
+ * @param builder Receives the nets and gates
+ * @param circuitName Receives the model name
+ * @param error Receives "line N: problem" on failure
+ * @return true on success
+ * 
+ * Reads the first model. Each .names cover becomes a sum of products:
+ * an AND of literals per cube (inverted inputs through one shared NOT
+ * per input) feeding an OR, inverted for off-set covers. Single-cube and
+ * constant covers map to a single gate. Each .latch becomes a flip-flop
+ * on the single global clock (its type and control are ignored; an
+ * initial value of 2 or 3 resets to 0). Timing directives are ignored;
+ * subcircuits are rejected.
+ */
+bool importBlif(const char *data, size_t size, CircuitBuilder &builder,
+                string &circuitName, string &error) {
+    BlifReader reader(data, size);
+    vector<string_view> tokens;
+    int errorLine = 0;
+    
+    auto fail = [&](const string &message) {
+        error = "line " + to_string(errorLine) + ": " + message;
+        return false;
+    };
+    
+    // Pending .names: signal IDs (output last) and the cover rows
+    vector<int> signals;
+    vector<string_view> planes;
+    char outputBit = 0;
+    vector<int> literals, terms, inverted;
+    
+    auto emitCover = [&]() {
+        if (signals.empty()) return true;
+        const int out = signals.back();
+        const size_t nIn = signals.size() - 1;
+        bool onSet = (outputBit != '0');  // No rows at all means constant 0
+        
+        // Constant covers: no rows, no inputs, or a cube with no literals
+        bool tautology = false;
+        for (string_view plane : planes) {
+            if (plane.find_first_not_of('-') == string_view::npos) tautology = true;
+        }
+        if (planes.empty() || tautology) {
+            bool value = !planes.empty() && onSet;
+            builder.addGate(value ? GateOp::CONST1 : GateOp::CONST0, out, nullptr, 0);
+            signals.clear();
+            return true;
+        }
+        
+        // Shared inverters, created only for inputs used as 0-literals
+        inverted.assign(nIn, -1);
+        auto literal = [&](size_t k, char value) {
+            if (value == '1') return signals[k];
+            if (inverted[k] < 0) {
+                inverted[k] = builder.anonymousNet(string(builder.netName(signals[k])) + "$n");
+                builder.addGate(GateOp::NOT, inverted[k], &signals[k], 1);
+            }
+            return inverted[k];
+        };
+        
+        if (planes.size() == 1) {
+            // One cube: a single AND/NAND, or BUF/NOT of a single literal
+            literals.clear();
+            size_t only = 0;
+            for (size_t k = 0; k < nIn; k++) {
+                if (planes[0][k] != '-') {
+                    literals.push_back(signals[k]);
+                    only = k;
+                }
+            }
+            if (literals.size() == 1) {
+                bool positive = (planes[0][only] == '1') == onSet;
+                builder.addGate(positive ? GateOp::BUF : GateOp::NOT, out, &signals[only], 1);
+            } else {
+                for (size_t k = 0, j = 0; k < nIn; k++) {
+                    if (planes[0][k] != '-') literals[j++] = literal(k, planes[0][k]);
+                }
+                builder.addWideGate(onSet ? GateOp::AND : GateOp::NAND, out, literals);
+            }
+            signals.clear();
+            return true;
+        }
+        
+        // Sum of products
+        terms.clear();
+        string base = string(builder.netName(out)) + "$c";
+        for (size_t r = 0; r < planes.size(); r++) {
+            literals.clear();
+            for (size_t k = 0; k < nIn; k++) {
+                if (planes[r][k] != '-') literals.push_back(literal(k, planes[r][k]));
+            }
+            if (literals.size() == 1) {
+                terms.push_back(literals[0]);
+            } else {
+                int term = builder.anonymousNet(base + to_string(r));
+                builder.addWideGate(GateOp::AND, term, literals);
+                terms.push_back(term);
+            }
+        }
+        builder.addWideGate(onSet ? GateOp::OR : GateOp::NOR, out, terms);
+        signals.clear();
+        return true;
+    };
+    
+    bool inModel = false;
+    while (reader.next(tokens)) {
+        errorLine = reader.line();
+        string_view keyword = tokens[0];
+        
+        if (keyword[0] != '.') {
+            // Cover row of the pending .names
+            if (signals.empty()) return fail("cover row outside .names");
+            const size_t nIn = signals.size() - 1;
+            string_view plane = (nIn == 0) ? string_view() : tokens[0];
+            string_view bit = (nIn == 0) ? tokens[0] : (tokens.size() > 1 ? tokens[1] : string_view());
+            if (tokens.size() != (nIn == 0 ? 1u : 2u) || plane.size() != nIn || bit.size() != 1 ||
+                plane.find_first_not_of("01-") != string_view::npos || (bit[0] != '0' && bit[0] != '1')) {
+                return fail("malformed cover row");
+            }
+            if (outputBit && bit[0] != outputBit) return fail("cover mixes on-set and off-set rows");
+            outputBit = bit[0];
+            if (nIn == 0) {
+                // A constant: the row itself is the only (empty) cube
+                planes.push_back(string_view());
+            } else {
+                planes.push_back(plane);
+            }
+            continue;
+        }
+        
+        if (!emitCover()) return false;
+        
+        if (keyword == ".model") {
+            if (inModel) return fail("multiple models are not supported");
+            inModel = true;
+            circuitName = (tokens.size() > 1) ? string(tokens[1]) : "";
+        } else if (keyword == ".inputs") {
+            for (size_t k = 1; k < tokens.size(); k++) builder.addInput(builder.net(tokens[k]));
+        } else if (keyword == ".outputs") {
+            for (size_t k = 1; k < tokens.size(); k++) builder.addOutput(tokens[k]);
+        } else if (keyword == ".names") {
+            if (tokens.size() < 2) return fail(".names needs an output");
+            for (size_t k = 1; k < tokens.size(); k++) signals.push_back(builder.net(tokens[k]));
+            planes.clear();
+            outputBit = 0;
+        } else if (keyword == ".end" || keyword == ".exdc") {
+            return true;
+        } else if (keyword == ".latch") {
+            // .latch input output [type control] [init]: every latch is clocked by the one clock
+            if (tokens.size() < 3 || tokens.size() > 6) return fail("malformed .latch");
+            string_view init = (tokens.size() == 4 || tokens.size() == 6) ? tokens.back() : string_view("0");
+            if (init.size() != 1 || init[0] < '0' || init[0] > '3') return fail("bad .latch initial value");
+            builder.addFlop(builder.net(tokens[2]), builder.net(tokens[1]), init[0] == '1');
+        } else if (keyword == ".mlatch" || keyword == ".subckt" ||
+                   keyword == ".gate" || keyword == ".search" || keyword == ".start_kiss") {
+            return fail("unsupported construct '" + string(keyword) + "' (.names and .latch only)");
+        }
+        // Anything else (.default_input_arrival, .area, ...) does not affect logic
+    }
+    return emitCover();
+}
+
+/**
+ * @brief Imports a netlist in the simulator's own text format
+ * @param data Source text (must stay valid during the call)
+ * @param size Source length
+ * @param builder Receives the nets and gates
+ * @param circuitName Receives the circuit name
+ * @param error Receives a description of the problem on failure
+ * @param design If set, receives the modules and the compiled top level with its
+ *               instances, and builder is left empty; otherwise instances are
+ *               flattened into builder
+ * @return true on success
+ * 
+ * The file uses the same layout as the interactive prompts: circuit name,
+ * number of primary inputs followed by their names, number of primary
+ * outputs followed by their names, then one gate per line until END.
+ * Lines starting with '#' are ignored. Tokens point into the source, so
+ * no gate costs an allocation of its own.
+ * 
+ * Module definitions may come first: the same layout behind the keyword
+ * MODULE, where the inputs and outputs are the module's ports. A line
+ * "INST module instance net..." in any later body uses a module, wiring
+ * the nets to its inputs and then its outputs in declaration order. Each
+ * module is compiled once, however often it is used.
+ */
+bool importText(const char *data, size_t size, CircuitBuilder &builder,
+                string &circuitName, string &error, CompiledDesign *design = nullptr) {
+    const char *p = data;
+    const char *end = data + size;
+    vector<string_view> tokens;
+    
+    // Splits the next line into tokens; '#' starts a comment at the start of a token
+    auto nextLine = [&]() {
+        tokens.clear();
+        if (p >= end) return false;
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        while (p < eol) {
+            while (p < eol && isspace(static_cast<unsigned char>(*p))) p++;
+            const char *start = p;
+            while (p < eol && !isspace(static_cast<unsigned char>(*p))) p++;
+            if (p == start) continue;
+            if (*start == '#') break;
+            tokens.emplace_back(start, p - start);
+        }
+        p = (eol < end) ? eol + 1 : end;
+        return true;
+    };
+    
+    // Header: name, input count and names, output count and names, in any line
+    // layout, starting at token 'first' of the current line
+    auto parseHeader = [&](CircuitBuilder &b, string &name, size_t first, CompiledModule *module) {
+        int field = 0;      // 0 name, 1 input count, 2 inputs, 3 output count, 4 outputs
+        long count = 0;     // Names announced for the current list
+        long seen = 0;      // Names read so far
+        size_t k = first;
+        while (field < 5) {
+            const string what = (field <= 2) ? "inputs" : "outputs";
+            if (k == tokens.size()) {
+                if (!nextLine()) {
+                    if (field == 0) {
+                        error = "expected circuit name.";
+                    } else if (field % 2 == 1) {
+                        error = "expected number of primary " + what + ".";
+                    } else {
+                        error = "expected " + to_string(count) + " primary " + what + ".";
+                    }
+                    return false;
+                }
+                k = 0;
+                continue;
+            }
+            string_view token = tokens[k++];
+            switch (field) {
+                case 0:
+                    name = string(token);
+                    field = 1;
+                    break;
+                case 1:
+                case 3:
+                    if (!parseDecimal(token, count) || count <= 0) {
+                        error = "expected number of primary " + what + ".";
+                        return false;
+                    }
+                    seen = 0;
+                    field++;
+                    break;
+                case 2:
+                    if (module && b.findNet(token) >= 0) {
+                        error = "module " + name + ": duplicate input '" + string(token) + "'.";
+                        return false;
+                    }
+                    b.addInput(b.net(token));
+                    if (module) module->inputPorts.push_back(b.net(token));
+                    if (++seen == count) field = 3;
+                    break;
+                case 4:
+                    if (module) {
+                        int id = b.net(token);
+                        if (find(module->outputPorts.begin(), module->outputPorts.end(), id) !=
+                            module->outputPorts.end()) {
+                            error = "module " + name + ": duplicate output '" + string(token) + "'.";
+                            return false;
+                        }
+                        module->outputPorts.push_back(id);
+                    }
+                    b.addOutput(token);
+                    if (++seen == count) field = 5;  // The rest of this line is ignored
+                    break;
+            }
+        }
+        return true;
+    };
+    
+    CompiledDesign flatDesign;
+    CompiledDesign &lib = design ? *design : flatDesign;
+    lib = CompiledDesign();
+    unordered_map<string, uint32_t> moduleIndex;
+    vector<int> inputIds;
+    
+    // Gate lines up to END; module is null for a top level that is flattened
+    auto parseGates = [&](CircuitBuilder &b, CompiledModule *module, const string &moduleName) {
+        const bool isModule = !moduleName.empty();
+        int gateNumber = 0;
+        while (nextLine()) {
+            if (tokens.empty()) continue;
+            string type = toUpper(string(tokens[0]));
+            if (type == "END") return true;
+            
+            gateNumber++;
+            auto fail = [&](const string &message) {
+                error = (isModule ? "module " + moduleName + ", gate " : "gate ") +
+                        to_string(gateNumber) + ": " + message;
+                return false;
+            };
+            
+            if (type == "INST") {
+                if (tokens.size() < 3) return fail("INST requires a module name and an instance name.");
+                auto found = moduleIndex.find(string(tokens[1]));
+                if (found == moduleIndex.end()) {
+                    return fail("Unknown module '" + string(tokens[1]) + "' (define it before its first use).");
+                }
+                const CompiledModule &def = lib.modules[found->second];
+                if (tokens.size() - 3 != def.portCount()) {
+                    return fail("module " + string(tokens[1]) + " has " + to_string(def.portCount()) +
+                                " ports, got " + to_string(tokens.size() - 3) + ".");
+                }
+                inputIds.clear();
+                for (size_t k = 3; k < tokens.size(); k++) {
+                    inputIds.push_back(b.net(tokens[k]));
+                }
+                if (!module) {
+                    flattenInstance(lib, found->second, b, string(tokens[2]), inputIds.data());
+                    continue;
+                }
+                
+                // One INST gate collects the inputs, one per output reads it
+                const size_t nInputs = def.inputPorts.size();
+                if (nInputs > static_cast<size_t>(MAX_GATE_INPUTS)) return fail("module has too many inputs.");
+                ModuleInstance inst;
+                inst.module = found->second;
+                inst.firstPort = static_cast<uint32_t>(module->instancePorts.size());
+                inst.net = b.anonymousNet(tokens[2]);
+                inst.name = string(tokens[2]);
+                module->instancePorts.insert(module->instancePorts.end(), inputIds.begin(), inputIds.end());
+                module->instances.push_back(move(inst));
+                b.addGate(GateOp::INST, module->instances.back().net, inputIds.data(), nInputs);
+                for (size_t k = nInputs; k < inputIds.size(); k++) {
+                    b.addGate(GateOp::INST, inputIds[k], &module->instances.back().net, 1);
+                }
+                continue;
+            }
+            
+            string message;
+            GateOp op = parseGateType(type, message);
+            if (op == GateOp::INVALID) return fail(message);
+            if (op == GateOp::DFF && isModule) return fail("flip-flops are not supported inside modules.");
+            if (tokens.size() < 2) return fail("Output name required.");
+            if (!checkGateInputCount(op, tokens.size() - 2, message)) return fail(message);
+            
+            inputIds.clear();
+            for (size_t k = 2; k < tokens.size(); k++) {
+                inputIds.push_back(b.net(tokens[k]));
+            }
+            b.addGate(op, b.net(tokens[1]), inputIds.data(), inputIds.size());
+        }
+        error = (isModule ? "module " + moduleName + ": " : "") + "missing END after gate definitions.";
+        return false;
+    };
+    
+    while (true) {
+        do {
+            if (!nextLine()) {
+                error = lib.modules.empty() ? "empty netlist." : "expected the top-level circuit after the modules.";
+                return false;
+            }
+        } while (tokens.empty());
+        
+        if (toUpper(string(tokens[0])) != "MODULE") break;
+        CircuitBuilder moduleBuilder;
+        CompiledModule module;
+        string moduleName;
+        if (!parseHeader(moduleBuilder, moduleName, 1, &module)) return false;
+        if (moduleIndex.count(moduleName)) {
+            error = "module " + moduleName + " is defined twice.";
+            return false;
+        }
+        if (!parseGates(moduleBuilder, &module, moduleName)) return false;
+        if (!moduleBuilder.finish(module.body, moduleName)) {
+            error = "module " + moduleName + ": " + moduleBuilder.error();
+            return false;
+        }
+        scheduleModule(module);
+        moduleIndex.emplace(moduleName, static_cast<uint32_t>(lib.modules.size()));
+        lib.modules.push_back(move(module));
+    }
+    
+    if (!parseHeader(builder, circuitName, 0, nullptr)) return false;
+    if (!design) return parseGates(builder, nullptr, "");
+    
+    CompiledModule top;
+    if (!parseGates(builder, &top, "")) return false;
+    if (!builder.finish(top.body, circuitName)) {
+        error = builder.error();
+        return false;
+    }
+    scheduleModule(top);
+    lib.modules.push_back(move(top));
+    lib.layoutFrames();
+    return true;
+}
+
+NetlistFormat detectNetlistFormat(const string &path) {
+    if (isBinaryCircuitFile(path)) return NetlistFormat::BINARY;
+    size_t dot = path.find_last_of('.');
+    string ext = (dot == string::npos) ? "" : toUpper(path.substr(dot));
+    if (ext == ".V" || ext == ".SV") return NetlistFormat::VERILOG;
+    if (ext == ".BLIF") return NetlistFormat::BLIF;
+    return NetlistFormat::TEXT;
+}
+
+/**
+ * @brief Imports a text, Verilog or BLIF netlist straight into a compiled circuit
+ * @param path Netlist file path
+ * @param format TEXT, VERILOG or BLIF
+ * @param c Receives the compiled circuit
+ * @param circuitName Receives the circuit/module/model name
+ * @param optimize Run the OPTIMIZATION_PASSES before compiling
+ * @param error Receives the reason on failure
+ * @param report If given, receives the optimization summary (see finishCircuit())
+ * @return true on success
+ * 
+ * The file is memory-mapped and tokenized in place, so import time and
+ * memory grow linearly with the netlist.
+ */
+bool importNetlist(const string &path, NetlistFormat format, CompiledCircuit &c, string &circuitName,
+                   bool optimize, string &error, string *report) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "Could not open netlist '" + path + "'.";
+        return false;
+    }
+    
+    CircuitBuilder builder;
+    bool ok = false;
+    switch (format) {
+        case NetlistFormat::VERILOG: ok = importVerilog(file.data(), file.size(), builder, circuitName, error); break;
+        case NetlistFormat::BLIF:    ok = importBlif(file.data(), file.size(), builder, circuitName, error); break;
+        default:                     ok = importText(file.data(), file.size(), builder, circuitName, error); break;
+    }
+    if (!ok) {
+        error = path + ": " + error;
+        return false;
+    }
+    return finishCircuit(builder, c, circuitName, optimize, error, report);
+}
+
+bool importDesign(const string &path, CompiledDesign &design, string &circuitName, string &error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "Could not open netlist '" + path + "'.";
+        return false;
+    }
+    CircuitBuilder builder;
+    if (!importText(file.data(), file.size(), builder, circuitName, error, &design)) {
+        error = path + ": " + error;
+        return false;
+    }
+    if (design.top().body.gateCount() == 0 && design.top().body.flopCount() == 0) {
+        error = path + ": no gates defined.";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the peak resident set size of this process
+ * @return Kilobytes (0 if the platform does not report it)
+ */
+size_t peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;  // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+/**
+ * @struct BenchNetlist
+ * @brief Accumulates a synthetic circuit in the text netlist format
+ */
+struct BenchNetlist {
+    string name;
+    vector<string> inputs;
+    vector<string> outputs;
+    string gates;   ///< Gate lines
+    
+    /// Appends a gate line and returns its output name
+    string gate(const char *type, const string &out, initializer_list<string> in) {
+        gates += type;
+        gates += ' ';
+        gates += out;
+        for (const auto &net : in) {
+            gates += ' ';
+            gates += net;
+        }
+        gates += '\n';
+        return out;
+    }
+    
+    /// The complete netlist text
+    string text() const {
+        string t = name + "\n" + to_string(inputs.size()) + "\n";
+        for (const auto &net : inputs) t += net + "\n";
+        t += to_string(outputs.size()) + "\n";
+        for (const auto &net : outputs) t += net + "\n";
+        return t + gates + "END\n";
+    }
+};
+
+/**
+ * @brief Generates an N-bit ripple-carry adder
+ * @param bits Operand width
+ * @return Netlist with inputs a*, b*, cin and outputs s*, cout
+ */
+BenchNetlist generateRippleAdder(size_t bits) {
+    BenchNetlist n;
+    n.name = "ripple_adder_" + to_string(bits);
+    string carry = "cin";
+    n.inputs.push_back(carry);
+    for (size_t i = 0; i < bits; i++) {
+        const string k = to_string(i);
+        n.inputs.push_back("a" + k);
+        n.inputs.push_back("b" + k);
+        n.gate("XOR", "p" + k, {"a" + k, "b" + k});
+        n.outputs.push_back(n.gate("XOR", "s" + k, {"p" + k, carry}));
+        n.gate("AND", "g" + k, {"a" + k, "b" + k});
+        n.gate("AND", "t" + k, {"p" + k, carry});
+        carry = n.gate("OR", "c" + k, {"g" + k, "t" + k});
+    }
+    n.gate("BUF", "cout", {carry});
+    n.outputs.push_back("cout");
+    return n;
+}
+
+/**
+ * @brief Generates an N x N array multiplier
+ * @param bits Operand width
+ * @return Netlist with inputs a*, b* and the 2N product bits m*
+ * 
+ * Partial products a_j & b_i are added row by row with ripple-carry
+ * adders, the classic carry-propagate array.
+ */
+BenchNetlist generateArrayMultiplier(size_t bits) {
+    BenchNetlist n;
+    n.name = "array_multiplier_" + to_string(bits);
+    for (size_t i = 0; i < bits; i++) {
+        n.inputs.push_back("a" + to_string(i));
+        n.inputs.push_back("b" + to_string(i));
+    }
+    
+    size_t temp = 0;
+    auto fresh = [&temp]() { return "w" + to_string(temp++); };
+    vector<string> acc(2 * bits);  // Running sum bits; empty means 0
+    for (size_t i = 0; i < bits; i++) {
+        string carry;
+        for (size_t j = 0; j < bits; j++) {
+            string pp = n.gate("AND", "pp" + to_string(i) + "_" + to_string(j),
+                               {"a" + to_string(j), "b" + to_string(i)});
+            string &x = acc[i + j];
+            if (x.empty() && carry.empty()) {
+                x = pp;
+            } else if (x.empty() || carry.empty()) {
+                // Half adder
+                const string other = x.empty() ? carry : x;
+                string sum = n.gate("XOR", fresh(), {pp, other});
+                carry = n.gate("AND", fresh(), {pp, other});
+                x = sum;
+            } else {
+                string p = n.gate("XOR", fresh(), {pp, x});
+                string sum = n.gate("XOR", fresh(), {p, carry});
+                string g = n.gate("AND", fresh(), {pp, x});
+                string t = n.gate("AND", fresh(), {p, carry});
+                carry = n.gate("OR", fresh(), {g, t});
+                x = sum;
+            }
+        }
+        acc[i + bits] = carry;
+    }
+    for (size_t k = 0; k < acc.size(); k++) {
+        const string out = "m" + to_string(k);
+        if (acc[k].empty()) n.gate("CONST0", out, {});
+        else n.gate("BUF", out, {acc[k]});
+        n.outputs.push_back(out);
+    }
+    return n;
+}
+
+/**
+ * @brief Generates a random levelized DAG
+ * @param gates Number of gates
+ * @param depth Number of logic levels
+ * @param fanin Inputs per gate (at least 2)
+ * @param maxFanout Readers per net before other nets are preferred
+ * @param seed Generator seed
+ * @return Netlist with 64 inputs; every net nothing reads is an output
+ * 
+ * Each gate reads one net of the previous level, so the depth is exact,
+ * and the rest from the four levels before it.
+ */
+BenchNetlist generateRandomDag(size_t gates, size_t depth, size_t fanin, size_t maxFanout, uint64_t seed) {
+    static const char *const TYPES[] = {"AND", "OR", "NAND", "NOR", "XOR", "XNOR"};
+    BenchNetlist n;
+    n.name = "random_dag_" + to_string(gates) + "_d" + to_string(depth);
+    BenchRandom random(seed);
+    
+    vector<string> names;
+    vector<size_t> fanout;
+    vector<size_t> levelStart = {0};  // Nets of level l are levelStart[l] .. levelStart[l + 1]
+    for (size_t i = 0; i < 64; i++) {
+        names.push_back("i" + to_string(i));
+        n.inputs.push_back(names.back());
+    }
+    fanout.assign(names.size(), 0);
+    
+    const size_t perLevel = max<size_t>(gates / max<size_t>(depth, 1), 1);
+    vector<size_t> in;
+    string line;
+    for (size_t g = 0; g < gates; g++) {
+        if (g % perLevel == 0 && levelStart.size() <= depth) levelStart.push_back(names.size());
+        const size_t level = levelStart.size() - 1;
+        const size_t prevBegin = levelStart[level - 1], prevEnd = levelStart[level];
+        const size_t windowBegin = levelStart[level >= 5 ? level - 5 : 0];
+        
+        // Prefer nets below the fanout limit, within a few tries
+        auto pick = [&](size_t begin, size_t end) {
+            size_t id = begin + random.below(end - begin);
+            for (int tries = 0; tries < 8 && fanout[id] >= maxFanout; tries++) {
+                id = begin + random.below(end - begin);
+            }
+            fanout[id]++;
+            return id;
+        };
+        in.assign(1, pick(prevBegin, prevEnd));
+        while (in.size() < max<size_t>(fanin, 2)) in.push_back(pick(windowBegin, prevEnd));
+        
+        line = TYPES[random.below(6)];
+        line += " n" + to_string(g);
+        for (size_t id : in) line += " " + names[id];
+        n.gates += line + "\n";
+        names.push_back("n" + to_string(g));
+        fanout.push_back(0);
+    }
+    for (size_t id = n.inputs.size(); id < names.size(); id++) {
+        if (fanout[id] == 0) n.outputs.push_back(names[id]);
+    }
+    return n;
+}
+
+/**
+ * @brief Generates a balanced tree of 2-input XOR gates (a parity function)
+ * @param inputs Number of leaves
+ * @return Netlist with inputs x* and the single output parity
+ */
+BenchNetlist generateXorTree(size_t inputs) {
+    BenchNetlist n;
+    n.name = "xor_tree_" + to_string(inputs);
+    vector<string> layer;
+    for (size_t i = 0; i < inputs; i++) {
+        n.inputs.push_back("x" + to_string(i));
+        layer.push_back(n.inputs.back());
+    }
+    size_t temp = 0;
+    while (layer.size() > 1) {
+        vector<string> next;
+        for (size_t k = 0; k + 1 < layer.size(); k += 2) {
+            next.push_back(n.gate("XOR", "t" + to_string(temp++), {layer[k], layer[k + 1]}));
+        }
+        if (layer.size() % 2) next.push_back(layer.back());
+        layer.swap(next);
+    }
+    n.outputs.push_back(n.gate("BUF", "parity", {layer[0]}));
+    return n;
+}
+
+/**
+ * @struct BenchResult
+ * @brief Outcome of one engine run over the benchmark stimulus
+ */
+struct BenchResult {
+    double seconds = 0;     ///< Simulation time, excluding setup
+    uint64_t ones = 0;      ///< Output bits that were 1 (identical across engines)
+};
+
+/**
+ * @brief Simulates random stimulus with one benchmark engine
+ * @param c Levelized circuit
+ * @param engine Name from BENCH_ENGINES
+ * @param stimulus Input words: bit p of stimulus[b * nInputs + i] is input i of vector 64 * b + p
+ * @param vectors Number of vectors (a multiple of 512)
+ * @param threads Threads for the threaded and level engines
+ * @param result Receives the timing
+ * @return false if the engine could not run (JIT without a compiler)
+ */
+bool runBenchEngine(const CompiledCircuit &c, const string &engine, const vector<uint64_t> &stimulus,
+                    size_t vectors, size_t threads, BenchResult &result) {
+    const size_t nInputs = c.primaryInputIds.size();
+    auto inputBit = [&](size_t v, size_t i) {
+        return static_cast<int>((stimulus[(v / 64) * nInputs + i] >> (v % 64)) & 1);
+    };
+    auto countOnes = [&c](const SimState &s) {
+        uint64_t ones = 0;
+        for (int32_t id : c.primaryOutputIds) {
+            if (id >= 0) ones += s.netValues[id];
+        }
+        return ones;
+    };
+    // Packed blocks: loads the input words of lanes starting at vector first, sweeps, counts
+    auto packedBlock = [&](SimState &s, size_t first, const NativeSweep *native) {
+        const size_t k = s.packedWordsPerNet;
+        for (size_t i = 0; i < nInputs; i++) {
+            for (size_t w = 0; w < k; w++) {
+                s.netWords[c.primaryInputIds[i] * k + w] = stimulus[(first / 64 + w) * nInputs + i];
+            }
+        }
+        if (native) native->sweep(s.netWords.data());
+        else simulatePacked(c, s);
+        uint64_t ones = 0;
+        for (int32_t id : c.primaryOutputIds) {
+            for (size_t w = 0; id >= 0 && w < k; w++) ones += __builtin_popcountll(s.netWords[id * k + w]);
+        }
+        return ones;
+    };
+    
+    SimState s;
+    unique_ptr<NativeSweep> native;
+    unique_ptr<LevelParallelSimulator> levelSim;
+    unique_ptr<ThreadPool> pool;
+    vector<SimState> states;
+    PackedKernel kernel = detectPackedKernel();
+    initSimState(c, s, kernel);
+    if (engine == "jit") {
+        string error;
+        native.reset(new NativeSweep());
+        if (!native->load(c, kernel, error)) {
+            cerr << "⚠ Skipping jit on " << c.name() << " (" << error << ").\n";
+            return false;
+        }
+    } else if (engine == "level") {
+        levelSim.reset(new LevelParallelSimulator(c, threads));
+    } else if (engine == "threaded") {
+        pool.reset(new ThreadPool(threads));
+        states.resize(pool->size());
+        for (auto &state : states) initSimState(c, state, kernel);
+    }
+    
+    auto start = chrono::steady_clock::now();
+    uint64_t ones = 0;
+    if (engine == "scalar" || engine == "level") {
+        for (size_t v = 0; v < vectors; v++) {
+            for (size_t i = 0; i < nInputs; i++) s.netValues[c.primaryInputIds[i]] = inputBit(v, i);
+            if (levelSim) levelSim->simulate(s);
+            else simulate(c, s);
+            ones += countOnes(s);
+        }
+    } else if (engine == "event") {
+        for (size_t v = 0; v < vectors; v++) {
+            for (size_t i = 0; i < nInputs; i++) setInputValue(c, s, c.primaryInputIds[i], inputBit(v, i));
+            simulateEventDriven(c, s);
+            ones += countOnes(s);
+        }
+    } else if (engine == "threaded") {
+        const size_t lanes = s.packedLanes();
+        vector<uint64_t> taskOnes(vectors / lanes, 0);
+        pool->parallelFor(taskOnes.size(), [&](size_t t, size_t worker) {
+            taskOnes[t] = packedBlock(states[worker], t * lanes, nullptr);
+        });
+        for (uint64_t n : taskOnes) ones += n;
+    } else {
+        for (size_t first = 0; first < vectors; first += s.packedLanes()) {
+            ones += packedBlock(s, first, native.get());
+        }
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.ones = ones;
+    return true;
+}
+
+bool runBenchmarks(FILE *out, size_t scale, size_t vectors, const vector<string> &engines, size_t threads) {
+    vectors = max<size_t>((vectors + 511) / 512 * 512, 512);
+    const BenchNetlist circuits[] = {
+        generateRippleAdder(256 * scale),
+        generateArrayMultiplier(32 * scale),
+        generateRandomDag(20000 * scale, 64, 2, 4, 1),
+        generateRandomDag(20000 * scale, 512, 3, 16, 2),
+        generateXorTree(4096 * scale),
+    };
+    
+    fprintf(out, "circuit,gates,levels,inputs,outputs,engine,threads,vectors,load_ms,sim_ms,"
+                 "gates_per_sec,vectors_per_sec,peak_rss_kb,ones\n");
+    for (const auto &netlist : circuits) {
+        const string text = netlist.text();
+        CompiledCircuit c;
+        CircuitBuilder builder;
+        string circuitName, error;
+        auto start = chrono::steady_clock::now();
+        if (!importText(text.data(), text.size(), builder, circuitName, error) ||
+            !finishCircuit(builder, c, circuitName, false, error)) {
+            cerr << "❌ Error: benchmark circuit " << netlist.name << ": " << error << "\n";
+            return false;
+        }
+        const double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        
+        BenchRandom random(42);
+        vector<uint64_t> stimulus(vectors / 64 * c.primaryInputIds.size());
+        for (auto &word : stimulus) word = random.next();
+        
+        for (const auto &engine : engines) {
+            BenchResult r;
+            if (!runBenchEngine(c, engine, stimulus, vectors, threads, r)) continue;
+            const size_t engineThreads = (engine == "threaded" || engine == "level") ? threads : 1;
+            const double seconds = max(r.seconds, 1e-9);
+            fprintf(out, "%s,%zu,%zu,%zu,%zu,%s,%zu,%zu,%.3f,%.3f,%.0f,%.0f,%zu,%llu\n",
+                    netlist.name.c_str(), c.gateCount(), c.levelCount(), c.primaryInputIds.size(),
+                    c.primaryOutputIds.size(), engine.c_str(), engineThreads, vectors, loadMs,
+                    r.seconds * 1000, c.gateCount() * static_cast<double>(vectors) / seconds,
+                    vectors / seconds, peakRssKb(), static_cast<unsigned long long>(r.ones));
+            fflush(out);
+        }
+    }
+    return true;
+}
+
+/// Kernel blocks simulated by one random-stimulus task
+const size_t STIMULUS_TASK_BLOCKS = 32;
+
+void simulateRandomStimulus(const CompiledCircuit &c, const RandomStimulus &stimulus, uint64_t vectors,
+                            const vector<int32_t> &nets, PackedKernel kernel, size_t threads,
+                            const NativeSweep *native, vector<NetActivity> &activity) {
+    ThreadPool pool(max<size_t>(threads, 1));
+    vector<SimState> states(pool.size());
+    for (auto &s : states) initSimState(c, s, kernel);
+    const size_t k = states[0].packedWordsPerNet;
+    const uint64_t lanes = states[0].packedLanes();
+    const uint64_t taskVectors = lanes * STIMULUS_TASK_BLOCKS;
+    const size_t nInputs = c.primaryInputIds.size();
+    const size_t nNets = nets.size();
+    
+    /// Counts of one task, and its first and last vector's value of every net
+    struct TaskActivity {
+        vector<NetActivity> counts;
+        vector<char> first, last;
+    };
+    vector<TaskActivity> round(pool.size() * 4);
+    for (auto &task : round) {
+        task.counts.resize(nNets);
+        task.first.resize(nNets);
+        task.last.resize(nNets);
+    }
+    
+    activity.assign(nNets, NetActivity());
+    vector<char> previous(nNets, 0);
+    const uint64_t nTasks = (vectors + taskVectors - 1) / taskVectors;
+    for (uint64_t firstTask = 0; firstTask < nTasks; firstTask += round.size()) {
+        const size_t tasks = static_cast<size_t>(min<uint64_t>(round.size(), nTasks - firstTask));
+        pool.parallelFor(tasks, [&](size_t t, size_t worker) {
+            SimState &s = states[worker];
+            TaskActivity &task = round[t];
+            fill(task.counts.begin(), task.counts.end(), NetActivity());
+            const uint64_t taskStart = (firstTask + t) * taskVectors;
+            const uint64_t taskEnd = min(vectors, taskStart + taskVectors);
+            
+            for (uint64_t start = taskStart; start < taskEnd; start += lanes) {
+                const size_t n = static_cast<size_t>(min(lanes, taskEnd - start));
+                for (size_t w = 0; w < k; w++) {
+                    if (w * 64 >= n) {
+                        for (size_t i = 0; i < nInputs; i++) s.netWords[c.primaryInputIds[i] * k + w] = 0;
+                        continue;
+                    }
+                    BenchRandom rng = stimulus.group(start / 64 + w);
+                    for (size_t i = 0; i < nInputs; i++) s.netWords[c.primaryInputIds[i] * k + w] = stimulus.word(rng, i);
+                }
+                if (native) {
+                    native->sweep(s.netWords.data());
+                    PROFILE(s.profile.sweeps++);
+                } else {
+                    simulatePacked(c, s);
+                }
+                
+                for (size_t j = 0; j < nNets; j++) {
+                    const uint64_t *words = &s.netWords[nets[j] * k];
+                    NetActivity &counts = task.counts[j];
+                    if (start == taskStart) task.first[j] = static_cast<char>(words[0] & 1);
+                    else counts.toggles += static_cast<uint64_t>(task.last[j] != static_cast<char>(words[0] & 1));
+                    for (size_t w = 0; w * 64 < n; w++) {
+                        const size_t m = min<size_t>(64, n - w * 64);
+                        const uint64_t x = words[w];
+                        const uint64_t valid = (m == 64) ? ~0ULL : ((1ULL << m) - 1);
+                        counts.ones += static_cast<uint64_t>(__builtin_popcountll(x & valid));
+                        counts.toggles += static_cast<uint64_t>(__builtin_popcountll((x ^ (x >> 1)) & (valid >> 1)));
+                        if (w > 0) counts.toggles += ((words[w - 1] >> 63) ^ x) & 1;
+                        task.last[j] = static_cast<char>((x >> (m - 1)) & 1);
+                    }
+                }
+            }
+        });
+        
+        // Tasks join in vector order
+        for (size_t t = 0; t < tasks; t++) {
+            const bool joined = (firstTask + t > 0);
+            for (size_t j = 0; j < nNets; j++) {
+                activity[j].ones += round[t].counts[j].ones;
+                activity[j].toggles += round[t].counts[j].toggles;
+                if (joined) activity[j].toggles += static_cast<uint64_t>(previous[j] != round[t].first[j]);
+                previous[j] = round[t].last[j];
+            }
+        }
+    }
+}
+
+/**
+ * @class SatSolver
+ * @brief Small CDCL SAT solver behind the equivalence-checking miters
+ * 
+ * Conflict-driven clause learning with two watched literals, first-UIP
+ * learnt clauses, VSIDS branching (an activity heap), phase saving and
+ * Luby restarts. Literals are 2 * variable + 1 if negated. Clauses are
+ * added before solve(); learnt clauses are never deleted, so a run is
+ * bounded by its conflict limit.
+ */
+class SatSolver {
+public:
+    enum Result { SAT, UNSAT, UNKNOWN };
+    
+    int newVar() {
+        const int v = static_cast<int>(assigns.size());
+        assigns.push_back(-1);
+        levels.push_back(0);
+        reasons.push_back(-1);
+        activity.push_back(0.0);
+        phase.push_back(0);
+        seen.push_back(0);
+        heapIndex.push_back(-1);
+        watches.resize(2 * assigns.size());
+        heapInsert(v);
+        return v;
+    }
+    
+    /// Adds a clause at decision level 0; duplicate literals and tautologies are handled
+    void addClause(vector<int> lits) {
+        if (unsatisfiable) return;
+        sort(lits.begin(), lits.end());
+        size_t kept = 0;
+        for (size_t i = 0; i < lits.size(); i++) {
+            const int value = litValue(lits[i]);
+            if (value == 1 || (i > 0 && lits[i] == (lits[i - 1] ^ 1))) return;  // Satisfied
+            if (value == 0 || (kept > 0 && lits[kept - 1] == lits[i])) continue;
+            lits[kept++] = lits[i];
+        }
+        lits.resize(kept);
+        if (lits.empty()) {
+            unsatisfiable = true;
+        } else if (lits.size() == 1) {
+            enqueue(lits[0], -1);
+        } else {
+            attach(move(lits));
+        }
+    }
+    
+    /**
+     * @brief Searches for a satisfying assignment
+     * @param conflictLimit Conflicts after which the search gives up
+     * @return SAT (see value()), UNSAT, or UNKNOWN if the limit was reached
+     */
+    Result solve(uint64_t conflictLimit) {
+        if (unsatisfiable || propagate() >= 0) return UNSAT;
+        uint64_t conflicts = 0, restartConflicts = 0;
+        uint64_t restart = 1;
+        vector<int> learnt;
+        while (true) {
+            const int conflict = propagate();
+            if (conflict >= 0) {
+                if (trailLimits.empty()) return UNSAT;
+                int backLevel = analyze(conflict, learnt);
+                backtrack(backLevel);
+                if (learnt.size() == 1) {
+                    enqueue(learnt[0], -1);
+                } else {
+                    enqueue(learnt[0], attach(learnt));
+                }
+                varIncrement *= 1 / 0.95;
+                if (++conflicts >= conflictLimit) return UNKNOWN;
+                if (++restartConflicts >= SAT_RESTART_BASE * luby(restart)) {
+                    backtrack(0);
+                    restart++;
+                    restartConflicts = 0;
+                }
+                continue;
+            }
+            
+            int v = -1;
+            while (!heap.empty()) {
+                v = heapPop();
+                if (assigns[v] < 0) break;
+                v = -1;
+            }
+            if (v < 0) return SAT;
+            trailLimits.push_back(trail.size());
+            enqueue(2 * v + (phase[v] ? 0 : 1), -1);
+        }
+    }
+    
+    /// Value of a variable in the assignment found by solve()
+    bool value(int v) const { return assigns[v] == 1; }
+    
+private:
+    /// Conflicts between restarts, times the Luby sequence
+    static const uint64_t SAT_RESTART_BASE = 100;
+    
+    vector<vector<int>> clauses;
+    vector<vector<int>> watches;     ///< Clauses watching each literal, visited when it becomes false
+    vector<signed char> assigns;     ///< 1, 0 or -1 (unassigned) per variable
+    vector<int> levels, reasons;     ///< Decision level and implying clause (-1: decision) per variable
+    vector<int> trail;               ///< Assigned literals in assignment order
+    vector<size_t> trailLimits;      ///< Trail size at each decision
+    size_t propagated = 0;           ///< Trail literals already propagated
+    vector<double> activity;
+    double varIncrement = 1.0;
+    vector<char> phase, seen;
+    vector<int> heap, heapIndex;     ///< Max-heap of variables by activity
+    bool unsatisfiable = false;
+    
+    int litValue(int lit) const {
+        const int a = assigns[lit >> 1];
+        return a < 0 ? -1 : a ^ (lit & 1);
+    }
+    
+    void enqueue(int lit, int reason) {
+        const int v = lit >> 1;
+        assigns[v] = static_cast<signed char>((lit & 1) ^ 1);
+        levels[v] = static_cast<int>(trailLimits.size());
+        reasons[v] = reason;
+        trail.push_back(lit);
+    }
+    
+    int attach(vector<int> lits) {
+        const int index = static_cast<int>(clauses.size());
+        watches[lits[0]].push_back(index);
+        watches[lits[1]].push_back(index);
+        clauses.push_back(move(lits));
+        return index;
+    }
+    
+    /// Propagates the trail; returns a conflicting clause or -1
+    int propagate() {
+        while (propagated < trail.size()) {
+            const int falseLit = trail[propagated++] ^ 1;
+            vector<int> &ws = watches[falseLit];
+            size_t j = 0;
+            for (size_t i = 0; i < ws.size(); i++) {
+                const int index = ws[i];
+                vector<int> &c = clauses[index];
+                if (c[0] == falseLit) swap(c[0], c[1]);
+                if (litValue(c[0]) == 1) {
+                    ws[j++] = index;
+                    continue;
+                }
+                bool moved = false;
+                for (size_t k = 2; k < c.size(); k++) {
+                    if (litValue(c[k]) != 0) {
+                        swap(c[1], c[k]);
+                        watches[c[1]].push_back(index);
+                        moved = true;
+                        break;
+                    }
+                }
+                if (moved) continue;
+                ws[j++] = index;
+                if (litValue(c[0]) == 0) {
+                    while (++i < ws.size()) ws[j++] = ws[i];
+                    ws.resize(j);
+                    propagated = trail.size();
+                    return index;
+                }
+                enqueue(c[0], index);
+            }
+            ws.resize(j);
+        }
+        return -1;
+    }
+    
+    /// Learns the first-UIP clause of a conflict (asserting literal first); returns its backtrack level
+    int analyze(int conflict, vector<int> &learnt) {
+        learnt.assign(1, 0);
+        const int level = static_cast<int>(trailLimits.size());
+        int pending = 0, lit = -1;
+        size_t index = trail.size();
+        do {
+            for (int q : clauses[conflict]) {
+                const int v = q >> 1;
+                if (lit >= 0 && v == (lit >> 1)) continue;
+                if (seen[v] || levels[v] == 0) continue;
+                seen[v] = 1;
+                bump(v);
+                if (levels[v] >= level) pending++;
+                else learnt.push_back(q);
+            }
+            while (!seen[trail[--index] >> 1]) {}
+            lit = trail[index];
+            conflict = reasons[lit >> 1];
+            seen[lit >> 1] = 0;
+        } while (--pending > 0);
+        learnt[0] = lit ^ 1;
+        
+        int backLevel = 0;
+        for (size_t i = 1; i < learnt.size(); i++) {
+            seen[learnt[i] >> 1] = 0;
+            if (levels[learnt[i] >> 1] > backLevel) {
+                backLevel = levels[learnt[i] >> 1];
+                swap(learnt[1], learnt[i]);
+            }
+        }
+        return backLevel;
+    }
+    
+    void backtrack(int level) {
+        if (static_cast<int>(trailLimits.size()) <= level) return;
+        for (size_t i = trail.size(); i-- > trailLimits[level];) {
+            const int v = trail[i] >> 1;
+            phase[v] = static_cast<char>(assigns[v]);
+            assigns[v] = -1;
+            reasons[v] = -1;
+            if (heapIndex[v] < 0) heapInsert(v);
+        }
+        trail.resize(trailLimits[level]);
+        trailLimits.resize(level);
+        propagated = trail.size();
+    }
+    
+    void bump(int v) {
+        if ((activity[v] += varIncrement) > 1e100) {
+            for (auto &a : activity) a *= 1e-100;
+            varIncrement *= 1e-100;
+        }
+        if (heapIndex[v] >= 0) heapUp(heapIndex[v]);
+    }
+    
+    static uint64_t luby(uint64_t i) {
+        // Find the finite subsequence containing index i, then its position
+        uint64_t size = 1, seq = 0;
+        while (size < i + 1) {
+            seq++;
+            size = 2 * size + 1;
+        }
+        uint64_t x = i;
+        while (size - 1 != x) {
+            size = (size - 1) >> 1;
+            seq--;
+            x %= size;
+        }
+        return 1ULL << seq;
+    }
+    
+    void heapInsert(int v) {
+        heapIndex[v] = static_cast<int>(heap.size());
+        heap.push_back(v);
+        heapUp(heapIndex[v]);
+    }
+    
+    int heapPop() {
+        const int top = heap[0];
+        heapIndex[top] = -1;
+        const int last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            heap[0] = last;
+            heapIndex[last] = 0;
+            heapDown(0);
+        }
+        return top;
+    }
+    
+    void heapUp(int i) {
+        const int v = heap[i];
+        while (i > 0 && activity[heap[(i - 1) / 2]] < activity[v]) {
+            heap[i] = heap[(i - 1) / 2];
+            heapIndex[heap[i]] = i;
+            i = (i - 1) / 2;
+        }
+        heap[i] = v;
+        heapIndex[v] = i;
+    }
+    
+    void heapDown(int i) {
+        const int v = heap[i];
+        const int n = static_cast<int>(heap.size());
+        while (2 * i + 1 < n) {
+            int child = 2 * i + 1;
+            if (child + 1 < n && activity[heap[child + 1]] > activity[heap[child]]) child++;
+            if (activity[heap[child]] <= activity[v]) break;
+            heap[i] = heap[child];
+            heapIndex[heap[i]] = i;
+            i = child;
+        }
+        heap[i] = v;
+        heapIndex[v] = i;
+    }
+};
+
+/// Inputs up to which equivalence checking simulates every input combination
+const size_t EQUIV_EXHAUSTIVE_INPUTS = 24;
+
+/// Leaves up to which MiterGraph merges nested AND or XOR nodes into one
+const size_t MITER_FLATTEN_LIMIT = 64;
+
+/**
+ * @class MiterGraph
+ * @brief Both circuits of an equivalence check merged into one canonical gate graph
+ * 
+ * Every gate is rewritten into AND and XOR nodes over literals (2 * node,
+ * plus 1 if inverted): NAND/OR/NOR become ANDs with inverted edges, and
+ * inversions on XOR inputs move to the output. Nested ANDs and XORs are
+ * flattened (up to MITER_FLATTEN_LIMIT leaves), inputs are sorted,
+ * constants fold and repeated inputs collapse, and equal nodes are
+ * hashed into one. Fused, De Morgan-rewritten or duplicated logic of an
+ * optimized netlist thus lands on the same nodes as the original, and
+ * output pairs on the same literal are equivalent as built. Node 0 is
+ * the constant 0, nodes 1 to n the shared primary inputs; nodes are
+ * numbered in dependency order.
+ */
+class MiterGraph {
+public:
+    explicit MiterGraph(size_t inputs) {
+        addNode(CONSTANT, nullptr, 0);
+        for (size_t i = 0; i < inputs; i++) addNode(INPUT, nullptr, 0);
+    }
+    
+    /// Literal of union input i
+    static uint32_t inputLiteral(size_t i) { return static_cast<uint32_t>(2 * (i + 1)); }
+    
+    /**
+     * @brief Adds a circuit
+     * @param c Levelized circuit
+     * @param inputOf Union input index of each of c's primary inputs
+     * @return Literal of every net of c (undriven nets read 0)
+     */
+    vector<uint32_t> add(const CompiledCircuit &c, const vector<size_t> &inputOf) {
+        vector<uint32_t> netLit(c.netCount(), 0);
+        for (size_t i = 0; i < c.primaryInputIds.size(); i++) {
+            netLit[c.primaryInputIds[i]] = inputLiteral(inputOf[i]);
+        }
+        vector<uint32_t> in;
+        for (size_t g = 0; g < c.gateCount(); g++) {
+            const GateOp op = c.gateOps[g];
+            const bool invertInputs = (op == GateOp::OR || op == GateOp::NOR);
+            in.clear();
+            for (uint32_t j = 0; j < c.gateInputCount(g); j++) {
+                in.push_back(netLit[c.gateInputs(g)[j]] ^ (invertInputs ? 1 : 0));
+            }
+            uint32_t lit = 0;
+            switch (op) {
+                case GateOp::AND: case GateOp::NOR:  lit = makeNode(AND, in); break;
+                case GateOp::NAND: case GateOp::OR:  lit = makeNode(AND, in) ^ 1; break;
+                case GateOp::XOR:                    lit = makeNode(XOR, in); break;
+                case GateOp::XNOR:                   lit = makeNode(XOR, in) ^ 1; break;
+                case GateOp::NOT:                    lit = in[0] ^ 1; break;
+                case GateOp::BUF:                    lit = in[0]; break;
+                case GateOp::CONST1:                 lit = 1; break;
+                default:                             lit = 0; break;
+            }
+            netLit[c.gateOutputs[g]] = lit;
+        }
+        return netLit;
+    }
+    
+    /**
+     * @brief Encodes the cone of some literals as clauses (Tseitin encoding)
+     * @param roots Literals whose fanin cones are encoded
+     * @param solver Receives variables and clauses
+     * @return Solver literal of every encoded node (-1 outside the cones)
+     */
+    vector<int> encode(const vector<uint32_t> &roots, SatSolver &solver) const {
+        vector<char> inCone(kinds.size(), 0);
+        vector<uint32_t> stack;
+        for (uint32_t lit : roots) stack.push_back(lit >> 1);
+        while (!stack.empty()) {
+            uint32_t n = stack.back();
+            stack.pop_back();
+            if (inCone[n]) continue;
+            inCone[n] = 1;
+            for (uint32_t j = faninOffsets[n]; j < faninOffsets[n + 1]; j++) stack.push_back(fanins[j] >> 1);
+        }
+        
+        vector<int> nodeLit(kinds.size(), -1);
+        auto satLit = [&nodeLit](uint32_t lit) { return nodeLit[lit >> 1] ^ static_cast<int>(lit & 1); };
+        vector<int> clause;
+        for (uint32_t n = 0; n < kinds.size(); n++) {
+            if (!inCone[n]) continue;
+            const int y = 2 * solver.newVar();
+            nodeLit[n] = y;
+            const uint32_t *in = &fanins[faninOffsets[n]];
+            const uint32_t count = faninOffsets[n + 1] - faninOffsets[n];
+            if (kinds[n] == CONSTANT) {
+                solver.addClause({y ^ 1});
+            } else if (kinds[n] == AND) {
+                // y -> every input, all inputs -> y
+                clause.assign(1, y);
+                for (uint32_t j = 0; j < count; j++) {
+                    solver.addClause({y ^ 1, satLit(in[j])});
+                    clause.push_back(satLit(in[j]) ^ 1);
+                }
+                solver.addClause(clause);
+            } else if (kinds[n] == XOR) {
+                // A chain of two-input XORs, the last one driving y
+                int acc = satLit(in[0]);
+                for (uint32_t j = 1; j < count; j++) {
+                    const int out = (j + 1 == count) ? y : 2 * solver.newVar();
+                    const int b = satLit(in[j]);
+                    solver.addClause({out ^ 1, acc, b});
+                    solver.addClause({out ^ 1, acc ^ 1, b ^ 1});
+                    solver.addClause({out, acc ^ 1, b});
+                    solver.addClause({out, acc, b ^ 1});
+                    acc = out;
+                }
+            }
+        }
+        return nodeLit;
+    }
+    
+private:
+    enum Kind : uint8_t { CONSTANT, INPUT, AND, XOR };
+    
+    vector<Kind> kinds;
+    vector<uint32_t> faninOffsets = {0};
+    vector<uint32_t> fanins;                  ///< Input literals of each node
+    unordered_map<string, uint32_t> nodeOf;   ///< Kind and sorted input literals of every gate node
+    vector<uint32_t> leaves;                  ///< Scratch space of makeNode()
+    
+    uint32_t addNode(Kind kind, const uint32_t *in, size_t count) {
+        const uint32_t id = static_cast<uint32_t>(kinds.size());
+        if (kind == AND || kind == XOR) {
+            string key(1, static_cast<char>(kind));
+            key.append(reinterpret_cast<const char *>(in), count * sizeof(uint32_t));
+            auto inserted = nodeOf.emplace(move(key), id);
+            if (!inserted.second) return inserted.first->second;
+        }
+        kinds.push_back(kind);
+        fanins.insert(fanins.end(), in, in + count);
+        faninOffsets.push_back(static_cast<uint32_t>(fanins.size()));
+        return id;
+    }
+    
+    /// Literal of the AND or XOR of some literals, in canonical form
+    uint32_t makeNode(Kind kind, const vector<uint32_t> &in) {
+        uint32_t invert = 0;
+        leaves.clear();
+        for (uint32_t lit : in) {
+            if (kind == XOR) {
+                invert ^= lit & 1;
+                lit &= ~1u;
+            }
+            const uint32_t n = lit >> 1;
+            const uint32_t count = faninOffsets[n + 1] - faninOffsets[n];
+            if (!(lit & 1) && kinds[n] == kind && leaves.size() + count <= MITER_FLATTEN_LIMIT) {
+                leaves.insert(leaves.end(), &fanins[faninOffsets[n]], &fanins[faninOffsets[n]] + count);
+            } else {
+                leaves.push_back(lit);
+            }
+        }
+        sort(leaves.begin(), leaves.end());
+        
+        size_t kept = 0;
+        for (size_t i = 0; i < leaves.size(); i++) {
+            const uint32_t lit = leaves[i];
+            if (kind == AND) {
+                if (lit == 0 || (kept > 0 && leaves[kept - 1] == (lit ^ 1))) return 0;  // x & !x = 0
+                if (lit == 1 || (kept > 0 && leaves[kept - 1] == lit)) continue;
+            } else {
+                if (lit == 0) continue;
+                if (kept > 0 && leaves[kept - 1] == lit) {  // x ^ x = 0
+                    kept--;
+                    continue;
+                }
+            }
+            leaves[kept++] = lit;
+        }
+        leaves.resize(kept);
+        if (leaves.empty()) return (kind == AND) ? 1 : invert;
+        if (leaves.size() == 1) return leaves[0] ^ invert;
+        return 2 * addNode(kind, leaves.data(), leaves.size()) ^ invert;
+    }
+};
+
+bool checkEquivalence(const CompiledCircuit &a, const CompiledCircuit &b, const EquivOptions &options,
+                      EquivResult &result) {
+    // Merge the name-sorted input lists
+    const CompiledCircuit *sides[2] = {&a, &b};
+    vector<size_t> inputOf[2];
+    result = EquivResult();
+    for (size_t ia = 0, ib = 0; ia < a.primaryInputIds.size() || ib < b.primaryInputIds.size();) {
+        string_view na = ia < a.primaryInputIds.size() ? a.netName(a.primaryInputIds[ia]) : string_view();
+        string_view nb = ib < b.primaryInputIds.size() ? b.netName(b.primaryInputIds[ib]) : string_view();
+        const bool takeA = ia < a.primaryInputIds.size() && (ib == b.primaryInputIds.size() || na <= nb);
+        const bool takeB = ib < b.primaryInputIds.size() && (ia == a.primaryInputIds.size() || nb <= na);
+        if (takeA) inputOf[0].push_back(result.inputs.size());
+        if (takeB) inputOf[1].push_back(result.inputs.size());
+        if (takeA != takeB) {
+            cerr << "⚠ Input " << (takeA ? na : nb) << " is only in the " << (takeA ? "first" : "second")
+                 << " circuit.\n";
+        }
+        result.inputs.emplace_back(takeA ? na : nb);
+        ia += takeA;
+        ib += takeB;
+    }
+    
+    vector<pair<int, int>> outputPairs;
+    for (size_t oa = 0, ob = 0; oa < a.primaryOutputIds.size() || ob < b.primaryOutputIds.size();) {
+        string_view na = oa < a.primaryOutputIds.size() ? a.outputName(oa) : string_view();
+        string_view nb = ob < b.primaryOutputIds.size() ? b.outputName(ob) : string_view();
+        const bool takeA = oa < a.primaryOutputIds.size() && (ob == b.primaryOutputIds.size() || na <= nb);
+        const bool takeB = ob < b.primaryOutputIds.size() && (oa == a.primaryOutputIds.size() || nb <= na);
+        if (takeA && takeB) {
+            int idA = a.primaryOutputIds[oa], idB = b.primaryOutputIds[ob];
+            if (idA < 0 || idB < 0) {
+                cerr << "❌ Error: Output " << na << " is undefined in the " << (idA < 0 ? "first" : "second")
+                     << " circuit.\n";
+                return false;
+            }
+            outputPairs.emplace_back(idA, idB);
+            result.outputs.emplace_back(na);
+        } else {
+            cerr << "⚠ Output " << (takeA ? na : nb) << " is only in the " << (takeA ? "first" : "second")
+                 << " circuit; not compared.\n";
+        }
+        oa += takeA;
+        ob += takeB;
+    }
+    if (outputPairs.empty()) {
+        cerr << "❌ Error: The circuits have no output names in common.\n";
+        return false;
+    }
+    
+    // Packed simulation: exhaustive for small circuits, else random
+    const size_t nInputs = result.inputs.size();
+    result.exhaustive = nInputs <= EQUIV_EXHAUSTIVE_INPUTS && options.randomVectors > 0;
+    const uint64_t total = result.exhaustive ? (1ULL << nInputs) : options.randomVectors;
+    SimState states[2];
+    for (int side = 0; side < 2; side++) initSimState(*sides[side], states[side], detectPackedKernel());
+    const size_t k = states[0].packedWordsPerNet;
+    vector<uint64_t> inputWords(nInputs * k);
+    BenchRandom random(options.seed);
+    
+    for (uint64_t base = 0; base < total; base += 64 * k) {
+        for (size_t i = 0; i < nInputs; i++) {
+            for (size_t w = 0; w < k; w++) {
+                inputWords[i * k + w] = result.exhaustive
+                    ? exhaustivePatternWord(base + 64 * w, static_cast<int>(nInputs - 1 - i)) : random.next();
+            }
+        }
+        for (int side = 0; side < 2; side++) {
+            const CompiledCircuit &c = *sides[side];
+            for (size_t i = 0; i < c.primaryInputIds.size(); i++) {
+                copy_n(&inputWords[inputOf[side][i] * k], k, &states[side].netWords[c.primaryInputIds[i] * k]);
+            }
+            simulatePacked(c, states[side]);
+        }
+        
+        // Lowest differing lane over all outputs, ignoring lanes past the last vector
+        const uint64_t lanes = min<uint64_t>(64 * k, total - base);
+        uint64_t first = lanes;
+        for (const auto &p : outputPairs) {
+            for (size_t w = 0; w * 64 < first; w++) {
+                uint64_t diff = states[0].netWords[p.first * k + w] ^ states[1].netWords[p.second * k + w];
+                if (diff) {
+                    first = min<uint64_t>(first, w * 64 + __builtin_ctzll(diff));
+                    break;
+                }
+            }
+        }
+        result.simulated += min<uint64_t>(lanes, first + 1);
+        if (first < lanes) {
+            result.verdict = EquivVerdict::DIFFERENT;
+            for (size_t i = 0; i < nInputs; i++) {
+                result.counterexample.push_back(static_cast<char>((inputWords[i * k + first / 64] >> (first % 64)) & 1));
+            }
+            return true;
+        }
+    }
+    if (result.exhaustive) return true;
+    
+    // Formal proof of every output pair on one hashed miter
+    MiterGraph graph(nInputs);
+    vector<uint32_t> netLit[2];
+    for (int side = 0; side < 2; side++) netLit[side] = graph.add(*sides[side], inputOf[side]);
+    for (size_t o = 0; o < outputPairs.size(); o++) {
+        const uint32_t la = netLit[0][outputPairs[o].first], lb = netLit[1][outputPairs[o].second];
+        if (la == lb) {
+            result.structural++;
+            continue;
+        }
+        SatSolver solver;
+        vector<int> nodeLit = graph.encode({la, lb}, solver);
+        const int sa = nodeLit[la >> 1] ^ static_cast<int>(la & 1), sb = nodeLit[lb >> 1] ^ static_cast<int>(lb & 1);
+        solver.addClause({sa, sb});
+        solver.addClause({sa ^ 1, sb ^ 1});
+        SatSolver::Result r = solver.solve(options.conflictLimit);
+        if (r == SatSolver::UNSAT) {
+            result.proven++;
+        } else if (r == SatSolver::UNKNOWN) {
+            result.undecided.push_back(result.outputs[o]);
+            result.verdict = EquivVerdict::UNDECIDED;
+        } else {
+            result.verdict = EquivVerdict::DIFFERENT;
+            result.foundBySat = true;
+            for (size_t i = 0; i < nInputs; i++) {
+                const int input = nodeLit[MiterGraph::inputLiteral(i) >> 1];
+                result.counterexample.push_back(input >= 0 && solver.value(input >> 1) ? 1 : 0);
+            }
+            return true;
+        }
+    }
+    return true;
+}
+
+bool loadCircuit(const string &path, CompiledCircuit &c, string &circuitName, bool optimize, string &error,
+                 string *report) {
+    NetlistFormat format = detectNetlistFormat(path);
+    if (format == NetlistFormat::BINARY) {
+        if (!mapBinaryCircuit(path, c, error)) return false;
+        circuitName = string(c.name());
+        return true;
+    }
+    if (!importNetlist(path, format, c, circuitName, optimize, error, report)) return false;
+    if (c.gateCount() == 0 && c.flopCount() == 0) {
+        error = path + ": no gates defined.";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace detail
+
+// ============================================================================
+// Library API (circuitsim.h)
+// ============================================================================
+
+using namespace detail;
+
+/// Compiled netlist behind a Circuit
+struct Circuit::Impl {
+    CompiledCircuit compiled;
+    string name;
+};
+
+/// Simulation state behind a Simulator
+struct Simulator::State {
+    SimState sim;
+};
+
+Circuit::Circuit(unique_ptr<Impl> impl) : impl(move(impl)) {}
+Circuit::~Circuit() = default;
+
+/// Wraps a compiled netlist, or reports why it cannot be simulated
+shared_ptr<const Circuit> Circuit::create(unique_ptr<Impl> impl, bool ok, const string &reason, string *error) {
+    if (ok && impl->compiled.flopCount() > 0) {
+        if (error) {
+            *error = "Circuit has " + to_string(impl->compiled.flopCount()) + " flip-flop(s); the library "
+                     "simulates combinational circuits only.";
+        }
+        return nullptr;
+    }
+    if (error) *error = ok ? "" : reason;
+    return ok ? shared_ptr<const Circuit>(new Circuit(move(impl))) : nullptr;
+}
+
+shared_ptr<const Circuit> Circuit::load(const string &path, bool optimize, string *error) {
+    unique_ptr<Impl> impl(new Impl());
+    string reason;
+    bool ok = loadCircuit(path, impl->compiled, impl->name, optimize, reason);
+    return create(move(impl), ok, reason, error);
+}
+
+shared_ptr<const Circuit> Circuit::parse(string_view text, NetlistSyntax syntax, bool optimize, string *error) {
+    unique_ptr<Impl> impl(new Impl());
+    CircuitBuilder builder;
+    string reason;
+    bool ok = false;
+    switch (syntax) {
+        case NetlistSyntax::VERILOG: ok = importVerilog(text.data(), text.size(), builder, impl->name, reason); break;
+        case NetlistSyntax::BLIF:    ok = importBlif(text.data(), text.size(), builder, impl->name, reason); break;
+        default:                     ok = importText(text.data(), text.size(), builder, impl->name, reason); break;
+    }
+    ok = ok && finishCircuit(builder, impl->compiled, impl->name, optimize, reason);
+    return create(move(impl), ok, reason, error);
+}
+
+string_view Circuit::name() const { return impl->name; }
+size_t Circuit::inputCount() const { return impl->compiled.primaryInputIds.size(); }
+size_t Circuit::outputCount() const { return impl->compiled.primaryOutputIds.size(); }
+string_view Circuit::inputName(size_t i) const { return impl->compiled.netName(impl->compiled.primaryInputIds[i]); }
+string_view Circuit::outputName(size_t o) const { return impl->compiled.outputName(o); }
+size_t Circuit::gateCount() const { return impl->compiled.gateCount(); }
+size_t Circuit::levelCount() const { return impl->compiled.levelCount(); }
+
+Simulator::Simulator(shared_ptr<const Circuit> circuit) : shared(move(circuit)), state(new State()) {
+    initSimState(shared->impl->compiled, state->sim, detectPackedKernel());
+}
+
+Simulator::~Simulator() = default;
+Simulator::Simulator(Simulator &&other) noexcept = default;
+Simulator &Simulator::operator=(Simulator &&other) noexcept = default;
+
+size_t Simulator::inputWords(size_t vectors) const {
+    return (vectors + VECTORS_PER_WORD - 1) / VECTORS_PER_WORD * shared->inputCount();
+}
+
+size_t Simulator::outputWords(size_t vectors) const {
+    return (vectors + VECTORS_PER_WORD - 1) / VECTORS_PER_WORD * shared->outputCount();
+}
+
+bool Simulator::simulate(span<const uint64_t> in, span<uint64_t> out) {
+    const CompiledCircuit &c = shared->impl->compiled;
+    const size_t nInputs = c.primaryInputIds.size();
+    const size_t nOutputs = c.primaryOutputIds.size();
+    if (nInputs == 0 ? !in.empty() : in.size() % nInputs != 0) return false;
+    
+    // A circuit without inputs has one result per group of output words
+    const size_t groups = nInputs ? in.size() / nInputs : (nOutputs ? out.size() / nOutputs : 0);
+    if (out.size() < groups * nOutputs) return false;
+    
+    // Each sweep takes as many groups as the kernel has words per net
+    SimState &s = state->sim;
+    const size_t k = s.packedWordsPerNet;
+    for (size_t first = 0; first < groups; first += k) {
+        const size_t n = min(k, groups - first);
+        for (size_t i = 0; i < nInputs; i++) {
+            uint64_t *words = &s.netWords[c.primaryInputIds[i] * k];
+            for (size_t w = 0; w < k; w++) words[w] = (w < n) ? in[(first + w) * nInputs + i] : 0;
+        }
+        simulatePacked(c, s);
+        for (size_t o = 0; o < nOutputs; o++) {
+            const int id = c.primaryOutputIds[o];
+            for (size_t w = 0; w < n; w++) out[(first + w) * nOutputs + o] = (id < 0) ? 0 : s.netWords[id * k + w];
+        }
+    }
+    return true;
+}
+
+}  // namespace circuitsim
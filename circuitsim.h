@@ -0,0 +1,181 @@
+/**
+ * @file circuitsim.h
+ * @brief Digital Circuit Simulator library - compiled circuits and bit-parallel simulators
+ * @author Piyush
+ * @date October 2026
+ * @version 1.0
+ *
+ * The library behind the 'circuit' program, for embedding the simulator:
+ * - Circuit: an immutable compiled netlist, shared by any number of threads
+ * - Simulator: the per-thread simulation state of one circuit
+ *
+ * A Circuit is never modified after it is loaded, so one circuit can feed
+ * simulators on every thread, and several circuits can live in one process.
+ * A Simulator must not be used by two threads at once. Nothing in the
+ * library keeps global state.
+ *
+ * Example, with one uint64_t per input and per output for every 64 vectors:
+ *
+ *     auto adder = circuitsim::Circuit::load("full_adder.v");
+ *     circuitsim::Simulator sim(adder);
+ *     std::vector<uint64_t> in(adder->inputCount()), out(adder->outputCount());
+ *     in[0] = 0xF0; in[1] = 0xCC; in[2] = 0xAA;   // Vectors 0-7 in bits 0-7
+ *     sim.simulate(in, out);                     // Bit p of out[o]: output o of vector p
+ */
+
+#ifndef CIRCUITSIM_H
+#define CIRCUITSIM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/// Marks the classes exported by the shared library (the rest is hidden)
+#if defined(__GNUC__)
+#define CIRCUITSIM_API __attribute__((visibility("default")))
+#else
+#define CIRCUITSIM_API
+#endif
+
+namespace circuitsim {
+
+/**
+ * @class span
+ * @brief Pointer and length of a contiguous array (std::span for C++17)
+ * @tparam T Element type, const for read-only views
+ */
+template <typename T>
+class span {
+public:
+    constexpr span() : ptr(nullptr), len(0) {}
+    constexpr span(T *data, size_t size) : ptr(data), len(size) {}
+
+    /// Views a container with data() and size(), such as a vector
+    template <typename V, typename = std::enable_if_t<
+                              std::is_convertible_v<decltype(std::declval<V &>().data()), T *>>>
+    constexpr span(V &v) : ptr(v.data()), len(v.size()) {}
+
+    template <size_t N>
+    constexpr span(T (&array)[N]) : ptr(array), len(N) {}
+
+    constexpr T *data() const { return ptr; }
+    constexpr size_t size() const { return len; }
+    constexpr bool empty() const { return len == 0; }
+    constexpr T &operator[](size_t i) const { return ptr[i]; }
+    constexpr T *begin() const { return ptr; }
+    constexpr T *end() const { return ptr + len; }
+
+private:
+    T *ptr;
+    size_t len;
+};
+
+/**
+ * @enum NetlistSyntax
+ * @brief Netlist languages accepted by Circuit::parse()
+ */
+enum class NetlistSyntax { TEXT, VERILOG, BLIF };
+
+/**
+ * @class Circuit
+ * @brief Immutable compiled combinational circuit
+ *
+ * Inputs and outputs are numbered in name order, as in the batch results
+ * of the 'circuit' program. Loading prints nothing: on failure it returns
+ * nullptr and, if asked, the reason as one line of text.
+ */
+class CIRCUITSIM_API Circuit {
+public:
+    /**
+     * @brief Loads a netlist file
+     * @param path Text, Verilog (.v), BLIF (.blif) or binary netlist (see 'circuit convert')
+     * @param optimize Run the --optimize passes first (ignored for binary netlists)
+     * @param error If given, receives the reason on failure (cleared on success)
+     * @return The circuit, or nullptr if it cannot be loaded or has flip-flops
+     */
+    static std::shared_ptr<const Circuit> load(const std::string &path, bool optimize = false,
+                                               std::string *error = nullptr);
+
+    /**
+     * @brief Compiles a netlist held in memory
+     * @param text Netlist source
+     * @param syntax Language of text
+     * @param optimize Run the --optimize passes first
+     * @param error If given, receives the reason on failure (cleared on success)
+     * @return The circuit, or nullptr if it cannot be compiled or has flip-flops
+     */
+    static std::shared_ptr<const Circuit> parse(std::string_view text, NetlistSyntax syntax = NetlistSyntax::TEXT,
+                                                bool optimize = false, std::string *error = nullptr);
+
+    ~Circuit();
+    Circuit(const Circuit &) = delete;
+    Circuit &operator=(const Circuit &) = delete;
+
+    std::string_view name() const;
+    size_t inputCount() const;
+    size_t outputCount() const;
+    std::string_view inputName(size_t i) const;
+    std::string_view outputName(size_t o) const;
+    size_t gateCount() const;
+
+    /// Logic levels, the length of the longest input-to-output path in gates
+    size_t levelCount() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+    explicit Circuit(std::unique_ptr<Impl> impl);
+    static std::shared_ptr<const Circuit> create(std::unique_ptr<Impl> impl, bool ok, const std::string &reason,
+                                                 std::string *error);
+    friend class Simulator;
+};
+
+/**
+ * @class Simulator
+ * @brief Bit-parallel simulation state of one circuit, for one thread at a time
+ *
+ * All buffers are allocated by the constructor, so simulate() allocates
+ * nothing. It uses the widest packed kernel the CPU supports (64, 256 or
+ * 512 vectors per gate evaluation).
+ */
+class CIRCUITSIM_API Simulator {
+public:
+    /// Number of vectors held by one word of simulate() input or output
+    static constexpr size_t VECTORS_PER_WORD = 64;
+
+    explicit Simulator(std::shared_ptr<const Circuit> circuit);
+    ~Simulator();
+    Simulator(Simulator &&other) noexcept;
+    Simulator &operator=(Simulator &&other) noexcept;
+
+    const Circuit &circuit() const { return *shared; }
+
+    /// Words of simulate() input holding a number of vectors
+    size_t inputWords(size_t vectors) const;
+
+    /// Words of simulate() output for a number of vectors
+    size_t outputWords(size_t vectors) const;
+
+    /**
+     * @brief Simulates a batch of vectors, 64 per word
+     * @param in inputCount() words per group of 64 vectors: bit p of
+     *           in[w * inputCount() + i] is input i of vector w * 64 + p
+     * @param out Receives outputCount() words per group in the same layout
+     *            (an output driven by nothing reads 0)
+     * @return false, writing nothing, if in does not hold whole groups or out is too small
+     */
+    bool simulate(span<const uint64_t> in, span<uint64_t> out);
+
+private:
+    struct State;
+    std::shared_ptr<const Circuit> shared;
+    std::unique_ptr<State> state;
+};
+
+}  // namespace circuitsim
+
+#endif  // CIRCUITSIM_H
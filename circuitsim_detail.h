@@ -0,0 +1,1371 @@
+/**
+ * @file circuitsim_detail.h
+ * @brief Digital Circuit Simulator - engine internals shared by the library and the program
+ * @author Piyush
+ * @date October 2026
+ * @version 1.0
+ *
+ * Compiled circuits, simulation state, the batch pipeline types and the
+ * entry points of the engines in circuitsim.cpp, for the 'circuit'
+ * program built on top of them. Not part of the public API (circuitsim.h):
+ * everything here lives in circuitsim::detail and may change freely.
+ */
+
+#ifndef CIRCUITSIM_DETAIL_H
+#define CIRCUITSIM_DETAIL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace circuitsim {
+namespace detail {
+
+using namespace std;
+
+/**
+ * @enum GateOp
+ * @brief Gate opcode, resolved once from the gate type name at parse time
+ */
+enum class GateOp : uint8_t {
+    AND, OR, NAND, NOR, XOR, XNOR, NOT, BUF, CONST0, CONST1,
+    DFF,     ///< D flip-flop: kept apart from the gates as a state element
+    INST,    ///< Module instance placeholder inside a CompiledModule body
+    INVALID  ///< Not a supported gate type
+};
+
+/**
+ * @struct GateOpInfo
+ * @brief Static description of a gate opcode
+ */
+struct GateOpInfo {
+    const char *name;   ///< Gate type name as written in netlists
+    GateOp op;          ///< Opcode
+    int inputs;         ///< Required number of inputs (the minimum for N-input gates)
+    bool variadic;      ///< Accepts any number of inputs from 'inputs' up to MAX_GATE_INPUTS
+};
+
+/**
+ * @brief Returns the netlist name of a gate opcode
+ * @param op Gate opcode
+ * @return Gate type name, or "INVALID"
+ */
+const char *gateOpName(GateOp op);
+
+/**
+ * @struct Gate
+ * @brief Represents a digital logic gate with its type, output, and inputs
+ */
+struct Gate {
+    GateOp op = GateOp::INVALID;  ///< Gate opcode (AND, OR, NOT, etc.)
+    string out;             ///< Output net name
+    vector<string> inputs;  ///< Input net names
+};
+
+/**
+ * @enum PackedKernel
+ * @brief Lane width used by the bit-parallel simulation kernel
+ */
+enum class PackedKernel : uint8_t {
+    SCALAR,  ///< One uint64_t per net (64 patterns), portable
+    AVX2,    ///< 256-bit lanes per net (256 patterns)
+    AVX512   ///< 512-bit lanes per net (512 patterns)
+};
+
+/**
+ * @struct PackedKernelInfo
+ * @brief Static description of a packed simulation kernel
+ */
+struct PackedKernelInfo {
+    const char *name;   ///< Display name
+    size_t lanes;       ///< Patterns evaluated per sweep
+};
+
+/// Table of packed kernels, indexed by PackedKernel
+const PackedKernelInfo PACKED_KERNELS[] = {
+    {"scalar",  64},
+    {"avx2",    256},
+    {"avx512",  512},
+};
+
+/**
+ * @struct AlignedAllocator
+ * @brief Allocator returning storage aligned for the widest packed kernel
+ */
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+    static constexpr size_t ALIGNMENT = 64;  ///< One 512-bit lane
+    
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U> &) {}
+    
+    T *allocate(size_t n) {
+        return static_cast<T *>(::operator new(n * sizeof(T), align_val_t(ALIGNMENT)));
+    }
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, align_val_t(ALIGNMENT));
+    }
+    
+    template <typename U> bool operator==(const AlignedAllocator<U> &) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U> &) const { return false; }
+};
+
+/// Packed net value storage; every net's lane starts on a 64-byte boundary
+/// whenever packedWordsPerNet is 8, and on a 32-byte boundary when it is 4
+using PackedWords = vector<uint64_t, AlignedAllocator<uint64_t>>;
+
+/// Largest circuit (in primary inputs) printTruthTable() will enumerate
+const int MAX_TRUTH_TABLE_INPUTS = 16;
+
+/// Largest circuit (in primary inputs) writeTruthTable() will stream
+const size_t MAX_STREAMED_TRUTH_TABLE_INPUTS = 32;
+
+/**
+ * @struct ArrayView
+ * @brief Read-only view of a contiguous array
+ * 
+ * CompiledCircuit arrays are views so they can point either into buffers
+ * the circuit owns or straight into a memory-mapped binary netlist.
+ */
+template <typename T>
+struct ArrayView {
+    typedef T value_type;
+    
+    const T *ptr = nullptr;
+    size_t count = 0;
+    
+    ArrayView() = default;
+    ArrayView(const T *p, size_t n) : ptr(p), count(n) {}
+    ArrayView(const vector<T> &v) : ptr(v.data()), count(v.size()) {}
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T *data() const { return ptr; }
+    const T *begin() const { return ptr; }
+    const T *end() const { return ptr + count; }
+    const T &operator[](size_t i) const { return ptr[i]; }
+    const T &back() const { return ptr[count - 1]; }
+};
+
+/**
+ * @struct GateRecord
+ * @brief Gate of a netlist under construction in a CircuitBuilder
+ */
+struct GateRecord {
+    GateOp op;              ///< Gate opcode
+    uint16_t inputCount;    ///< Number of input nets
+    int32_t out;            ///< Output net ID
+    uint32_t firstInput;    ///< Index of the first input net ID in the builder's fanins
+};
+
+/**
+ * @struct CompiledCircuit
+ * @brief Integer-indexed, levelized form of the netlist
+ * 
+ * Built once by compileCircuit() (or mapped by mapBinaryCircuit()) and
+ * never modified afterwards, so any number of threads can simulate one
+ * CompiledCircuit at the same time, each with its own SimState. Copies
+ * are cheap and share the underlying storage.
+ */
+struct CompiledCircuit {
+    uint32_t nets = 0;                  ///< Number of nets
+    uint32_t nameIndex = 0;             ///< String index of the circuit name
+    
+    // Gates in level order, one array per field so a sweep reads each sequentially
+    ArrayView<GateOp> gateOps;          ///< Opcode of each gate
+    ArrayView<int32_t> gateOutputs;     ///< Output net ID of each gate
+    ArrayView<uint32_t> faninOffsets;   ///< Inputs of gate g are fanins[faninOffsets[g] .. faninOffsets[g + 1])
+    ArrayView<int32_t> fanins;          ///< Concatenated gate input net IDs
+    ArrayView<uint32_t> gateLevels;     ///< Logic level of each gate (event-driven scheduling only)
+    ArrayView<uint32_t> levelOffsets;   ///< Gates of level l are [levelOffsets[l] .. levelOffsets[l + 1])
+    ArrayView<uint32_t> fanoutOffsets;  ///< Gates reading net id are fanoutGates[fanoutOffsets[id] .. fanoutOffsets[id + 1])
+    ArrayView<int32_t> fanoutGates;     ///< Concatenated per-net fanout gate indices
+    
+    // Flip-flops, in definition order: on every clock, flop f copies net flopInputs[f] to flopOutputs[f]
+    ArrayView<int32_t> flopOutputs;     ///< Q net ID of each flip-flop (read by the gates like an input)
+    ArrayView<int32_t> flopInputs;      ///< D net ID of each flip-flop
+    ArrayView<uint8_t> flopResetValues; ///< Q value of each flip-flop before the first clock (0 or 1)
+    
+    // Primary I/O and names
+    ArrayView<int32_t> primaryInputIds;   ///< Net IDs of primary inputs, in primaryInputs order
+    ArrayView<int32_t> primaryOutputIds;  ///< Net IDs of primary outputs (-1 if never referenced)
+    ArrayView<uint32_t> outputNameIds;    ///< String index of each primary output name
+    ArrayView<int32_t> netsByName;        ///< All net IDs sorted by net name
+    ArrayView<uint32_t> stringOffsets;    ///< Start of each NUL-terminated string; string id < nets is net id's name
+    ArrayView<char> stringChars;          ///< String table contents
+    
+    shared_ptr<const void> storage;     ///< Keeps owned buffers or the file mapping alive
+    
+    size_t netCount() const { return nets; }
+    size_t gateCount() const { return gateOps.size(); }
+    size_t flopCount() const { return flopOutputs.size(); }
+    
+    /// Number of logic levels (0 for an empty circuit)
+    size_t levelCount() const { return levelOffsets.empty() ? 0 : levelOffsets.size() - 1; }
+    
+    /// Input net IDs of gate g
+    const int32_t *gateInputs(size_t g) const { return fanins.data() + faninOffsets[g]; }
+    
+    /// Number of inputs of gate g
+    uint32_t gateInputCount(size_t g) const { return faninOffsets[g + 1] - faninOffsets[g]; }
+    
+    /// String table entry
+    string_view str(uint32_t index) const { return string_view(stringChars.data() + stringOffsets[index]); }
+    
+    /// Name of a net
+    string_view netName(int id) const { return str(static_cast<uint32_t>(id)); }
+    
+    /// Name of primary output o
+    string_view outputName(size_t o) const { return str(outputNameIds[o]); }
+    
+    /// Circuit name
+    string_view name() const { return str(nameIndex); }
+    
+    /// Net ID of a name, or -1 if no such net exists
+    int findNet(string_view netName) const {
+        auto it = lower_bound(netsByName.begin(), netsByName.end(), netName,
+                              [this](int32_t id, string_view key) { return this->netName(id) < key; });
+        return (it != netsByName.end() && this->netName(*it) == netName) ? *it : -1;
+    }
+};
+
+/**
+ * @struct EventStats
+ * @brief Work done by the event-driven engine
+ */
+struct EventStats {
+    uint64_t evaluated = 0;  ///< Gates evaluated
+    uint64_t skipped = 0;    ///< Gates a full simulate() would have evaluated in addition
+};
+
+/// Number of gate opcodes (GateOp values before INVALID)
+const size_t GATE_OP_COUNT = static_cast<size_t>(GateOp::INVALID);
+
+#ifdef CIRCUIT_PROFILE
+
+/**
+ * @struct SimProfile
+ * @brief Hot-path counters of one SimState (profiling builds only)
+ * 
+ * Sweeping engines evaluate every gate once per pass, so they only count
+ * passes; the per-type and per-level totals of a pass follow from the
+ * circuit itself. The event-driven engine's work depends on the stimulus
+ * and is counted gate by gate.
+ */
+struct SimProfile {
+    uint64_t sweeps = 0;                        ///< Full passes over every gate (any engine)
+    uint64_t opEvaluations[GATE_OP_COUNT] = {}; ///< Event-driven evaluations per gate type
+    vector<uint64_t> levelEvaluations;          ///< Event-driven evaluations per level
+    vector<uint64_t> levelChanges;              ///< Event-driven output changes per level
+    vector<uint64_t> netToggles;                ///< Event-driven value changes per net
+};
+
+/// Executes a counter update in profiling builds; expands to nothing otherwise
+#define PROFILE(statement) do { statement; } while (0)
+
+#else
+
+#define PROFILE(statement) do {} while (0)
+
+#endif
+
+/**
+ * @struct SimState
+ * @brief Mutable simulation state for one compiled circuit
+ * 
+ * Holds every value buffer the engines write, so each thread simulating
+ * a shared CompiledCircuit owns one SimState. Created by initSimState().
+ */
+struct SimState {
+    vector<int> netValues;              ///< Current value of each net (0 or 1), indexed by net ID
+    PackedWords netWords;               ///< Packed values of each net, one pattern per bit (simulatePacked())
+    PackedKernel packedKernel = PackedKernel::SCALAR;  ///< Kernel used by simulatePacked()
+    size_t packedWordsPerNet = 1;       ///< 64-bit words per net in netWords (lanes / 64)
+    vector<uint64_t> flopWords;         ///< D values latched by clockFlops(), packedWordsPerNet per flip-flop
+    
+    // Event-driven engine state (see simulateEventDriven())
+    bool eventStateValid = false;       ///< netValues is consistent with the current inputs
+    vector<vector<int>> levelEvents;    ///< Gates scheduled for re-evaluation, per logic level
+    vector<char> gateScheduled;         ///< Whether each gate is already in levelEvents
+    EventStats lastEventStats;          ///< Statistics of the most recent simulateEventDriven()
+    EventStats totalEventStats;         ///< Statistics accumulated over all calls
+    
+#ifdef CIRCUIT_PROFILE
+    SimProfile profile;                 ///< Hot-path counters (see printSimProfile())
+#endif
+    
+    /// Patterns evaluated per simulatePacked() call
+    size_t packedLanes() const { return 64 * packedWordsPerNet; }
+};
+
+/**
+ * @brief Compiles a gate list into an integer-indexed, levelized circuit
+ * @param c Receives the compiled circuit
+ * @param gates Gates as entered in interactive mode
+ * @param primaryInputs Primary input net names
+ * @param primaryOutputs Primary output net names
+ * @param circuitName Circuit name to record
+ * @param optimize Run the OPTIMIZATION_PASSES before compiling
+ * @param error Receives the reason on failure
+ * @return true on success, false if the netlist cannot be levelized
+ * 
+ * Assigns a dense ID to every net referenced by the primary inputs or by
+ * any gate, sorts the gates into dependency order, and stores everything
+ * as flat arrays plus a string table; afterwards net names are only
+ * needed for I/O.
+ */
+bool compileCircuit(CompiledCircuit &c, const vector<Gate> &gates, const set<string> &primaryInputs,
+                    const set<string> &primaryOutputs, const string &circuitName, bool optimize, string &error);
+
+/**
+ * @brief Prepares a simulation state for a compiled circuit
+ * @param c Levelized circuit
+ * @param s State to (re)initialize; all net values start at 0
+ * @param kernel Packed kernel for simulatePacked(); falls back to SCALAR if unsupported
+ */
+void initSimState(const CompiledCircuit &c, SimState &s, PackedKernel kernel);
+
+/**
+ * @brief Simulates the entire circuit by evaluating all gates
+ * @param c Levelized circuit
+ * @param s Simulation state whose primary input values are set
+ * 
+ * This function propagates values through all gates in the circuit.
+ * Gates are evaluated in level order, so every gate's inputs are final
+ * before it is evaluated.
+ */
+void simulate(const CompiledCircuit &c, SimState &s);
+
+/**
+ * @brief Sets a primary input for the next simulateEventDriven() call
+ * @param c Levelized circuit
+ * @param s Simulation state
+ * @param id Net ID of the input
+ * @param value New value (0 or 1)
+ * 
+ * Only an actual change schedules events, so re-applying the previous
+ * value of an input costs nothing.
+ */
+void setInputValue(const CompiledCircuit &c, SimState &s, int id, int value);
+
+/**
+ * @brief Event-driven incremental simulation
+ * @param c Levelized circuit
+ * @param s Simulation state, kept between calls
+ * 
+ * Net values are kept between calls. Only gates in the fanout cone of
+ * inputs changed through setInputValue() are re-evaluated, level by
+ * level, and a gate's fanout is scheduled only when its output actually
+ * changes. The first call on a fresh state runs a full simulate() to
+ * establish a consistent state.
+ * 
+ * @return Evaluation statistics for this call (also kept in s.lastEventStats)
+ */
+EventStats simulateEventDriven(const CompiledCircuit &c, SimState &s);
+
+/**
+ * @brief Checks whether the running CPU can execute a packed kernel
+ * @param kernel Kernel to check
+ * @return true if the kernel is usable on this machine
+ */
+bool packedKernelSupported(PackedKernel kernel);
+
+/**
+ * @brief Returns the widest packed kernel supported by the running CPU
+ * @return AVX512, AVX2 or SCALAR
+ */
+PackedKernel detectPackedKernel();
+
+/**
+ * @brief Simulates a block of input patterns at once using bit-parallel evaluation
+ * @param c Levelized circuit
+ * @param s Simulation state whose primary input words are loaded
+ * 
+ * Each net owns packedWordsPerNet consecutive words in netWords, starting
+ * at netWords[id * packedWordsPerNet]; bit k of word w holds the net's value
+ * in pattern 64 * w + k. The caller loads the primary input words; one pass
+ * over the levelized gates then evaluates all 64, 256 or 512 patterns with
+ * the kernel chosen by initSimState().
+ */
+void simulatePacked(const CompiledCircuit &c, SimState &s);
+
+/// Observer of each evaluated vector or clock cycle: the state and the packed
+/// bit lane holding the sample, or -1 when the values are in netValues
+using SampleHook = function<void(const SimState &s, int lane)>;
+
+/**
+ * @struct ModuleInstance
+ * @brief Use of one module inside the body of another
+ */
+struct ModuleInstance {
+    uint32_t module;      ///< Index of the instantiated module in CompiledDesign::modules
+    uint32_t firstPort;   ///< Index of the first connection in the parent's instancePorts
+    int32_t net;          ///< Body net of the INST gate that stands for the instance
+    string name;          ///< Instance name, the prefix of its nets when flattened
+};
+
+/**
+ * @struct ModuleStep
+ * @brief One step of a module sweep: a run of gates, or one instance
+ */
+struct ModuleStep {
+    uint32_t begin;       ///< First gate of the run
+    uint32_t end;         ///< One past the last gate of the run
+    int32_t instance;     ///< Index into CompiledModule::instances, or -1 for a gate run
+};
+
+/**
+ * @struct CompiledModule
+ * @brief Module definition, compiled and levelized once however often it is used
+ * 
+ * The body is an ordinary CompiledCircuit over the module's own nets.
+ * An instance appears in it as one INST gate reading the instance inputs
+ * and driving a private net, plus one INST gate per instance output
+ * reading that net, so levelizing the body also orders the instances:
+ * each runs once its inputs are final and before any reader of its
+ * outputs. The INST gates themselves are never evaluated.
+ */
+struct CompiledModule {
+    CompiledCircuit body;               ///< Gates of the module (its inputs are primary inputs)
+    vector<int32_t> inputPorts;         ///< Body nets of the inputs, in declaration order
+    vector<int32_t> outputPorts;        ///< Body nets of the outputs, in declaration order
+    vector<ModuleInstance> instances;   ///< Modules used by the body
+    vector<int32_t> instancePorts;      ///< Body nets on each instance's ports: inputs, then outputs
+    vector<ModuleStep> steps;           ///< Sweep order, built by scheduleModule()
+    size_t frameOffset = 0;             ///< First value slot of the body nets in a design sweep
+    
+    size_t portCount() const { return inputPorts.size() + outputPorts.size(); }
+};
+
+/**
+ * @struct CompiledDesign
+ * @brief Hierarchical circuit: every distinct module stored once, plus the top level
+ * 
+ * Value slots are laid out per module, not per instance: the top module's
+ * nets come first (so its net IDs index the value array directly), then
+ * one frame per module. All instances of a module share its frame, since
+ * a module cannot contain itself and every instance is swept to completion
+ * before the next one starts; each instance keeps its own port values in
+ * its parent's nets. Memory therefore grows with the distinct modules,
+ * not with the flattened gate count.
+ */
+struct CompiledDesign {
+    vector<CompiledModule> modules;     ///< Definitions before their users; the top level is last
+    size_t slotCount = 0;               ///< Value slots of one design sweep
+    
+    const CompiledModule &top() const { return modules.back(); }
+    
+    /// True if the top level instantiates any module
+    bool hierarchical() const { return !modules.empty() && !top().instances.empty(); }
+    
+    /// Assigns the module frames once the top level has been added
+    void layoutFrames() {
+        slotCount = top().body.netCount();
+        for (size_t m = 0; m + 1 < modules.size(); m++) {
+            modules[m].frameOffset = slotCount;
+            slotCount += modules[m].body.netCount();
+        }
+        modules.back().frameOffset = 0;
+    }
+};
+
+/**
+ * @brief Returns the packed word of one input for a block of exhaustive patterns
+ * @param base Index of the first pattern in the block (a multiple of 64)
+ * @param bit Bit position of the input within the pattern index
+ * @return Word whose bit k is bit 'bit' of pattern index (base + k)
+ */
+uint64_t exhaustivePatternWord(uint64_t base, int bit);
+
+/**
+ * @brief Converts a string to uppercase for case-insensitive comparisons
+ * @param str Input string
+ * @return Uppercase version of the input string
+ */
+string toUpper(string str);
+
+/**
+ * @brief Checks whether a gate definition line is the END marker
+ * @param line Input line
+ * @return true if the first word of the line is END (any case)
+ */
+bool isEndMarker(const string &line);
+
+/**
+ * @brief Parses one gate definition line of the form TYPE OUTPUT INPUT1 [INPUT2 ...]
+ * @param line Input line (gate type is case-insensitive)
+ * @param g Receives the parsed gate
+ * @param error Receives a description of the problem if the line is invalid
+ * @return true if the line is a valid gate definition
+ */
+bool parseGateLine(const string &line, Gate &g, string &error);
+
+/**
+ * @struct OutputBuffer
+ * @brief Accumulates output text and writes it in large blocks
+ */
+struct OutputBuffer {
+    static const size_t FLUSH_SIZE = 1 << 20;
+    
+    FILE *file;
+    string data;
+    
+    explicit OutputBuffer(FILE *f) : file(f) { data.reserve(FLUSH_SIZE + 4096); }
+    ~OutputBuffer() { flush(); }
+    
+    /// Appends complete lines, writing the block out once it is large enough
+    void appendLines(const string &text) {
+        if (data.size() + text.size() < FLUSH_SIZE) {
+            data.append(text);
+            return;
+        }
+        flush();
+        fwrite(text.data(), 1, text.size(), file);
+    }
+    
+    void flush() {
+        if (!data.empty()) fwrite(data.data(), 1, data.size(), file);
+        data.clear();
+    }
+};
+
+/**
+ * @struct DotOptions
+ * @brief Part of a circuit drawn by writeDot()
+ */
+struct DotOptions {
+    vector<string> cone;                ///< Outputs whose fanin cone is drawn (the whole circuit if empty)
+    uint32_t firstLevel = 0;            ///< Lowest logic level drawn
+    uint32_t lastLevel = UINT32_MAX;    ///< Highest logic level drawn
+};
+
+/**
+ * @brief Writes a Graphviz DOT file of a circuit, or of part of it
+ * @param c Levelized circuit
+ * @param path DOT file to create
+ * @param options Output cones and level range to draw
+ * @param gatesWritten Receives the number of gates drawn
+ * @return false if the file cannot be created or a cone output does not exist
+ * 
+ * Nets are nodes (primary inputs green, primary outputs red), gates are
+ * nodes labeled with their type and flip-flops are DFF nodes. With a
+ * cone, only the gates and flip-flops in the transitive fanin of the
+ * chosen outputs are drawn; the level range further limits the gates.
+ * Lines are formatted into one OutputBuffer, so even huge circuits are
+ * written in a few large blocks.
+ */
+bool writeDot(const CompiledCircuit &c, const string &path, const DotOptions &options, size_t &gatesWritten);
+
+/**
+ * @struct VcdOptions
+ * @brief What a VCD waveform dump records
+ */
+struct VcdOptions {
+    string path;                        ///< VCD file to write (no dump if empty)
+    vector<string> nets;                ///< Nets or scopes dumped (every net if empty)
+    uint64_t firstTime = 0;             ///< First time step dumped
+    uint64_t lastTime = UINT64_MAX;     ///< Last time step dumped
+    size_t stream = 0;                  ///< Stimulus stream dumped by the cycles command
+};
+
+/**
+ * @class VcdWriter
+ * @brief Streams a value change dump (VCD) of selected nets
+ * 
+ * Every sample() is one time step: a vector in batch mode, a clock cycle
+ * in the cycle-based engine. Only nets whose value changed since the
+ * previous step are written, and the text goes out through an
+ * OutputBuffer as it is produced, so memory use is one value per dumped
+ * net however long the run. Dotted names ("fa.ha0.t", as left by
+ * flattening hierarchical netlists) are nested into scopes.
+ */
+class VcdWriter {
+public:
+    /// Takes ownership of 'file'; 'nets' must be in netsByName order
+    VcdWriter(FILE *file, const CompiledCircuit &c, const string &scope, vector<int> nets,
+              uint64_t firstTime, uint64_t lastTime)
+        : file(file), out(file), nets(move(nets)), values(this->nets.size(), 0),
+          firstTime(firstTime), lastTime(lastTime) {
+        writeHeader(c, scope);
+    }
+    
+    ~VcdWriter() { finish(); }
+    
+    /**
+     * @brief Records the next time step
+     * @param s State holding the settled values
+     * @param lane Packed bit lane of the sample, or -1 to read netValues
+     */
+    void sample(const SimState &s, int lane);
+    
+    /// Ends the dump one step after the last sample and closes the file
+    void finish();
+    
+private:
+    FILE *file;
+    OutputBuffer out;
+    vector<int> nets;
+    vector<char> values;     ///< Last dumped value of each net
+    uint64_t firstTime, lastTime;
+    uint64_t time = 0;       ///< Time step of the next sample
+    string text;             ///< Text of one step (reused)
+    
+    void appendTime(uint64_t t);
+    
+    /// Identifier codes count in base 94 over the printable characters '!'..'~'
+    void appendCode(size_t i);
+    
+    void writeHeader(const CompiledCircuit &c, const string &scope);
+};
+
+/**
+ * @brief Creates the VCD file of a run
+ * @param c Circuit being simulated
+ * @param circuitName Name of the top scope
+ * @param options Dump options (options.path must be set)
+ * @return The writer, or nullptr (with a message) if a net is unknown or the file cannot be created
+ * 
+ * Each entry of options.nets names a net or a scope: "fa" selects every
+ * net named "fa.*" (and a net "fa" itself, if there is one).
+ */
+unique_ptr<VcdWriter> openVcdWriter(const CompiledCircuit &c, const string &circuitName,
+                                    const VcdOptions &options);
+
+/**
+ * @struct VectorChunk
+ * @brief A block of parsed input vectors
+ */
+struct VectorChunk {
+    vector<char> bits;      ///< nInputs 0/1 bytes per vector
+    size_t count = 0;       ///< Vectors held
+    bool last = false;      ///< No chunk follows (end of file, EXIT or a bad vector)
+};
+
+/**
+ * @class VectorReader
+ * @brief Parses a vector file on a background thread, one chunk ahead of its user
+ * 
+ * Two chunks alternate: while the caller simulates the chunk returned by
+ * next(), the reader thread fills the other one, so parsing overlaps
+ * simulation. Text files hold one vector per line (parseVectorLine(),
+ * classifyVectorLine()); binary files hold one fixed-size row per vector
+ * in the layout of the BINARY result format: the input bits, the first
+ * input most significant, padded with leading zeros to whole bytes.
+ * A bad vector is reported on stderr and ends the file.
+ */
+class VectorReader {
+public:
+    VectorReader(FILE *file, const string &path, size_t nInputs, size_t chunkVectors, bool binary)
+        : file(file), path(path), nInputs(nInputs), chunkVectors(chunkVectors), binary(binary) {
+        for (auto &chunk : chunks) chunk.bits.resize(chunkVectors * max<size_t>(nInputs, 1));
+        worker = thread([this]() { run(); });
+    }
+    
+    ~VectorReader() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+    
+    /// Waits for the next chunk; it stays valid until release()
+    const VectorChunk &next() {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this]() { return full[used]; });
+        return chunks[used];
+    }
+    
+    /// Hands the chunk of the last next() back to the reader
+    void release() {
+        {
+            lock_guard<mutex> guard(lock);
+            full[used] = false;
+        }
+        changed.notify_all();
+        used ^= 1;
+    }
+    
+    /// Whether reading stopped at a bad vector
+    bool failed() const { return error; }
+    
+private:
+    FILE *file;
+    string path;
+    size_t nInputs, chunkVectors;
+    bool binary;
+    VectorChunk chunks[2];
+    bool full[2] = {false, false};   ///< Chunk parsed and not yet released
+    size_t used = 0;                 ///< Chunk of the caller
+    bool stopping = false;
+    atomic<bool> error{false};
+    mutex lock;
+    condition_variable changed;
+    thread worker;
+    
+    void run();
+};
+
+#ifndef _WIN32
+/**
+ * @brief Runs a program without a shell and waits for it
+ * @param args Program (searched on PATH) and its arguments
+ * @param outputPath File receiving its stdout and stderr (truncated)
+ * @return true if the program started and exited with status 0
+ */
+bool runCommand(const vector<string> &args, const string &outputPath);
+#endif
+
+/**
+ * @class NativeSweep
+ * @brief A circuit compiled to native code and loaded as a shared object
+ * 
+ * load() generates the straight-line sweep of generateSweepSource(),
+ * compiles it with the system C++ compiler ($CIRCUIT_JIT_CXX, default c++)
+ * and loads the result. Libraries are cached by nativeCodeHash() in
+ * $CIRCUIT_JIT_CACHE (default ~/.cache/circuit-jit), so a circuit is only
+ * compiled once. The cache directory and every library loaded from it
+ * must belong to the user and be writable by nobody else. sweep() may be
+ * called from any number of threads.
+ */
+class NativeSweep {
+public:
+    NativeSweep() = default;
+    NativeSweep(const NativeSweep &) = delete;
+    NativeSweep &operator=(const NativeSweep &) = delete;
+    
+    ~NativeSweep();
+    
+    /**
+     * @brief Compiles (or finds in the cache) and loads the sweep of a circuit
+     * @param c Levelized circuit
+     * @param kernel Lane width; must be supported by this CPU
+     * @param error Receives the reason on failure
+     * @param storeAllNets Keep every net in netWords, not just the outputs
+     * @return true if sweep() is usable
+     */
+    bool load(const CompiledCircuit &c, PackedKernel kernel, string &error, bool storeAllNets = false);
+    
+    /// Evaluates every gate over SimState::netWords of the kernel passed to load()
+    void sweep(uint64_t *words) const { function(words); }
+    
+    /// Time load() spent compiling, zero if the library came from the cache
+    chrono::milliseconds compileTime() const { return compiled; }
+    
+private:
+    void *handle = nullptr;
+    void (*function)(void *) = nullptr;
+    chrono::milliseconds compiled{0};
+};
+
+/// Largest input support of a net replaced by a lookup table (2^16 bits = 8 KB)
+const size_t CONE_TABLE_MAX_SUPPORT = 16;
+
+/**
+ * @enum BatchEngine
+ * @brief Simulation engine used by batch mode
+ */
+enum class BatchEngine { PACKED, EVENT, SCALAR, LEVEL, JIT };
+
+/// Vectors per task for the scalar and event-driven batch engines
+const size_t SCALAR_TASK_VECTORS = 256;
+
+/// Minimum tasks per batch chunk, so the pipeline stages hand over large blocks
+const size_t PIPELINE_CHUNK_TASKS = 64;
+
+/**
+ * @enum ResultMode
+ * @brief Per-vector output of batch simulation
+ */
+enum class ResultMode {
+    FULL,       ///< Input bits, a space, the reported net bits
+    OUTPUTS,    ///< Reported net bits only
+    HEX,        ///< Reported net bits as hex digits, the first net most significant
+    BINARY,     ///< Reported net bits packed into big-endian bytes, no line breaks
+    SUMMARY     ///< No per-vector output; count of ones per net at the end
+};
+
+/**
+ * @struct ResultFormat
+ * @brief What batch simulation reports for each vector
+ */
+struct ResultFormat {
+    ResultMode mode = ResultMode::FULL;
+    vector<int32_t> nets;   ///< Reported nets: the primary outputs or a watch list (-1 if undefined)
+    vector<string> names;   ///< Name of each reported net, for the summary
+};
+
+/**
+ * @brief Result format reporting the primary outputs
+ * @param c Levelized circuit
+ * @param mode Output mode
+ * @return Format listing every primary output
+ */
+ResultFormat outputResultFormat(const CompiledCircuit &c, ResultMode mode);
+
+#ifdef CIRCUIT_PROFILE
+/**
+ * @brief Prints a summary of the hot-path counters on stderr
+ * @param c Levelized circuit the profile was collected on
+ * @param p Profile (merged over all threads)
+ * 
+ * Lists gate evaluations per gate type, the levels doing the most work
+ * and the highest-fanout nets with their toggle counts. Evaluations
+ * include both full sweeps and event-driven re-evaluations; output
+ * changes and toggles are only counted by the event-driven engine.
+ */
+void printSimProfile(const CompiledCircuit &c, const SimProfile &p);
+#endif
+
+/**
+ * @brief Simulates a vector file against a compiled circuit
+ * @param c Levelized circuit, shared read-only by all worker threads
+ * @param vectorPath Vector file path ("-" for stdin)
+ * @param out Destination for results
+ * @param engine Engine to use
+ * @param kernel Packed kernel for the PACKED engine
+ * @param threads Number of worker threads (1 simulates on the calling thread)
+ * @param format What to report for each vector
+ * @param design Hierarchical design whose top-level body is c, swept by the PACKED engine
+ * @param hook Called for every simulated vector (see simulateVectors())
+ * @param binaryInput The vector file holds binary rows (see VectorReader)
+ * @param coneSupport Largest input support the SCALAR engine tabulates (0: no ConeTables)
+ * @return true on success; errors are reported on stderr
+ * 
+ * Each non-empty vector line produces one result in the chosen format;
+ * by default a line with the input bits, a space and the output bits (in
+ * primaryInputs/primaryOutputs order; undefined outputs print as '-').
+ * SUMMARY mode instead ends with the vector count and the number of
+ * vectors setting each reported net to 1. Lines starting with '#' and an
+ * EXIT line are accepted so interactive scripts can be replayed.
+ * 
+ * Vectors are parsed in chunks by a VectorReader thread; each chunk is
+ * split into tasks that the thread pool simulates independently, each
+ * worker with its own SimState, and a ResultWriter thread writes the
+ * per-task results back in the original vector order.
+ * The LEVEL engine instead simulates one vector at a time and uses the
+ * threads inside each vector, level by level. The JIT engine runs the
+ * packed scheme with a NativeSweep of the same kernel, falling back to
+ * the packed engine if the circuit cannot be compiled. A design is swept
+ * module by module with the 64-lane scalar kernel. A hook sees the
+ * vectors in file order only when threads is 1. Without a hook, the
+ * SCALAR engine finds reported nets of a small support in ConeTables and
+ * reports on stderr how much of the work they took over.
+ */
+bool runBatch(const CompiledCircuit &c, const string &vectorPath, OutputBuffer &out,
+              BatchEngine engine, PackedKernel kernel, size_t threads, const ResultFormat &format,
+              const CompiledDesign *design = nullptr, const SampleHook &hook = nullptr,
+              bool binaryInput = false, size_t coneSupport = 0);
+
+/**
+ * @brief Streams the complete truth table of a circuit using Gray-code order
+ * @param c Levelized circuit
+ * @param s Simulation state for the event-driven engine
+ * @param out Destination; rows are written as they are produced
+ * @return Number of rows written
+ * 
+ * Consecutive rows differ in exactly one input (reflected Gray code, the
+ * first primary input being the most significant bit), so the event-driven
+ * engine only re-evaluates the fanout cone of one input per row. Nothing
+ * but the current row is held in memory, whatever the number of inputs.
+ * Rows use the batch format: input bits, a space, output bits.
+ */
+uint64_t writeTruthTable(const CompiledCircuit &c, SimState &s, OutputBuffer &out);
+
+/**
+ * @struct StuckAtFault
+ * @brief One net held at a constant value, and whether the vectors detect it
+ */
+struct StuckAtFault {
+    int net;                  ///< Faulty net ID
+    int value;                ///< Stuck-at value (0 or 1)
+    int64_t detectedBy = -1;  ///< Index of the first vector detecting the fault, or -1
+};
+
+/**
+ * @brief Lists the stuck-at-0 and stuck-at-1 fault on every net
+ * @param c Levelized circuit
+ * @return Faults of every primary input and gate output, in net ID order
+ */
+vector<StuckAtFault> enumerateStuckAtFaults(const CompiledCircuit &c);
+
+/**
+ * @brief Grades every stuck-at fault of a circuit against a vector set
+ * @param c Levelized circuit
+ * @param faults Faults to grade (see enumerateStuckAtFaults())
+ * @param vectors Input values, nInputs 0/1 bytes per vector
+ * @param nVectors Number of vectors
+ * @param threads Number of worker threads
+ * 
+ * Faults on nets with no path to a primary output cannot be detected and
+ * are not simulated. The others are graded FAULTS_PER_PASS at a time, the
+ * passes spread over a thread pool with one set of buffers per worker.
+ */
+void gradeStuckAtFaults(const CompiledCircuit &c, vector<StuckAtFault> &faults,
+                        const vector<char> &vectors, size_t nVectors, size_t threads);
+
+/**
+ * @brief Reads every input vector of a vector file into memory
+ * @param path Vector file path ("-" for stdin)
+ * @param nInputs Number of primary inputs
+ * @param vectors Receives the input values, nInputs 0/1 bytes per vector
+ * @param streamStarts If given, STREAM lines split the vectors into
+ *        streams and this receives the index of each stream's first vector
+ * @return true on success; errors are reported on stderr
+ */
+bool loadVectorFile(const string &path, size_t nInputs, vector<char> &vectors,
+                    vector<size_t> *streamStarts = nullptr);
+
+/**
+ * @brief Writes a fault coverage report
+ * @param c Levelized circuit the faults belong to
+ * @param faults Graded faults
+ * @param nVectors Number of vectors graded
+ * @param out Destination
+ * 
+ * '#' lines summarize the coverage; every other line names one
+ * undetected fault as "NET SA0" or "NET SA1".
+ */
+void writeFaultReport(const CompiledCircuit &c, const vector<StuckAtFault> &faults,
+                      size_t nVectors, OutputBuffer &out);
+
+/**
+ * @brief Parses a non-negative decimal integer token
+ * @param token Token text
+ * @param value Receives the value
+ * @return false if the token is not a plain decimal number
+ */
+bool parseDecimal(string_view token, long &value);
+
+/**
+ * @brief Assigns a delay to every gate from the defaults and an annotation file
+ * @param c Levelized circuit
+ * @param path Annotation file, or "" for the defaults only
+ * @param delays Receives one delay per gate, in gate order
+ * @return true on success; errors are reported on stderr
+ * 
+ * Each line of the file is 'TYPE DELAY', setting the delay of every gate
+ * of a type, or 'NET DELAY', setting the delay of the gate driving a net;
+ * a net line wins over the type lines. '#' starts a comment. Delays range
+ * from 1 to MAX_GATE_DELAY.
+ */
+bool loadGateDelays(const CompiledCircuit &c, const string &path, vector<uint32_t> &delays);
+
+/**
+ * @class TimingWheel
+ * @brief Calendar queue of pending net transitions with one bucket per time unit
+ * 
+ * Every event is scheduled less than the largest gate delay ahead of the
+ * current time, so a wheel with a power-of-two number of buckets above
+ * that delay never puts two different times in one bucket. Scheduling
+ * appends to a bucket and the next busy time is found from an occupancy
+ * bitmap, so both stay O(1) however many events are pending. Buckets keep
+ * their capacity, so a long run stops allocating once the busiest times
+ * have been seen.
+ */
+class TimingWheel {
+public:
+    /// A net taking a new value
+    struct Event {
+        int32_t net;
+        int32_t value;
+    };
+    
+    /// @param maxDelay Largest delay an event is scheduled ahead of the current time
+    explicit TimingWheel(uint32_t maxDelay) {
+        size_t size = 64;
+        while (size <= maxDelay) size *= 2;
+        mask = size - 1;
+        buckets.resize(size);
+        occupied.assign(size / 64, 0);
+    }
+    
+    bool empty() const { return pending == 0; }
+    
+    /// Current time
+    uint64_t time() const { return now; }
+    
+    /// Restarts the clock at 0 (only while empty)
+    void reset() { now = 0; }
+    
+    /// Schedules an event at a time after the current one, within the largest delay
+    void schedule(uint64_t at, int net, int value) {
+        const size_t b = at & mask;
+        buckets[b].push_back({net, value});
+        occupied[b / 64] |= 1ULL << (b % 64);
+        pending++;
+    }
+    
+    /**
+     * @brief Advances to the next time with events and takes them
+     * @param events Receives the events of that time (its old contents go back to the wheel)
+     * @return The new current time
+     */
+    uint64_t next(vector<Event> &events) {
+        const size_t start = now & mask;
+        size_t w = start / 64;
+        uint64_t bits = occupied[w] & (~0ULL << (start % 64));
+        while (bits == 0) {
+            w = (w + 1) % occupied.size();
+            bits = occupied[w];
+        }
+        const size_t b = w * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+        now += (b - start) & mask;
+        events.clear();
+        swap(events, buckets[b]);
+        occupied[w] &= ~(1ULL << (b % 64));
+        pending -= events.size();
+        return now;
+    }
+    
+private:
+    vector<vector<Event>> buckets;
+    vector<uint64_t> occupied;  ///< Bit b set while bucket b holds events
+    size_t mask;
+    size_t pending = 0;
+    uint64_t now = 0;
+};
+
+/**
+ * @struct OutputTiming
+ * @brief Switching statistics of one primary output over all vectors
+ */
+struct OutputTiming {
+    uint64_t settle = 0;          ///< Latest transition after a vector was applied
+    uint64_t transitions = 0;     ///< Transitions, glitches included
+    uint64_t glitches = 0;        ///< Pulses that went away before the output settled
+    uint64_t glitchyVectors = 0;  ///< Vectors with at least one glitch
+};
+
+/**
+ * @class TimedSimulator
+ * @brief Event-driven simulation with per-gate transport delays
+ * 
+ * Applying a vector changes its inputs at time 0. Whenever a net changes,
+ * the gates it feeds are evaluated once for that time and a gate whose
+ * result differs from the last value scheduled for its output schedules
+ * that value one gate delay later. With transport delays every pulse,
+ * however short, travels on, which shows the worst-case hazards. Between
+ * vectors the circuit settles; it starts settled with every input at 0.
+ */
+class TimedSimulator {
+public:
+    TimedSimulator(const CompiledCircuit &c, const vector<uint32_t> &delays);
+    
+    /**
+     * @brief Applies one vector and runs until the circuit settles
+     * @param bits Primary input values (0/1 bytes, in primaryInputIds order)
+     * @param glitches Receives the glitches of this vector over all outputs
+     * @return Time of the last output transition (0 if no output changed)
+     */
+    uint64_t apply(const char *bits, uint64_t &glitches);
+    
+    /// Current value of a net
+    int value(int id) const { return values[id]; }
+    
+    /// Statistics of an output net (one of primaryOutputIds, not -1)
+    const OutputTiming &outputTiming(int id) const { return tracked[outputSlot[id]]; }
+    
+    /// Net transitions processed so far, inputs excluded
+    uint64_t events() const { return eventCount; }
+    
+private:
+    const CompiledCircuit &c;
+    const vector<uint32_t> &delays;
+    TimingWheel wheel;
+    vector<TimingWheel::Event> current;  ///< Events of the current time, swapped out of the wheel
+    vector<int> values;
+    vector<int> projected;               ///< Value each net has once its pending events are applied
+    vector<int32_t> outputSlot;          ///< Index in trackedNets of an output net, else -1
+    vector<int> trackedNets;
+    vector<OutputTiming> tracked;
+    vector<uint64_t> vectorTransitions, lastChange;
+    vector<int> startValues;
+    vector<char> gateMarked;
+    vector<uint32_t> marked;             ///< Gates to evaluate for the current time
+    uint64_t eventCount = 0;
+    
+    void change(int id, int value, uint64_t at);
+    
+    void evaluateMarked(uint64_t at);
+};
+
+/**
+ * @brief Longest input-to-output path of a circuit, in time units
+ * @param c Levelized circuit
+ * @param delays Delay of every gate
+ * @return Upper bound for the settle time of any vector
+ */
+uint64_t criticalPathDelay(const CompiledCircuit &c, const vector<uint32_t> &delays);
+
+/**
+ * @brief Picks the narrowest supported packed kernel with a lane per stream
+ * @param streams Number of stimulus streams
+ * @return First kernel (by width) with at least 'streams' lanes, else the widest supported one
+ */
+PackedKernel streamKernel(size_t streams);
+
+/**
+ * @brief Runs every stimulus stream of a sequential circuit for a number of cycles
+ * @param c Levelized circuit
+ * @param vectors Input values of all streams, nInputs 0/1 bytes per cycle
+ * @param streamStarts Index of each stream's first vector (see loadVectorFile())
+ * @param nVectors Total number of vectors
+ * @param cycles Clock cycles per stream
+ * @param kernel Packed kernel; its lane count sets the streams per block
+ * @param threads Number of worker threads
+ * @param out Destination for one result line per stream
+ * @param hook Called after every cycle of one stream
+ * @param hookStream Stream the hook observes
+ * 
+ * Streams are packed one per bit lane, a block of up to packedLanes()
+ * streams per runCycles() call, and blocks are spread over a thread
+ * pool. A stream shorter than 'cycles' keeps its last inputs. Each
+ * result line holds the final flip-flop state, a space and the final
+ * outputs, in flopOutputs/primaryOutputs order.
+ */
+void simulateStreams(const CompiledCircuit &c, const vector<char> &vectors, const vector<size_t> &streamStarts,
+                     size_t nVectors, uint64_t cycles, PackedKernel kernel, size_t threads, OutputBuffer &out,
+                     const SampleHook &hook = nullptr, size_t hookStream = 0);
+
+/**
+ * @brief Writes a compiled circuit as a binary netlist
+ * @param c Compiled circuit
+ * @param path Output file path
+ * @return true on success
+ */
+bool writeBinaryCircuit(const CompiledCircuit &c, const string &path);
+
+/**
+ * @enum NetlistFormat
+ * @brief Netlist file formats accepted by the command-line tools
+ */
+enum class NetlistFormat { TEXT, BINARY, VERILOG, BLIF };
+
+/**
+ * @brief Picks a netlist format from the file header and extension
+ * @param path Netlist file path
+ * @return BINARY for the binary magic, VERILOG for .v/.sv, BLIF for .blif, else TEXT
+ */
+NetlistFormat detectNetlistFormat(const string &path);
+
+/**
+ * @brief Imports a text netlist keeping its module hierarchy
+ * @param path Netlist file path
+ * @param design Receives the modules and the top level
+ * @param circuitName Receives the circuit name
+ * @param error Receives the reason on failure
+ * @return true on success
+ */
+bool importDesign(const string &path, CompiledDesign &design, string &circuitName, string &error);
+
+/**
+ * @struct BenchRandom
+ * @brief Small deterministic generator (splitmix64) for benchmark circuits and stimulus
+ */
+struct BenchRandom {
+    uint64_t state;
+    
+    explicit BenchRandom(uint64_t seed) : state(seed) {}
+    
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    
+    /// Uniform value in [0, n)
+    size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+};
+
+/// Benchmark engines: the batch engines, plus packed on all threads ("threaded")
+const char *const BENCH_ENGINES[] = {"scalar", "event", "packed", "threaded", "level", "jit"};
+
+/**
+ * @brief Runs the built-in benchmarks and prints one CSV row per circuit and engine
+ * @param out Destination
+ * @param scale Size multiplier of the generated circuits
+ * @param vectors Random vectors per run (rounded up to a multiple of 512)
+ * @param engines Engine names from BENCH_ENGINES
+ * @param threads Threads for the threaded and level engines
+ * @return true if every circuit compiled
+ * 
+ * Columns: circuit, gates, levels, inputs, outputs, engine, threads,
+ * vectors, load_ms (parse and compile of the text netlist), sim_ms,
+ * gates_per_sec, vectors_per_sec, peak_rss_kb (process high-water mark so
+ * far) and ones (output bits that were 1; equal engines must agree).
+ */
+bool runBenchmarks(FILE *out, size_t scale, size_t vectors, const vector<string> &engines, size_t threads);
+
+/// Resolution of input weights: a weight is rounded to a multiple of 2^-STIMULUS_WEIGHT_BITS
+const int STIMULUS_WEIGHT_BITS = 16;
+
+/**
+ * @class RandomStimulus
+ * @brief Weighted-random input words, 64 vectors per word, reproducible from a seed
+ * 
+ * Every group of 64 vectors draws its words from its own splitmix64
+ * stream, seeded from the run seed and the group index. The vectors
+ * therefore depend on the seed alone, and not on the thread count, the
+ * thread drawing a group or the kernel width.
+ * 
+ * An input of weight k / 2^16 (its probability of a 1) takes one random
+ * word per bit of k, starting at the lowest set bit. ANDing a fresh word
+ * halves the probability so far and ORing one moves it halfway to 1, so
+ * going through the bits of k from low to high ends exactly at k / 2^16.
+ * A weight of 1/2 costs one word, 1/4 two, and 0 or 1 none.
+ */
+class RandomStimulus {
+public:
+    /**
+     * @param seed Run seed
+     * @param weights Probability of a 1 for each primary input, from 0 to 1
+     */
+    RandomStimulus(uint64_t seed, const vector<double> &weights) : seed(seed) {
+        const uint32_t one = 1u << STIMULUS_WEIGHT_BITS;
+        for (double w : weights) levels.push_back(static_cast<uint32_t>(w * one + 0.5));
+    }
+    
+    /// Generator of one group of 64 vectors; draw its input words in input order
+    BenchRandom group(uint64_t index) const {
+        return BenchRandom(BenchRandom(seed ^ (index * 0xd1b54a32d192ed03ULL)).next());
+    }
+    
+    /// Next word of input i: bit p is its value in vector p of the group
+    uint64_t word(BenchRandom &rng, size_t i) const {
+        const uint32_t k = levels[i];
+        if (k == 0) return 0;
+        if (k >> STIMULUS_WEIGHT_BITS) return ~0ULL;
+        int bit = __builtin_ctz(k);
+        uint64_t w = rng.next();
+        while (++bit < STIMULUS_WEIGHT_BITS) w = ((k >> bit) & 1) ? (w | rng.next()) : (w & rng.next());
+        return w;
+    }
+    
+    /// Weight of input i as used, after rounding
+    double weight(size_t i) const { return static_cast<double>(levels[i]) / (1u << STIMULUS_WEIGHT_BITS); }
+    
+private:
+    uint64_t seed;
+    vector<uint32_t> levels;  ///< Weights in units of 2^-STIMULUS_WEIGHT_BITS
+};
+
+/**
+ * @struct NetActivity
+ * @brief Signal statistics of one net over a random-stimulus run
+ */
+struct NetActivity {
+    uint64_t ones = 0;     ///< Vectors setting the net to 1
+    uint64_t toggles = 0;  ///< Consecutive vectors giving the net different values
+};
+
+/**
+ * @brief Simulates random vectors and gathers per-net activity as they are simulated
+ * @param c Levelized combinational circuit
+ * @param stimulus Input generator
+ * @param vectors Number of vectors
+ * @param nets Nets to collect statistics for
+ * @param kernel Packed kernel
+ * @param threads Number of worker threads
+ * @param native Compiled sweep to use instead of simulatePacked() (storing every net in nets)
+ * @param activity Receives one entry per net in nets
+ * 
+ * Vectors never exist as text: each worker fills the input words of its
+ * blocks straight from the generator, sweeps them and counts the ones and
+ * the changes between neighbouring lanes of every watched net. Tasks
+ * cover consecutive blocks; the values of the first and last vector of
+ * each task give the toggles across task boundaries, so the totals do not
+ * depend on the thread count. Tasks run in rounds, so memory stays the
+ * same for any number of vectors.
+ */
+void simulateRandomStimulus(const CompiledCircuit &c, const RandomStimulus &stimulus, uint64_t vectors,
+                            const vector<int32_t> &nets, PackedKernel kernel, size_t threads,
+                            const NativeSweep *native, vector<NetActivity> &activity);
+
+/**
+ * @struct EquivOptions
+ * @brief Effort settings of checkEquivalence()
+ */
+struct EquivOptions {
+    uint64_t randomVectors = 1 << 16;   ///< Random vectors simulated first (0 skips simulation)
+    uint64_t seed = 1;                  ///< Random stimulus seed
+    uint64_t conflictLimit = 1000000;   ///< SAT conflicts allowed per output pair
+};
+
+/**
+ * @enum EquivVerdict
+ * @brief Outcome of an equivalence check
+ */
+enum class EquivVerdict { EQUIVALENT, DIFFERENT, UNDECIDED };
+
+/**
+ * @struct EquivResult
+ * @brief What checkEquivalence() found and how
+ */
+struct EquivResult {
+    EquivVerdict verdict = EquivVerdict::EQUIVALENT;
+    vector<string> inputs;          ///< Input names of either circuit, sorted
+    vector<string> outputs;         ///< Output names of both circuits, sorted; the ones compared
+    uint64_t simulated = 0;         ///< Vectors simulated
+    bool exhaustive = false;        ///< The simulation covered every input combination
+    size_t structural = 0;          ///< Output pairs proven by structural hashing
+    size_t proven = 0;              ///< Output pairs proven by SAT
+    vector<string> undecided;       ///< Outputs the SAT solver gave up on
+    vector<char> counterexample;    ///< First mismatching vector, one value per input (DIFFERENT)
+    bool foundBySat = false;        ///< The counterexample came from the SAT solver
+};
+
+/**
+ * @brief Checks two combinational circuits for equivalence
+ * @param a First circuit
+ * @param b Second circuit
+ * @param options Simulation and proof effort
+ * @param result Receives the verdict and how it was reached
+ * @return false (with a message) if the circuits cannot be paired up
+ * 
+ * Primary inputs are paired by name; an input of only one circuit is a
+ * free input the other ignores. Outputs are paired by name and those of
+ * only one circuit are skipped with a warning. Up to
+ * EQUIV_EXHAUSTIVE_INPUTS inputs, packed simulation of every input
+ * combination decides the check on its own, in truth-table order so the
+ * first mismatch is the lowest vector. Larger circuits get
+ * options.randomVectors random vectors, and outputs that survive are
+ * proven on a miter: both circuits hashed into one MiterGraph, where
+ * pairs on the same node are done, and the rest go to SatSolver. It
+ * asserts the two outputs differ: UNSAT proves the pair, SAT is a
+ * counterexample.
+ */
+bool checkEquivalence(const CompiledCircuit &a, const CompiledCircuit &b, const EquivOptions &options,
+                      EquivResult &result);
+
+/**
+ * @brief Loads, compiles and levelizes a netlist file, or maps a binary one
+ * @param path Text, Verilog (.v), BLIF (.blif) or binary netlist file path
+ * @param c Receives the compiled circuit
+ * @param circuitName Receives the circuit name
+ * @param optimize Optimize while compiling (binary netlists are used as written)
+ * @param error Receives the reason on failure
+ * @param report If given, receives the optimization summary (see finishCircuit())
+ * @return true if the circuit is ready to simulate
+ */
+bool loadCircuit(const string &path, CompiledCircuit &c, string &circuitName, bool optimize, string &error,
+                 string *report = nullptr);
+
+}  // namespace detail
+}  // namespace circuitsim
+
+#endif  // CIRCUITSIM_DETAIL_H
@@ -0,0 +1,13 @@
+// Full adder as structural Verilog (gate primitives and assign)
+module FullAdder (A, B, Cin, Sum, Cout);
+    input A, B, Cin;
+    output Sum, Cout;
+    wire t1, t2, t3, carry;
+
+    xor x0 (Sum, A, B, Cin);    /* 3-input primitive */
+    and a0 (t1, A, B),
+        a1 (t2, A, Cin);
+    and (t3, B, Cin);
+    or  o0 (carry, t1, t2, t3);
+    assign Cout = carry;
+endmodule
@@ -0,0 +1,83 @@
+/**
+ * @file library_example.cpp
+ * @brief Embedding the simulator: prints the results of a vector file like 'circuit batch'
+ *
+ * Build against the library with, e.g.
+ *     g++ -std=c++17 -I. examples/library_example.cpp libcircuitsim.a -pthread -ldl
+ * and run it as
+ *     ./a.out examples/full_adder_netlist.txt examples/full_adder_vectors.txt
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "circuitsim.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " NETLIST VECTORS\n";
+        return 1;
+    }
+    string error;
+    shared_ptr<const circuitsim::Circuit> circuit = circuitsim::Circuit::load(argv[1], false, &error);
+    if (!circuit) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    const size_t nInputs = circuit->inputCount();
+    const size_t nOutputs = circuit->outputCount();
+
+    // One row of input bits per vector; '#' lines are comments
+    vector<string> vectors;
+    ifstream file(argv[2]);
+    for (string line; getline(file, line);) {
+        string bits;
+        for (char ch : line) {
+            if (ch == '#') break;
+            if (ch == '0' || ch == '1') bits.push_back(ch);
+        }
+        if (bits.empty()) continue;
+        if (bits.size() != nInputs) {
+            cerr << argv[2] << ": expected " << nInputs << " input values.\n";
+            return 1;
+        }
+        vectors.push_back(bits);
+    }
+
+    // Pack 64 vectors per word: bit p of in[w * nInputs + i] is input i of vector w * 64 + p
+    const size_t perWord = circuitsim::Simulator::VECTORS_PER_WORD;
+    vector<uint64_t> in((vectors.size() + perWord - 1) / perWord * nInputs, 0);
+    vector<uint64_t> out(in.size() / (nInputs ? nInputs : 1) * nOutputs, 0);
+    for (size_t v = 0; v < vectors.size(); v++) {
+        for (size_t i = 0; i < nInputs; i++) {
+            in[v / perWord * nInputs + i] |= uint64_t(vectors[v][i] - '0') << (v % perWord);
+        }
+    }
+
+    // The circuit is shared; every thread has its own simulator and half of the words
+    const size_t groups = in.size() / (nInputs ? nInputs : 1);
+    const size_t split = groups / 2;
+    auto run = [&](size_t first, size_t last) {
+        circuitsim::Simulator sim(circuit);
+        sim.simulate({in.data() + first * nInputs, (last - first) * nInputs},
+                     {out.data() + first * nOutputs, (last - first) * nOutputs});
+    };
+    thread worker(run, 0, split);
+    run(split, groups);
+    worker.join();
+
+    for (size_t v = 0; v < vectors.size(); v++) {
+        string line = vectors[v] + " ";
+        for (size_t o = 0; o < nOutputs; o++) {
+            line.push_back((out[v / perWord * nOutputs + o] >> (v % perWord)) & 1 ? '1' : '0');
+        }
+        cout << line << "\n";
+    }
+    return 0;
+}